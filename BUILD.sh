@@ -27,8 +27,35 @@ modules="$modules alignment"
 modules="$modules alloc/unaligned"
 modules="$modules alloc/aligned"
 modules="$modules alloc/tags"
+modules="$modules alloc/arena"
+modules="$modules alloc/budget"
+modules="$modules alloc/shm"
 modules="$modules buffer"
+modules="$modules buffer/append"
+modules="$modules buffer/cow"
+modules="$modules buffer/gap"
+modules="$modules buffer/sstr"
+modules="$modules btree"
+modules="$modules cache"
+modules="$modules codec/checksum"
+modules="$modules codec/lz"
+modules="$modules io/direct"
+modules="$modules io/error"
+modules="$modules io/transfer"
+modules="$modules io/uring"
 modules="$modules slice"
+modules="$modules slotmap"
+modules="$modules pvec"
+modules="$modules piece"
+modules="$modules reclaim/epoch"
+modules="$modules reclaim/hazard"
+modules="$modules relptr"
+modules="$modules skiplist"
+modules="$modules sync"
+modules="$modules text/pow10"
+modules="$modules text/format"
+modules="$modules text/parse"
+modules="$modules text/builder"
 
 trap "rm -f delme.c" EXIT
 
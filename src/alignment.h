@@ -14,6 +14,12 @@
 #include <stdint.h>
 
 
+/// @brief Assumed size of a cache line, in bytes.
+///
+/// Used to pad shared data so that independently-written fields do not false-share.
+/// This is right for current x86-64 and most ARM cores; being wrong only costs performance.
+#define CHIM_CACHELINE 64
+
 /// @brief Increment a number so that it is divisible by a power of two
 ///
 /// Particularly useful for pointer arithmetic:
@@ -23,6 +29,7 @@
 /// @param alignment_pow2: a power of two to align to
 ///   @warning if `alignment_pow2` is not a power of two, the result is undefined
 /// @return the smallest number at least as large as the input which is divisible by the power of two
+INLINE
 uintptr_t alignUp(uintptr_t bits, size_t alignment_pow2) {
   assert(__builtin_popcount(alignment_pow2) == 1);
   uintptr_t mask = alignment_pow2 - 1;
@@ -41,6 +48,7 @@ uintptr_t alignUp(uintptr_t bits, size_t alignment_pow2) {
 /// @param alignment_pow2: a power of two to align to
 ///   @warning if `alignment_pow2` is not a power of two, the result is undefined
 /// @return the largest number no larger than the input which is divisible by the power of two
+INLINE
 uintptr_t alignDown(uintptr_t bits, size_t alignment_pow2) {
   assert(__builtin_popcount(alignment_pow2) == 1);
   uintptr_t mask = alignment_pow2 - 1;
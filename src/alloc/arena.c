@@ -0,0 +1,170 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+
+static_assert(sizeof(arena_block) % alignof(max_align_t) == 0
+             , "arena block header would misalign payloads");
+static_assert(sizeof(arena_chunk) % alignof(max_align_t) == 0
+             , "arena chunk header would misalign blocks");
+
+static _Thread_local arena* bound = NULL;
+
+
+static inline
+arena_block* headerOf(void* ptr) {
+  return (arena_block*)ptr - 1;
+}
+
+static inline
+arena_block** linkOf(arena_block* blk) {
+  return (arena_block**)(blk + 1);
+}
+
+static inline
+size_t classOf(size_t size) {
+  if (size <= CHIM_ARENA_MINSMALL) { return 0; }
+  return (8 * sizeof(unsigned long) - __builtin_clzl(size - 1)) - __builtin_ctzl(CHIM_ARENA_MINSMALL);
+}
+
+static
+void drainRemote(arena* self) {
+  arena_block* blk = atomic_exchange_explicit(&self->remote, NULL, memory_order_acquire);
+  while (blk != NULL) {
+    arena_block* next = *linkOf(blk);
+    size_t cls = classOf(blk->size);
+    *linkOf(blk) = self->free[cls];
+    self->free[cls] = blk;
+    blk = next;
+  }
+}
+
+static
+arena_block* carve(arena* self, size_t blockSize) {
+  if ((size_t)(self->bumpEnd - self->bump) < blockSize) {
+    arena_chunk* chunk = allocIn(self->backing, CHIM_ARENA_CHUNK);
+    if (chunk == NULL) { return NULL; }
+    // the tail of the old chunk is abandoned; it is smaller than the largest class
+    chunk->next = self->chunks;
+    self->chunks = chunk;
+    self->bump = (byte*)(chunk + 1);
+    self->bumpEnd = (byte*)chunk + CHIM_ARENA_CHUNK;
+  }
+  arena_block* blk = (arena_block*)self->bump;
+  self->bump += blockSize;
+  return blk;
+}
+
+static
+void* arena_realloc(void* ptr, size_t size) {
+  if (ptr == NULL) {
+    return bound == NULL ? NULL : arena_allocIn(bound, size);
+  }
+  if (size == 0) {
+    arena_free(ptr);
+    return NULL;
+  }
+  arena_block* blk = headerOf(ptr);
+  size_t oldSize = blk->size;
+  if (oldSize > CHIM_ARENA_MAXSMALL && size > CHIM_ARENA_MAXSMALL) {
+    if (size > SIZE_MAX - sizeof(arena_block)) { return NULL; }
+    blk = reallocIn(blk->owner->backing, blk, sizeof(arena_block) + size);
+    if (blk == NULL) { return NULL; }
+    blk->size = size;
+    return blk + 1;
+  }
+  if (size <= oldSize) { return ptr; }
+  if (bound == NULL) { return NULL; }
+  void* new = arena_allocIn(bound, size);
+  if (new == NULL) { return NULL; }
+  memcpy(new, ptr, size < oldSize ? size : oldSize);
+  arena_free(ptr);
+  return new;
+}
+
+const alloc_t arena_alloc = arena_realloc;
+
+
+void arena_init(arena* self, alloc_t backing) {
+  atomic_init(&self->remote, NULL);
+  for (size_t i = 0; i < CHIM_ARENA_CLASSES; ++i) {
+    self->free[i] = NULL;
+  }
+  self->bump = NULL;
+  self->bumpEnd = NULL;
+  self->chunks = NULL;
+  self->backing = backing;
+}
+
+void arena_deinit(arena* self) {
+  arena_chunk* chunk = self->chunks;
+  while (chunk != NULL) {
+    arena_chunk* next = chunk->next;
+    freeIn(self->backing, chunk);
+    chunk = next;
+  }
+  arena_init(self, self->backing);
+}
+
+void arena_bind(arena* self) {
+  bound = self;
+}
+
+arena* arena_current(void) {
+  return bound;
+}
+
+void* arena_allocIn(arena* self, size_t size) {
+  if (size > CHIM_ARENA_MAXSMALL) {
+    if (size > SIZE_MAX - sizeof(arena_block)) { return NULL; }
+    arena_block* blk = allocIn(self->backing, sizeof(arena_block) + size);
+    if (blk == NULL) { return NULL; }
+    blk->owner = self;
+    blk->size = size;
+    return blk + 1;
+  }
+
+  if (atomic_load_explicit(&self->remote, memory_order_relaxed) != NULL) {
+    drainRemote(self);
+  }
+  size_t cls = classOf(size);
+  arena_block* blk = self->free[cls];
+  if (blk != NULL) {
+    self->free[cls] = *linkOf(blk);
+  }
+  else {
+    size_t usable = CHIM_ARENA_MINSMALL << cls;
+    blk = carve(self, sizeof(arena_block) + usable);
+    if (blk == NULL) { return NULL; }
+    blk->owner = self;
+    blk->size = usable;
+  }
+  return blk + 1;
+}
+
+void arena_free(void* ptr) {
+  if (ptr == NULL) { return; }
+  arena_block* blk = headerOf(ptr);
+  arena* owner = blk->owner;
+  if (blk->size > CHIM_ARENA_MAXSMALL) {
+    freeIn(owner->backing, blk);
+  }
+  else if (owner == bound) {
+    size_t cls = classOf(blk->size);
+    *linkOf(blk) = owner->free[cls];
+    owner->free[cls] = blk;
+  }
+  else {
+    arena_block* head = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    do {
+      *linkOf(blk) = head;
+    } while (!atomic_compare_exchange_weak_explicit(&owner->remote, &head, blk
+                                                   , memory_order_release, memory_order_relaxed));
+  }
+}
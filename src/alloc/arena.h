@@ -0,0 +1,126 @@
+/// @file
+/// @brief Per-thread arenas which can still be freed into from any thread.
+///
+/// Each arena is owned by (bound to) at most one thread at a time.
+/// The owner allocates small blocks from per-size-class free lists, carved out of large chunks taken from a backing allocator,
+///   without any synchronization.
+///
+/// Every block records its arena, so it may be freed by any thread.
+/// When the owner frees a block, it goes straight back onto the owner's free list.
+/// When any other thread frees a block, it is pushed onto the arena's lock-free remote-free list.
+/// The owner takes the whole remote list with one atomic exchange on its next allocation,
+///   so cross-thread frees cost one compare-and-swap for the freeing thread, and are batched for the owner.
+///
+/// Requests larger than {@link CHIM_ARENA_MAXSMALL} go directly to the backing allocator,
+///   which must therefore be safe to call from any thread (as {@link std_alloc} is).
+/// The arena does not keep track of them, so they must be freed individually: {@link arena_deinit} does not release them.
+///
+/// The allocator {@link arena_alloc} implements {@link alloc_t} on top of the calling thread's bound arena,
+///   so it may be passed to any function taking an allocator (e.g. {@link _dynarr_init}).
+
+#ifndef CHIM_ALLOC_ARENA
+#define CHIM_ALLOC_ARENA
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "alignment.h"
+#include "alloc/unaligned.h"
+#include "chimtypes.h"
+
+/// @brief Smallest block size handed out by an arena, in bytes.
+#define CHIM_ARENA_MINSMALL ((size_t)16)
+/// @brief Number of (power-of-two) size classes served from arena chunks.
+#define CHIM_ARENA_CLASSES 12
+/// @brief Largest block size served from arena chunks, in bytes.
+#define CHIM_ARENA_MAXSMALL (CHIM_ARENA_MINSMALL << (CHIM_ARENA_CLASSES - 1))
+/// @brief Size of the chunks an arena requests from its backing allocator, in bytes.
+#define CHIM_ARENA_CHUNK ((size_t)1 << 18)
+
+struct arena;
+
+/// @brief Header preceding every block handed out by an arena.
+///
+/// While a block is free, the first word of its payload links it into a free list.
+typedef struct arena_block {
+  /// @brief the arena that allocated this block
+  struct arena* owner;
+  /// @brief usable size of the block, in bytes
+  size_t size;
+} arena_block;
+
+/// @brief A chunk obtained from the backing allocator.
+typedef struct arena_chunk {
+  /// @brief previously obtained chunk
+  struct arena_chunk* next;
+  size_t _pad;
+} arena_chunk;
+
+/// @brief Thread-owned allocator.
+typedef struct arena {
+  /// @brief blocks freed by threads other than the owner
+  _Atomic(arena_block*) remote;
+  char _pad[CHIM_CACHELINE - sizeof(void*)];
+  /// @brief blocks available for reuse, by size class
+  arena_block* free[CHIM_ARENA_CLASSES];
+  /// @brief unused part of the current chunk
+  byte* bump;
+  /// @brief end of the current chunk
+  byte* bumpEnd;
+  /// @brief all chunks obtained so far
+  arena_chunk* chunks;
+  /// @brief where chunks and large blocks come from
+  alloc_t backing;
+} arena;
+
+/// @brief Allocator interface to the calling thread's bound arena.
+///
+/// Allocation fails (returning `NULL`) if no arena is bound to the calling thread.
+/// Blocks may be freed from any thread, bound or not.
+extern const alloc_t arena_alloc;
+
+/// @brief Initialize an empty arena.
+///
+/// @param self: the arena
+/// @param backing: allocator for chunks and large blocks; it must be safe to call from any thread
+void arena_init(arena* self, alloc_t backing);
+
+/// @brief Release the chunks of an arena, and with them all of its small blocks.
+///
+/// Large blocks (over {@link CHIM_ARENA_MAXSMALL} bytes) are not released: they stay valid until freed with {@link arena_free},
+///   which needs the arena itself (its backing allocator) to outlive them.
+///
+/// @warning Every small block allocated from the arena becomes invalid, and no thread may be bound to it.
+///
+/// @param self: the arena
+void arena_deinit(arena* self);
+
+/// @brief Make an arena the calling thread's own.
+///
+/// Until it is unbound (by binding another arena, or `NULL`), no other thread may be bound to the arena.
+///
+/// @param self: the arena to bind, or `NULL` to leave the calling thread without an arena
+void arena_bind(arena* self);
+
+/// @brief Get the arena bound to the calling thread.
+///
+/// @return the calling thread's arena, or `NULL` if there is none
+arena* arena_current(void);
+
+/// @brief Allocate a block from an arena.
+///
+/// @param self: an arena bound to the calling thread
+/// @param size: requested size, in bytes
+/// @return a block of at least `size` bytes, aligned as for `malloc`, or `NULL` if the backing allocator fails
+void* arena_allocIn(arena* self, size_t size);
+
+/// @brief Release a block to the arena that allocated it.
+///
+/// This may be called from any thread.
+///
+/// @param ptr: a block returned by {@link arena_allocIn} or {@link arena_alloc}, or `NULL`
+void arena_free(void* ptr);
+
+
+#endif
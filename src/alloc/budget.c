@@ -0,0 +1,157 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "budget.h"
+
+
+// Header preceding every block allocated through `budget_alloc`.
+typedef struct budget_block {
+  budget* owner;
+  size_t size;
+} budget_block;
+
+static_assert(sizeof(budget_block) % alignof(max_align_t) == 0
+             , "budget block header would misalign payloads");
+
+static _Thread_local budget* bound = NULL;
+// bytes already charged to `bound` but not yet allocated
+static _Thread_local size_t credit = 0;
+
+
+static
+bool chargeOne(budget* self, size_t bytes) {
+  size_t used = atomic_load_explicit(&self->used, memory_order_relaxed);
+  do {
+    if (bytes > self->limit || used > self->limit - bytes) { return false; }
+  } while (!atomic_compare_exchange_weak_explicit(&self->used, &used, used + bytes
+                                                 , memory_order_relaxed, memory_order_relaxed));
+  return true;
+}
+
+// Charge a budget, preferring to spend (and top up) the calling thread's credit.
+static
+bool chargeLocal(budget* self, size_t bytes) {
+  if (self != bound) { return budget_charge(self, bytes); }
+  if (credit >= bytes) {
+    credit -= bytes;
+    return true;
+  }
+  size_t want = bytes - credit;
+  if (want <= SIZE_MAX - CHIM_BUDGET_CREDIT && budget_charge(self, want + CHIM_BUDGET_CREDIT)) {
+    credit = CHIM_BUDGET_CREDIT;
+    return true;
+  }
+  // near the limit, fall back to charging exactly what is needed
+  if (budget_charge(self, want)) {
+    credit = 0;
+    return true;
+  }
+  return false;
+}
+
+static
+void releaseLocal(budget* self, size_t bytes) {
+  if (self != bound) {
+    budget_release(self, bytes);
+    return;
+  }
+  credit += bytes;
+  if (credit > 2 * CHIM_BUDGET_CREDIT) {
+    budget_release(self, credit - CHIM_BUDGET_CREDIT);
+    credit = CHIM_BUDGET_CREDIT;
+  }
+}
+
+static
+void* budget_realloc(void* ptr, size_t size) {
+  if (ptr == NULL) {
+    if (bound == NULL || size > SIZE_MAX - sizeof(budget_block)) { return NULL; }
+    size_t total = sizeof(budget_block) + size;
+    budget* owner = bound;
+    if (!chargeLocal(owner, total)) { return NULL; }
+    budget_block* blk = allocIn(owner->backing, total);
+    if (blk == NULL) {
+      releaseLocal(owner, total);
+      return NULL;
+    }
+    blk->owner = owner;
+    blk->size = size;
+    return blk + 1;
+  }
+
+  budget_block* blk = (budget_block*)ptr - 1;
+  budget* owner = blk->owner;
+  size_t old = blk->size;
+  if (size == 0) {
+    freeIn(owner->backing, blk);
+    releaseLocal(owner, sizeof(budget_block) + old);
+    return NULL;
+  }
+  if (size > SIZE_MAX - sizeof(budget_block)) { return NULL; }
+  if (size > old) {
+    if (!chargeLocal(owner, size - old)) { return NULL; }
+    budget_block* new = reallocIn(owner->backing, blk, sizeof(budget_block) + size);
+    if (new == NULL) {
+      releaseLocal(owner, size - old);
+      return NULL;
+    }
+    blk = new;
+  }
+  else {
+    budget_block* new = reallocIn(owner->backing, blk, sizeof(budget_block) + size);
+    if (new == NULL) { return NULL; }
+    releaseLocal(owner, old - size);
+    blk = new;
+  }
+  blk->size = size;
+  return blk + 1;
+}
+
+const alloc_t budget_alloc = budget_realloc;
+
+
+void budget_init(budget* self, budget* parent, size_t limit, alloc_t backing) {
+  atomic_init(&self->used, 0);
+  self->limit = limit;
+  self->parent = parent;
+  self->backing = backing;
+}
+
+bool budget_charge(budget* self, size_t bytes) {
+  for (budget* b = self; b != NULL; b = b->parent) {
+    if (!chargeOne(b, bytes)) {
+      // undo the charges already made to descendants of the budget that refused
+      for (budget* undo = self; undo != b; undo = undo->parent) {
+        atomic_fetch_sub_explicit(&undo->used, bytes, memory_order_relaxed);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+void budget_release(budget* self, size_t bytes) {
+  for (budget* b = self; b != NULL; b = b->parent) {
+    atomic_fetch_sub_explicit(&b->used, bytes, memory_order_relaxed);
+  }
+}
+
+size_t budget_used(budget* self) {
+  return atomic_load_explicit(&self->used, memory_order_relaxed);
+}
+
+void budget_bind(budget* self) {
+  if (bound != NULL && credit != 0) {
+    budget_release(bound, credit);
+  }
+  credit = 0;
+  bound = self;
+}
+
+budget* budget_current(void) {
+  return bound;
+}
@@ -0,0 +1,96 @@
+/// @file
+/// @brief Allocator that enforces a memory budget, failing allocations instead of exhausting memory.
+///
+/// A budget tracks the bytes allocated under it, and refuses to go over its limit.
+/// Budgets form a hierarchy (e.g. one per subsystem under one for the whole process):
+///   an allocation is charged to its budget and every ancestor, and fails if any of them would exceed its limit.
+/// Since every allocation in this library reports failure (e.g. {@link _dynarr_push} returns false),
+///   an exhausted budget becomes backpressure that callers can handle, rather than a visit from the OOM killer.
+///
+/// The allocator {@link budget_alloc} implements {@link alloc_t} by charging the budget bound to the calling thread
+///   (see {@link budget_bind}).
+/// Each block records its budget, so blocks may be reallocated and freed from any thread.
+///
+/// To keep the shared counters out of the fast path, each thread charges its bound budget in batches of about {@link CHIM_BUDGET_CREDIT} bytes,
+///   and then spends that credit locally.
+/// The price is that the budget counts credit that a thread has reserved but not yet used,
+///   so allocations can fail while up to twice {@link CHIM_BUDGET_CREDIT} bytes per thread are still uncommitted.
+
+#ifndef CHIM_ALLOC_BUDGET
+#define CHIM_ALLOC_BUDGET
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "alignment.h"
+#include "alloc/unaligned.h"
+
+/// @brief Number of bytes a thread charges to its bound budget at a time.
+#define CHIM_BUDGET_CREDIT ((size_t)1 << 16)
+
+/// @brief A limit on the number of bytes allocated.
+typedef struct budget {
+  /// @brief bytes currently charged to this budget (including its descendants)
+  atomic_size_t used;
+  char _pad[CHIM_CACHELINE - sizeof(size_t)];
+  /// @brief the most bytes that may be charged
+  size_t limit;
+  /// @brief enclosing budget, or `NULL`
+  struct budget* parent;
+  /// @brief where memory allocated under this budget comes from
+  alloc_t backing;
+} budget;
+
+/// @brief Allocator interface which charges the calling thread's bound budget.
+///
+/// Allocation fails (returning `NULL`) if no budget is bound to the calling thread,
+///   or if the request would exceed the limit of the bound budget or one of its ancestors.
+/// Reallocation and release are charged to the block's original budget, whichever thread performs them.
+extern const alloc_t budget_alloc;
+
+/// @brief Initialize a budget with nothing charged to it.
+///
+/// @param self: the budget
+/// @param parent: enclosing budget, which must outlive this one, or `NULL`
+/// @param limit: the most bytes that may be charged to this budget
+/// @param backing: allocator to obtain memory from; it must be safe to call from any thread using the budget
+void budget_init(budget* self, budget* parent, size_t limit, alloc_t backing);
+
+/// @brief Charge bytes to a budget and all its ancestors.
+///
+/// This is useful for accounting for memory not allocated through {@link budget_alloc}
+///   (e.g. mapped files, or buffers owned by another library).
+///
+/// @param self: the budget
+/// @param bytes: the number of bytes to charge
+/// @return false if the charge would take this budget or an ancestor over its limit (in which case nothing is charged)
+bool budget_charge(budget* self, size_t bytes);
+
+/// @brief Return bytes previously charged to a budget and all its ancestors.
+///
+/// @param self: the budget
+/// @param bytes: the number of bytes to return
+void budget_release(budget* self, size_t bytes);
+
+/// @brief Get the number of bytes charged to a budget.
+///
+/// @param self: the budget
+/// @return bytes charged, including credit reserved by threads bound to it
+size_t budget_used(budget* self);
+
+/// @brief Make the calling thread allocate under a budget.
+///
+/// Any credit the thread holds for its previous budget is returned first,
+///   so threads should bind `NULL` before exiting.
+///
+/// @param self: the budget to allocate under, or `NULL`
+void budget_bind(budget* self);
+
+/// @brief Get the budget bound to the calling thread.
+///
+/// @return the calling thread's budget, or `NULL` if there is none
+budget* budget_current(void);
+
+
+#endif
@@ -0,0 +1,329 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "io/error.h"
+#include "slice.h"
+
+#undef INLINE
+#define INLINE
+#include "shm.h"
+
+
+static const byte magic[4] = {'C', 'H', 'S', 'M'};
+
+// Each block is preceded by a header recording its class; a free block's first word links to the next in its class.
+#define BLOCKHEAD CHIM_SHM_ALIGN
+#define MINBLOCK 32
+
+static inline
+shmem_header* header(const shmem_region* r) {
+  return (shmem_header*)r->base;
+}
+
+// Critical sections are a few loads and stores, so spin briefly before giving up the processor.
+static
+void lock(shmem_header* h) {
+  for (;;) {
+    for (int i = 0; i < 64; ++i) {
+      if (atomic_load_explicit(&h->lock, memory_order_relaxed) == 0
+          && atomic_exchange_explicit(&h->lock, 1, memory_order_acquire) == 0) {
+        return;
+      }
+    }
+    sched_yield();
+  }
+}
+
+static inline
+void unlock(shmem_header* h) {
+  atomic_store_explicit(&h->lock, 0, memory_order_release);
+}
+
+// Smallest class whose blocks hold `size` bytes after their header, or CHIM_SHM_CLASSES if there is none.
+static
+unsigned classOf(size_t size) {
+  if (size > SIZE_MAX / 2 - BLOCKHEAD) { return CHIM_SHM_CLASSES; }
+  size_t need = size + BLOCKHEAD;
+  unsigned k = 0;
+  while (((size_t)MINBLOCK << k) < need) { ++k; }
+  return k;
+}
+
+static
+bool mapRegion(int fd, size_t size, shmem_region* r, io_error* err) {
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (base == MAP_FAILED) {
+    io_error_set(err, IO_OP_SETUP, errno, fd, -1);
+    return false;
+  }
+  r->base = base;
+  r->size = size;
+  r->fd = fd;
+  return true;
+}
+
+
+bool shmem_create(const char* name, size_t size, shmem_region* r, io_error* err) {
+  if (size < alignUp(sizeof(shmem_header), CHIM_SHM_ALIGN) + MINBLOCK || size > INT64_MAX) {
+    io_error_set(err, IO_OP_SETUP, EINVAL, -1, -1);
+    return false;
+  }
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd < 0) {
+    io_error_set(err, IO_OP_OPEN, errno, -1, -1);
+    return false;
+  }
+  int res;
+  do { res = ftruncate(fd, (off_t)size); } while (res < 0 && errno == EINTR);
+  if (res < 0) {
+    io_error_set(err, IO_OP_TRUNCATE, errno, fd, (int64_t)size);
+    close(fd);
+    shmem_unlink(name, NULL);
+    return false;
+  }
+  if (!mapRegion(fd, size, r, err)) {
+    close(fd);
+    shmem_unlink(name, NULL);
+    return false;
+  }
+  // the object starts zeroed, so only the non-zero fields need setting
+  shmem_header* h = header(r);
+  memcpy(h->magic, magic, sizeof(magic));
+  h->version = CHIM_SHM_VERSION;
+  h->size = size;
+  h->bump = alignUp(sizeof(shmem_header), CHIM_SHM_ALIGN);
+  atomic_store_explicit(&h->ready, 1, memory_order_release);
+  return true;
+}
+
+bool shmem_attach(const char* name, shmem_region* r, io_error* err) {
+  int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+  if (fd < 0) {
+    io_error_set(err, IO_OP_OPEN, errno, -1, -1);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    io_error_set(err, IO_OP_OPEN, errno, fd, -1);
+    close(fd);
+    return false;
+  }
+  // the creator may not have sized it yet
+  if ((size_t)st.st_size < sizeof(shmem_header)) {
+    io_error_set(err, IO_OP_SETUP, EAGAIN, fd, -1);
+    close(fd);
+    return false;
+  }
+  if (!mapRegion(fd, (size_t)st.st_size, r, err)) {
+    close(fd);
+    return false;
+  }
+  shmem_header* h = header(r);
+  int code = 0;
+  if (atomic_load_explicit(&h->ready, memory_order_acquire) == 0) { code = EAGAIN; }
+  else if (memcmp(h->magic, magic, sizeof(magic)) != 0 || h->version != CHIM_SHM_VERSION || h->size != r->size) { code = EPROTO; }
+  if (code != 0) {
+    io_error_set(err, IO_OP_SETUP, code, fd, -1);
+    shmem_detach(r);
+    return false;
+  }
+  return true;
+}
+
+void shmem_detach(shmem_region* r) {
+  munmap(r->base, r->size);
+  close(r->fd);
+  r->base = NULL;
+  r->size = 0;
+  r->fd = -1;
+}
+
+bool shmem_unlink(const char* name, io_error* err) {
+  if (shm_unlink(name) < 0) {
+    io_error_set(err, IO_OP_OPEN, errno, -1, -1);
+    return false;
+  }
+  return true;
+}
+
+uint64_t shmem_alloc(shmem_region* r, size_t size) {
+  unsigned k = classOf(size);
+  if (k >= CHIM_SHM_CLASSES) { return 0; }
+  uint64_t blockSize = (uint64_t)MINBLOCK << k;
+  shmem_header* h = header(r);
+  uint64_t block = 0;
+  lock(h);
+  if (h->free[k] != 0) {
+    block = h->free[k];
+    memcpy(&h->free[k], r->base + block + BLOCKHEAD, sizeof(uint64_t));
+  }
+  else if (blockSize <= h->size - h->bump) {
+    block = h->bump;
+    h->bump += blockSize;
+  }
+  unlock(h);
+  if (block == 0) { return 0; }
+  uint64_t cls = k;
+  memcpy(r->base + block, &cls, sizeof(cls));
+  return block + BLOCKHEAD;
+}
+
+void shmem_free(shmem_region* r, uint64_t off) {
+  if (off == 0) { return; }
+  uint64_t block = off - BLOCKHEAD;
+  uint64_t k;
+  memcpy(&k, r->base + block, sizeof(k));
+  assert(k < CHIM_SHM_CLASSES);
+  shmem_header* h = header(r);
+  lock(h);
+  memcpy(r->base + off, &h->free[k], sizeof(uint64_t));
+  h->free[k] = block;
+  unlock(h);
+}
+
+void shmem_setRoot(shmem_region* r, uint64_t off) {
+  atomic_store_explicit(&header(r)->root, off, memory_order_release);
+}
+
+uint64_t shmem_root(const shmem_region* r) {
+  return atomic_load_explicit(&header(r)->root, memory_order_acquire);
+}
+
+
+////// Arrays //////
+
+bool shmarr_init(shmem_region* r, shmarr* arr, size_t cap0, size_t elemSize) {
+  if (cap0 == 0 || cap0 > SIZE_MAX / elemSize) { return false; }
+  uint64_t off = shmem_alloc(r, cap0 * elemSize);
+  if (off == 0) { return false; }
+  arr->cap = cap0;
+  arr->len = 0;
+  arr->off = off;
+  return true;
+}
+
+void shmarr_deinit(shmem_region* r, shmarr* arr) {
+  shmem_free(r, arr->off);
+  arr->cap = 0;
+  arr->len = 0;
+  arr->off = 0;
+}
+
+bool shmarr_resize(shmem_region* r, shmarr* arr, size_t newCap, size_t elemSize) {
+  if (newCap == 0 || newCap > SIZE_MAX / elemSize) { return false; }
+  uint64_t off = shmem_alloc(r, newCap * elemSize);
+  if (off == 0) { return false; }
+  uint64_t len = arr->len < newCap ? arr->len : newCap;
+  memcpy(r->base + off, r->base + arr->off, len * elemSize);
+  shmem_free(r, arr->off);
+  arr->cap = newCap;
+  arr->len = len;
+  arr->off = off;
+  return true;
+}
+
+bool shmarr_push(shmem_region* r, shmarr* arr, const void* elem, size_t elemSize) {
+  assert(arr->cap != 0);
+  if (arr->len == arr->cap) {
+    if (arr->cap > SIZE_MAX / 2 / elemSize) { return false; }
+    if (!shmarr_resize(r, arr, 2 * arr->cap, elemSize)) { return false; }
+  }
+  memcpy(r->base + arr->off + arr->len * elemSize, elem, elemSize);
+  arr->len += 1;
+  return true;
+}
+
+
+////// Queues //////
+
+static inline
+shmq_cell* cellsOf(const shmem_region* r, const shmq* q) {
+  return (shmq_cell*)(r->base + q->cells);
+}
+
+uint64_t shmq_create(shmem_region* r, size_t cap) {
+  if (cap < 2 || (cap & (cap - 1)) != 0 || cap > SIZE_MAX / sizeof(shmq_cell)) { return 0; }
+  uint64_t off = shmem_alloc(r, sizeof(shmq));
+  if (off == 0) { return 0; }
+  uint64_t cells = shmem_alloc(r, cap * sizeof(shmq_cell));
+  if (cells == 0) {
+    shmem_free(r, off);
+    return 0;
+  }
+  shmq* q = shmem_ptr(r, off);
+  atomic_init(&q->head, 0);
+  atomic_init(&q->tail, 0);
+  q->mask = cap - 1;
+  q->cells = cells;
+  shmq_cell* c = cellsOf(r, q);
+  // cell `i` is first free for the producer of word number `i`
+  for (size_t i = 0; i < cap; ++i) {
+    atomic_init(&c[i].seq, i);
+    c[i].val = 0;
+  }
+  return off;
+}
+
+void shmq_destroy(shmem_region* r, uint64_t off) {
+  if (off == 0) { return; }
+  shmq* q = shmem_ptr(r, off);
+  shmem_free(r, q->cells);
+  shmem_free(r, off);
+}
+
+bool shmq_push(const shmem_region* r, shmq* q, uint64_t val) {
+  shmq_cell* cells = cellsOf(r, q);
+  uint64_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+  for (;;) {
+    shmq_cell* c = &cells[pos & q->mask];
+    uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    int64_t dif = (int64_t)(seq - pos);
+    if (dif == 0) {
+      // the cell is free for word `pos`: claim it
+      if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        c->val = val;
+        atomic_store_explicit(&c->seq, pos + 1, memory_order_release);
+        return true;
+      }
+    }
+    // the cell still holds the word from one lap ago
+    else if (dif < 0) { return false; }
+    else { pos = atomic_load_explicit(&q->tail, memory_order_relaxed); }
+  }
+}
+
+bool shmq_pop(const shmem_region* r, shmq* q, uint64_t* val) {
+  shmq_cell* cells = cellsOf(r, q);
+  uint64_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+  for (;;) {
+    shmq_cell* c = &cells[pos & q->mask];
+    uint64_t seq = atomic_load_explicit(&c->seq, memory_order_acquire);
+    int64_t dif = (int64_t)(seq - (pos + 1));
+    if (dif == 0) {
+      // the cell holds word `pos`: claim it
+      if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+        *val = c->val;
+        // free the cell for the producer one lap ahead
+        atomic_store_explicit(&c->seq, pos + q->mask + 1, memory_order_release);
+        return true;
+      }
+    }
+    // the cell has not been filled yet
+    else if (dif < 0) { return false; }
+    else { pos = atomic_load_explicit(&q->head, memory_order_relaxed); }
+  }
+}
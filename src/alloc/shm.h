@@ -0,0 +1,277 @@
+/// @file
+/// @brief Allocation in POSIX shared memory, shared between processes, with arrays and queues that live there.
+///
+/// A _region_ is a named shared memory object (see `shm_open(3)`) which each cooperating process maps, likely at different addresses.
+/// So nothing inside a region may hold an absolute pointer: references are byte offsets from the start of the region,
+///   converted to and from local addresses with {@link shmem_ptr} and {@link shmem_offOf}.
+/// The offset zero (where the region's header sits) serves as the null offset.
+/// (Functions on regions are prefixed `shmem_`, to stay clear of the POSIX `shm_` names.)
+///
+/// Every process may allocate and free blocks in a region.
+/// Blocks come in power-of-two size classes, with a free list per class, and are carved from the unused end of the region when a list is empty;
+///   the allocator state lives in the region's header, behind a spin lock.
+/// Rounding up to a power of two wastes up to half of each block, which is the price of constant-time allocation without fragmentation bookkeeping.
+/// The region never grows: allocation fails once the unused end is exhausted.
+///
+/// Built on blocks are:
+///   * {@link shmarr}: a growable array (like {@link _dynarr}), whose elements are in the region;
+///   * {@link shmq}: a bounded lock-free queue of 64-bit words (Vyukov's algorithm), for any number of producer and consumer processes.
+/// Pushing the offset of a block onto a queue hands the block to another process without copying it.
+///
+/// Synchronization within a region relies on lock-free atomics, which are address-free, and so work across processes.
+///
+/// @warning A process that dies while allocating (i.e. holding the region's lock) leaves the region locked.
+///   The region is a cooperative structure: a misbehaving process can corrupt it for all.
+
+#ifndef CHIM_ALLOC_SHM
+#define CHIM_ALLOC_SHM
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alignment.h"
+#include "chimtypes.h"
+#include "io/error.h"
+#include "slice.h"
+
+/// @brief Version of the region layout, checked by {@link shmem_attach}.
+#define CHIM_SHM_VERSION 1
+/// @brief Number of block size classes; class `k` holds blocks of `32 << k` bytes, header included.
+#define CHIM_SHM_CLASSES 48
+/// @brief Alignment of every block.
+#define CHIM_SHM_ALIGN 16
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shared memory needs address-free atomics");
+
+
+/// @brief The start of a region.
+typedef struct shmem_header {
+  /// @brief `"CHSM"`
+  byte magic[4];
+  /// @brief {@link CHIM_SHM_VERSION}
+  uint32_t version;
+  /// @brief size of the region, in bytes
+  uint64_t size;
+  /// @brief set once the creator has initialized the header
+  _Atomic uint32_t ready;
+  /// @brief held while allocating or freeing
+  _Atomic uint32_t lock;
+  /// @brief offset of the unused end of the region
+  uint64_t bump;
+  /// @brief offset of the first free block of each class, or zero
+  uint64_t free[CHIM_SHM_CLASSES];
+  /// @brief offset of an object the processes agree to start from, or zero
+  _Atomic uint64_t root;
+} shmem_header;
+
+/// @brief A process's view of a region.
+typedef struct shmem_region {
+  /// @brief where the region is mapped in this process
+  byte* base;
+  /// @brief size of the region, in bytes
+  size_t size;
+  /// @brief the shared memory object
+  int fd;
+} shmem_region;
+
+/// @brief Create a new region, and map it.
+///
+/// @param name: name of the shared memory object (`/` followed by up to 254 characters, none of them `/`)
+/// @param size: size of the region, in bytes
+/// @param r: the region
+/// @param err: where to record a failure (may be `NULL`)
+/// @return false on failure (including if the name is already in use)
+bool shmem_create(const char* name, size_t size, shmem_region* r, io_error* err);
+
+/// @brief Map an existing region.
+///
+/// Fails (with `EAGAIN`) if the creator has not finished initializing the region, and (with `EPROTO`) if it is not a region at all.
+///
+/// @param name: name of the shared memory object
+/// @param r: the region
+/// @param err: where to record a failure (may be `NULL`)
+/// @return false on failure
+bool shmem_attach(const char* name, shmem_region* r, io_error* err);
+
+/// @brief Unmap a region from this process.
+///
+/// The region itself persists, until it is unlinked and every process has detached.
+///
+/// @param r: the region
+void shmem_detach(shmem_region* r);
+
+/// @brief Remove a region's name, so that no more processes can attach.
+///
+/// @param name: name of the shared memory object
+/// @param err: where to record a failure (may be `NULL`)
+/// @return false on failure
+bool shmem_unlink(const char* name, io_error* err);
+
+/// @brief Convert an offset in a region to a local address.
+///
+/// @param r: the region
+/// @param off: offset, or zero
+/// @return the address, or `NULL` for offset zero
+INLINE
+void* shmem_ptr(const shmem_region* r, uint64_t off) {
+  assert(off < r->size);
+  return off == 0 ? NULL : r->base + off;
+}
+
+/// @brief Convert a local address within a region to an offset.
+///
+/// @param r: the region
+/// @param ptr: an address within the region, or `NULL`
+/// @return the offset, or zero for `NULL`
+INLINE
+uint64_t shmem_offOf(const shmem_region* r, const void* ptr) {
+  if (ptr == NULL) { return 0; }
+  assert((const byte*)ptr > r->base && (const byte*)ptr < r->base + r->size);
+  return (uint64_t)((const byte*)ptr - r->base);
+}
+
+/// @brief Allocate a block in a region.
+///
+/// @param r: the region
+/// @param size: requested size, in bytes
+/// @return offset of a block of at least `size` bytes, aligned to {@link CHIM_SHM_ALIGN}, or zero if the region is exhausted
+uint64_t shmem_alloc(shmem_region* r, size_t size);
+
+/// @brief Free a block, from any process.
+///
+/// @param r: the region
+/// @param off: offset returned by {@link shmem_alloc}, or zero
+void shmem_free(shmem_region* r, uint64_t off);
+
+/// @brief Publish the offset of an object for other processes to find.
+///
+/// @param r: the region
+/// @param off: offset of the object, or zero
+void shmem_setRoot(shmem_region* r, uint64_t off);
+
+/// @brief Find the object published with {@link shmem_setRoot}.
+///
+/// @param r: the region
+/// @return its offset, or zero
+uint64_t shmem_root(const shmem_region* r);
+
+
+/// @brief Growable array in a region.
+///
+/// The structure itself may live in the region (e.g. inside a larger object) or in local memory; its elements are always in the region.
+/// It is not synchronized: processes must agree on who may change it and when.
+typedef struct shmarr {
+  /// @brief capacity, in elements
+  uint64_t cap;
+  /// @brief length, in elements
+  uint64_t len;
+  /// @brief offset of the elements
+  uint64_t off;
+} shmarr;
+
+/// @brief Initialize an empty array.
+///
+/// @param r: the region
+/// @param arr: the array
+/// @param cap0: initial capacity, in elements (must not be zero)
+/// @param elemSize: size of an element, in bytes
+/// @return false if the region is exhausted
+bool shmarr_init(shmem_region* r, shmarr* arr, size_t cap0, size_t elemSize);
+
+/// @brief Free the elements.
+///
+/// @param r: the region
+/// @param arr: the array
+void shmarr_deinit(shmem_region* r, shmarr* arr);
+
+/// @brief Copy an element to the end of the array, doubling the capacity if needed.
+///
+/// @param r: the region
+/// @param arr: the array
+/// @param elem: the element
+/// @param elemSize: size of an element, in bytes
+/// @return false if the region is exhausted
+bool shmarr_push(shmem_region* r, shmarr* arr, const void* elem, size_t elemSize);
+
+/// @brief Grow or shrink the capacity of the array, truncating elements that no longer fit.
+///
+/// @param r: the region
+/// @param arr: the array
+/// @param newCap: the new capacity, in elements (must not be zero)
+/// @param elemSize: size of an element, in bytes
+/// @return false if the region is exhausted
+bool shmarr_resize(shmem_region* r, shmarr* arr, size_t newCap, size_t elemSize);
+
+/// @brief View the elements from this process.
+///
+/// @param r: the region
+/// @param arr: the array
+/// @return the elements (invalidated by any change in capacity)
+INLINE
+_larr shmarr_view(const shmem_region* r, const shmarr* arr) {
+  return _larr_mk(arr->len, shmem_ptr(r, arr->off));
+}
+
+
+/// @brief A cell of a {@link shmq}.
+typedef struct shmq_cell {
+  /// @brief sequence number, saying whose turn it is to use the cell
+  _Atomic uint64_t seq;
+  /// @brief the word stored
+  uint64_t val;
+} shmq_cell;
+
+/// @brief Bounded multi-producer multi-consumer queue of words, in a region.
+typedef struct shmq {
+  /// @brief count of words dequeued
+  _Atomic uint64_t head;
+  char _pad0[CHIM_CACHELINE - sizeof(uint64_t)];
+  /// @brief count of words enqueued
+  _Atomic uint64_t tail;
+  char _pad1[CHIM_CACHELINE - sizeof(uint64_t)];
+  /// @brief number of cells, less one (the number of cells is a power of two)
+  uint64_t mask;
+  /// @brief offset of the cells
+  uint64_t cells;
+} shmq;
+
+/// @brief Create a queue in a region.
+///
+/// @param r: the region
+/// @param cap: capacity, in words (a power of two, at least two)
+/// @return offset of the queue, or zero if the region is exhausted
+uint64_t shmq_create(shmem_region* r, size_t cap);
+
+/// @brief Free a queue.
+///
+/// @warning No process may be using the queue when this is called.
+///
+/// @param r: the region
+/// @param off: offset of the queue
+void shmq_destroy(shmem_region* r, uint64_t off);
+
+/// @brief Enqueue a word, without blocking.
+///
+/// @param r: the region
+/// @param q: the queue (e.g. from `shmem_ptr(r, off)`)
+/// @param val: the word (e.g. the offset of a block being handed over)
+/// @return false if the queue is full
+bool shmq_push(const shmem_region* r, shmq* q, uint64_t val);
+
+/// @brief Dequeue a word, without blocking.
+///
+/// @param r: the region
+/// @param q: the queue
+/// @param val: where to store the word
+/// @return false if the queue is empty
+bool shmq_pop(const shmem_region* r, shmq* q, uint64_t* val);
+
+
+#endif
@@ -79,14 +79,14 @@ INLINE uintptr_t getTag(tagged_ptr ptr) {
 /// @brief Alter the tag on an existing tagged pointer.
 /// @see to_tagged_ptr to create a new tagged pointer
 INLINE tagged_ptr setTag(tagged_ptr ptr, uintptr_t tag) {
-  assert((tag & CHIM_PTRTAGBITS_MAX) == 0);
-  bitsptr_t out = {.u = ptr.u | tag};
+  assert((tag & CHIM_PTRTAG_PTRMASK) == 0);
+  bitsptr_t out = {.u = (ptr.u & CHIM_PTRTAG_PTRMASK) | tag};
   return out;
 }
 
 INLINE bool is_taggable(void* ptr) {
   bitsptr_t bits = {.p = ptr};
-  return (bits.u & CHIM_PTRTAG_PTRMASK) == 0;
+  return (bits.u & CHIM_PTRTAG_BITSMASK) == 0;
 }
 
 
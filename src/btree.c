@@ -0,0 +1,498 @@
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/aligned.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+#undef INLINE
+#define INLINE
+#include "btree.h"
+
+
+#define KEYOFF CHIM_BTREE_KEYOFF
+
+typedef _btree_node node;
+
+// a step down the tree: the node, and which child was taken (or, in a leaf, which entry)
+typedef struct step {
+  node* n;
+  size_t idx;
+} step;
+
+
+////// Node access //////
+
+static inline
+void* keyAt(const _btree* t, const node* n, size_t i) {
+  return (char*)n + KEYOFF + i * t->cls->keySize;
+}
+
+static inline
+void* valAt(const _btree* t, const node* n, size_t i) {
+  return (char*)n + t->valOff + i * t->cls->valSize;
+}
+
+static inline
+node** kidsOf(const _btree* t, const node* n) {
+  return (node**)((char*)n + t->kidOff);
+}
+
+// Move `count` keys within or between nodes (the ranges may overlap).
+static inline
+void moveKeys(const _btree* t, node* dst, size_t di, const node* src, size_t si, size_t count) {
+  memmove(keyAt(t, dst, di), keyAt(t, src, si), count * t->cls->keySize);
+}
+
+static inline
+void moveVals(const _btree* t, node* dst, size_t di, const node* src, size_t si, size_t count) {
+  memmove(valAt(t, dst, di), valAt(t, src, si), count * t->cls->valSize);
+}
+
+static inline
+void moveKids(const _btree* t, node* dst, size_t di, const node* src, size_t si, size_t count) {
+  memmove(kidsOf(t, dst) + di, kidsOf(t, src) + si, count * sizeof(node*));
+}
+
+// Fetch all the cache lines holding a node's keys at once, before searching them:
+//   the misses then overlap, rather than each probe of the binary search waiting for its own.
+static inline
+void prefetchKeys(const _btree* t, const node* n) {
+  const char* end = keyAt(t, n, n->len);
+  for (const char* line = (const char*)n + CHIM_CACHELINE; line < end; line += CHIM_CACHELINE) {
+    __builtin_prefetch(line);
+  }
+}
+
+// Index of the child of an internal node whose subtree may hold `key`: the number of separators not greater than it.
+static inline
+size_t childFor(const _btree* t, const node* n, const void* key) {
+  prefetchKeys(t, n);
+  size_t i = t->cls->search(keyAt(t, n, 0), n->len, key);
+  return i + (i < n->len && !t->cls->less(key, keyAt(t, n, i)));
+}
+
+static
+node* newNode(aligned_alloc_t mem, const _btree* t, bool leaf) {
+  node* n = aallocIn(mem, CHIM_CACHELINE, leaf ? t->leafSize : t->innerSize);
+  if (n == NULL) { return NULL; }
+  n->len = 0;
+  n->leaf = leaf;
+  n->next = NULL;
+  return n;
+}
+
+static
+void freeNodes(aligned_alloc_t mem, const _btree* t, node* n, uint32_t height) {
+  if (height != 0) {
+    node** kids = kidsOf(t, n);
+    for (size_t i = 0; i <= n->len; ++i) {
+      freeNodes(mem, t, kids[i], height - 1);
+    }
+  }
+  afreeIn(mem, n);
+}
+
+
+////// Map //////
+
+void _btree_init(_btree* t, const _btree_class* cls) {
+  t->cls = cls;
+  t->root = NULL;
+  t->len = 0;
+  t->height = 0;
+  // leaves: header, keys, values; internal nodes: header, keys, children
+  // Take as many entries as fit the target size, but at least four, and round the size up to whole cache lines.
+  size_t target = CHIM_BTREE_NODEBYTES - KEYOFF;
+  size_t valPad = cls->valAlign - 1;
+  size_t leafCap = (target - valPad) / (cls->keySize + cls->valSize);
+  if (leafCap < 4) { leafCap = 4; }
+  size_t kidPad = alignof(node*) - 1;
+  size_t innerCap = (target - kidPad - sizeof(node*)) / (cls->keySize + sizeof(node*));
+  if (innerCap < 4) { innerCap = 4; }
+  if (leafCap > UINT16_MAX / 4) { leafCap = UINT16_MAX / 4; }
+  if (innerCap > UINT16_MAX / 4) { innerCap = UINT16_MAX / 4; }
+  t->leafCap = leafCap;
+  t->innerCap = innerCap;
+  t->valOff = alignUp(KEYOFF + leafCap * cls->keySize, cls->valAlign);
+  t->kidOff = alignUp(KEYOFF + innerCap * cls->keySize, alignof(node*));
+  t->leafSize = alignUp(t->valOff + leafCap * cls->valSize, CHIM_CACHELINE);
+  t->innerSize = alignUp(t->kidOff + (innerCap + 1) * sizeof(node*), CHIM_CACHELINE);
+}
+
+void _btree_deinit(aligned_alloc_t mem, _btree* t) {
+  if (t->root != NULL) { freeNodes(mem, t, t->root, t->height); }
+  t->root = NULL;
+  t->len = 0;
+  t->height = 0;
+}
+
+void* _btree_get(const _btree* t, const void* key) {
+  node* n = t->root;
+  if (n == NULL) { return NULL; }
+  for (uint32_t h = t->height; h != 0; --h) {
+    n = kidsOf(t, n)[childFor(t, n, key)];
+  }
+  prefetchKeys(t, n);
+  size_t i = t->cls->search(keyAt(t, n, 0), n->len, key);
+  if (i < n->len && !t->cls->less(key, keyAt(t, n, i))) { return valAt(t, n, i); }
+  return NULL;
+}
+
+// Walk from the root to the leaf which may hold `key`, recording the path.
+// Return the index in the leaf where the key is, or would be inserted.
+static
+size_t descend(const _btree* t, const void* key, step* path) {
+  node* n = t->root;
+  for (uint32_t h = 0; h < t->height; ++h) {
+    size_t i = childFor(t, n, key);
+    path[h] = (step){n, i};
+    n = kidsOf(t, n)[i];
+  }
+  size_t i = t->cls->search(keyAt(t, n, 0), n->len, key);
+  path[t->height] = (step){n, i};
+  return i;
+}
+
+// Insert a separator and the child to its right into an internal node with room.
+static inline
+void innerInsert(const _btree* t, node* n, size_t i, const void* key, node* right) {
+  moveKeys(t, n, i + 1, n, i, n->len - i);
+  moveKids(t, n, i + 2, n, i + 1, n->len - i);
+  memcpy(keyAt(t, n, i), key, t->cls->keySize);
+  kidsOf(t, n)[i + 1] = right;
+  n->len += 1;
+}
+
+bool _btree_put(aligned_alloc_t mem, _btree* t, const void* key, const void* val) {
+  const _btree_class* cls = t->cls;
+  if (t->root == NULL) {
+    node* leaf = newNode(mem, t, true);
+    if (leaf == NULL) { return false; }
+    memcpy(keyAt(t, leaf, 0), key, cls->keySize);
+    memcpy(valAt(t, leaf, 0), val, cls->valSize);
+    leaf->len = 1;
+    t->root = leaf;
+    t->len = 1;
+    return true;
+  }
+  step path[CHIM_BTREE_MAXHEIGHT + 1];
+  size_t i = descend(t, key, path);
+  node* leaf = path[t->height].n;
+  if (i < leaf->len && !cls->less(key, keyAt(t, leaf, i))) {
+    memcpy(valAt(t, leaf, i), val, cls->valSize);
+    return true;
+  }
+
+  // Allocate every node the insertion will need before changing anything, so that failure leaves the tree intact:
+  //   one per full node, from the leaf up, and a new root if they are all full.
+  node* spare[CHIM_BTREE_MAXHEIGHT + 2];
+  size_t nSpare = 0;
+  for (int64_t h = t->height; h >= 0; --h) {
+    node* n = path[h].n;
+    if (n->len < (n->leaf ? t->leafCap : t->innerCap)) { break; }
+    spare[nSpare++] = NULL;
+    if (h == 0) { spare[nSpare++] = NULL; }
+  }
+  for (size_t s = 0; s < nSpare; ++s) {
+    // the first is the new leaf, the rest are internal (a new root is internal too)
+    spare[s] = newNode(mem, t, s == 0);
+    if (spare[s] == NULL) {
+      while (s-- != 0) { afreeIn(mem, spare[s]); }
+      return false;
+    }
+  }
+  size_t used = 0;
+
+  // insert into the leaf, splitting it if full
+  char sep[cls->keySize];
+  node* right = NULL;
+  if (leaf->len < t->leafCap) {
+    moveKeys(t, leaf, i + 1, leaf, i, leaf->len - i);
+    moveVals(t, leaf, i + 1, leaf, i, leaf->len - i);
+    memcpy(keyAt(t, leaf, i), key, cls->keySize);
+    memcpy(valAt(t, leaf, i), val, cls->valSize);
+    leaf->len += 1;
+  }
+  else {
+    right = spare[used++];
+    size_t mid = t->leafCap / 2;
+    right->len = leaf->len - mid;
+    moveKeys(t, right, 0, leaf, mid, right->len);
+    moveVals(t, right, 0, leaf, mid, right->len);
+    leaf->len = mid;
+    right->next = leaf->next;
+    leaf->next = right;
+    node* into = i <= mid ? leaf : right;
+    size_t j = i <= mid ? i : i - mid;
+    moveKeys(t, into, j + 1, into, j, into->len - j);
+    moveVals(t, into, j + 1, into, j, into->len - j);
+    memcpy(keyAt(t, into, j), key, cls->keySize);
+    memcpy(valAt(t, into, j), val, cls->valSize);
+    into->len += 1;
+    memcpy(sep, keyAt(t, right, 0), cls->keySize);
+  }
+  t->len += 1;
+
+  // carry splits upward
+  for (int64_t h = (int64_t)t->height - 1; right != NULL && h >= 0; --h) {
+    node* n = path[h].n;
+    size_t at = path[h].idx;
+    if (n->len < t->innerCap) {
+      innerInsert(t, n, at, sep, right);
+      right = NULL;
+      break;
+    }
+    // Lay out all cap+1 separators and cap+2 children in order, then split them around the middle separator,
+    //   which moves up to the parent.
+    size_t cap = t->innerCap;
+    char keys[(cap + 1) * cls->keySize];
+    node* kids[cap + 2];
+    memcpy(keys, keyAt(t, n, 0), at * cls->keySize);
+    memcpy(keys + at * cls->keySize, sep, cls->keySize);
+    memcpy(keys + (at + 1) * cls->keySize, keyAt(t, n, at), (cap - at) * cls->keySize);
+    memcpy(kids, kidsOf(t, n), (at + 1) * sizeof(node*));
+    kids[at + 1] = right;
+    memcpy(kids + at + 2, kidsOf(t, n) + at + 1, (cap - at) * sizeof(node*));
+    size_t half = cap / 2;
+    node* sib = spare[used++];
+    n->len = half;
+    memcpy(keyAt(t, n, 0), keys, half * cls->keySize);
+    memcpy(kidsOf(t, n), kids, (half + 1) * sizeof(node*));
+    sib->len = cap - half;
+    memcpy(keyAt(t, sib, 0), keys + (half + 1) * cls->keySize, sib->len * cls->keySize);
+    memcpy(kidsOf(t, sib), kids + half + 1, (sib->len + 1) * sizeof(node*));
+    memcpy(sep, keys + half * cls->keySize, cls->keySize);
+    right = sib;
+  }
+
+  // the root split: grow a new root above it
+  if (right != NULL) {
+    node* root = spare[used++];
+    root->len = 1;
+    memcpy(keyAt(t, root, 0), sep, cls->keySize);
+    kidsOf(t, root)[0] = t->root;
+    kidsOf(t, root)[1] = right;
+    t->root = root;
+    t->height += 1;
+  }
+  assert(used == nSpare);
+  return true;
+}
+
+// Fix an underfull node at depth `h` (below the root) by borrowing from, or merging with, a sibling.
+// Return whether the parent lost an entry (by a merge), and so may be underfull itself.
+static
+bool rebalance(aligned_alloc_t mem, _btree* t, step* path, uint32_t h) {
+  node* n = path[h].n;
+  node* parent = path[h - 1].n;
+  size_t ci = path[h - 1].idx;
+  node** pk = kidsOf(t, parent);
+  node* left = ci > 0 ? pk[ci - 1] : NULL;
+  node* right = ci < parent->len ? pk[ci + 1] : NULL;
+  if (n->leaf) {
+    size_t min = t->leafCap / 2;
+    if (left != NULL && left->len > min) {
+      moveKeys(t, n, 1, n, 0, n->len);
+      moveVals(t, n, 1, n, 0, n->len);
+      moveKeys(t, n, 0, left, left->len - 1, 1);
+      moveVals(t, n, 0, left, left->len - 1, 1);
+      left->len -= 1;
+      n->len += 1;
+      moveKeys(t, parent, ci - 1, n, 0, 1);
+      return false;
+    }
+    if (right != NULL && right->len > min) {
+      moveKeys(t, n, n->len, right, 0, 1);
+      moveVals(t, n, n->len, right, 0, 1);
+      n->len += 1;
+      right->len -= 1;
+      moveKeys(t, right, 0, right, 1, right->len);
+      moveVals(t, right, 0, right, 1, right->len);
+      moveKeys(t, parent, ci, right, 0, 1);
+      return false;
+    }
+    // merge the right one of a pair into the left
+    if (left == NULL) { left = n; n = right; ci += 1; }
+    moveKeys(t, left, left->len, n, 0, n->len);
+    moveVals(t, left, left->len, n, 0, n->len);
+    left->len += n->len;
+    left->next = n->next;
+  }
+  else {
+    size_t min = t->innerCap / 2;
+    node** kids = kidsOf(t, n);
+    if (left != NULL && left->len > min) {
+      moveKeys(t, n, 1, n, 0, n->len);
+      moveKids(t, n, 1, n, 0, n->len + 1);
+      moveKeys(t, n, 0, parent, ci - 1, 1);
+      kids[0] = kidsOf(t, left)[left->len];
+      moveKeys(t, parent, ci - 1, left, left->len - 1, 1);
+      left->len -= 1;
+      n->len += 1;
+      return false;
+    }
+    if (right != NULL && right->len > min) {
+      moveKeys(t, n, n->len, parent, ci, 1);
+      kids[n->len + 1] = kidsOf(t, right)[0];
+      n->len += 1;
+      moveKeys(t, parent, ci, right, 0, 1);
+      moveKeys(t, right, 0, right, 1, right->len - 1);
+      moveKids(t, right, 0, right, 1, right->len);
+      right->len -= 1;
+      return false;
+    }
+    if (left == NULL) { left = n; n = right; ci += 1; }
+    // the separator between the pair comes down between their keys
+    moveKeys(t, left, left->len, parent, ci - 1, 1);
+    moveKeys(t, left, left->len + 1, n, 0, n->len);
+    moveKids(t, left, left->len + 1, n, 0, n->len + 1);
+    left->len += 1 + n->len;
+  }
+  // the right node of the pair is gone: remove it and its separator from the parent
+  moveKeys(t, parent, ci - 1, parent, ci, parent->len - ci);
+  moveKids(t, parent, ci, parent, ci + 1, parent->len - ci);
+  parent->len -= 1;
+  afreeIn(mem, n);
+  return true;
+}
+
+bool _btree_del(aligned_alloc_t mem, _btree* t, const void* key, void* val) {
+  if (t->root == NULL) { return false; }
+  step path[CHIM_BTREE_MAXHEIGHT + 1];
+  size_t i = descend(t, key, path);
+  node* leaf = path[t->height].n;
+  if (i >= leaf->len || t->cls->less(key, keyAt(t, leaf, i))) { return false; }
+  if (val != NULL) { memcpy(val, valAt(t, leaf, i), t->cls->valSize); }
+  moveKeys(t, leaf, i, leaf, i + 1, leaf->len - i - 1);
+  moveVals(t, leaf, i, leaf, i + 1, leaf->len - i - 1);
+  leaf->len -= 1;
+  t->len -= 1;
+
+  // Separators above may still equal the removed key; that is harmless, as they only need to divide the keys correctly.
+  uint32_t h = t->height;
+  while (h != 0) {
+    node* n = path[h].n;
+    size_t min = n->leaf ? t->leafCap / 2 : t->innerCap / 2;
+    if (n->len >= min || !rebalance(mem, t, path, h)) { break; }
+    h -= 1;
+  }
+  node* root = t->root;
+  if (root->len == 0) {
+    if (t->height == 0) {
+      t->root = NULL;
+    }
+    else {
+      t->root = kidsOf(t, root)[0];
+      t->height -= 1;
+    }
+    afreeIn(mem, root);
+  }
+  return true;
+}
+
+bool _btree_load(aligned_alloc_t mem, _btree* t, _larr keys, const void* vals) {
+  assert(t->root == NULL);
+  const _btree_class* cls = t->cls;
+  size_t n = keys.len;
+  if (n == 0) { return true; }
+  for (size_t i = 1; i < n; ++i) {
+    if (!cls->less(keys.arr + (i - 1) * cls->keySize, keys.arr + i * cls->keySize)) { return false; }
+  }
+  // Each level is built from the one below, as a list of nodes and the least key under each.
+  // Entries are dealt out evenly, so that every node (including the last) is at least half full.
+  size_t count = (n + t->leafCap - 1) / t->leafCap;
+  struct level { node* n; const void* least; }* level = aallocIn(mem, alignof(struct level), count * sizeof(struct level));
+  if (level == NULL) { return false; }
+  const char* valBytes = vals;
+  node* prev = NULL;
+  size_t done = 0;
+  for (size_t l = 0; l < count; ++l) {
+    node* leaf = newNode(mem, t, true);
+    if (leaf == NULL) { goto fail; }
+    size_t take = (n - done) / (count - l);
+    memcpy(keyAt(t, leaf, 0), keys.arr + done * cls->keySize, take * cls->keySize);
+    memcpy(valAt(t, leaf, 0), valBytes + done * cls->valSize, take * cls->valSize);
+    leaf->len = take;
+    done += take;
+    if (prev != NULL) { prev->next = leaf; }
+    prev = leaf;
+    level[l] = (struct level){leaf, keyAt(t, leaf, 0)};
+  }
+  uint32_t height = 0;
+  while (count > 1) {
+    size_t fan = t->innerCap + 1;
+    size_t up = (count + fan - 1) / fan;
+    size_t from = 0;
+    for (size_t u = 0; u < up; ++u) {
+      size_t take = (count - from) / (up - u);
+      node* inner = newNode(mem, t, false);
+      if (inner == NULL) {
+        // the nodes of this level not yet gathered, and those already built above them, hold the whole tree between them
+        for (size_t k = 0; k < u; ++k) { freeNodes(mem, t, level[k].n, height + 1); }
+        for (size_t k = from; k < count; ++k) { freeNodes(mem, t, level[k].n, height); }
+        afreeIn(mem, level);
+        return false;
+      }
+      node** kids = kidsOf(t, inner);
+      for (size_t k = 0; k < take; ++k) {
+        kids[k] = level[from + k].n;
+        if (k != 0) { memcpy(keyAt(t, inner, k - 1), level[from + k].least, cls->keySize); }
+      }
+      inner->len = take - 1;
+      const void* least = level[from].least;
+      from += take;
+      level[u] = (struct level){inner, least};
+    }
+    count = up;
+    height += 1;
+  }
+  t->root = level[0].n;
+  t->height = height;
+  t->len = n;
+  afreeIn(mem, level);
+  return true;
+
+fail:
+  for (node* leaf = level[0].n; prev != NULL && leaf != NULL;) {
+    node* next = leaf->next;
+    afreeIn(mem, leaf);
+    leaf = next;
+  }
+  afreeIn(mem, level);
+  return false;
+}
+
+_btree_iter _btree_seek(const _btree* t, const void* key) {
+  _btree_iter it = {t, NULL, 0};
+  node* n = t->root;
+  if (n == NULL) { return it; }
+  for (uint32_t h = t->height; h != 0; --h) {
+    n = kidsOf(t, n)[childFor(t, n, key)];
+  }
+  it.leaf = n;
+  it.idx = t->cls->search(keyAt(t, n, 0), n->len, key);
+  // the first key not less may be in the next leaf
+  if (it.idx >= n->len) {
+    it.leaf = n->next;
+    it.idx = 0;
+  }
+  return it;
+}
+
+_btree_iter _btree_first(const _btree* t) {
+  _btree_iter it = {t, NULL, 0};
+  node* n = t->root;
+  if (n == NULL) { return it; }
+  for (uint32_t h = t->height; h != 0; --h) {
+    n = kidsOf(t, n)[0];
+  }
+  it.leaf = n;
+  return it;
+}
@@ -0,0 +1,394 @@
+/// @file
+/// @brief Polymorphic ordered maps, as B+trees with cache-line-sized nodes.
+///
+/// A B+tree keeps its entries sorted in wide leaves, linked left-to-right for range scans,
+///   under a shallow tree of wide internal nodes.
+/// Each node is a few cache lines (see {@link CHIM_BTREE_NODEBYTES}), with its keys contiguous,
+///   so a lookup costs about one cache miss per level, and there are only `log_B(n)` levels for fanout `B`
+///   (for 8-byte keys, `B` is about 30, so a million entries are four levels deep).
+/// Within a node, the search is a branchless binary search, with no mispredicted branches to pay for.
+/// Nodes are allocated through an {@link aligned_alloc_t} at cache-line alignment; entries are stored unboxed.
+///
+/// Keys and values are copied into the tree, and are not otherwise owned by it:
+///   e.g. a tree keyed by {@link larr_byte} stores the slices, not the bytes they view.
+///
+/// A sorted array of entries can be loaded in linear time with {@link _btree_load}, which packs the leaves densely.
+///
+/// ### Polymorphic Usage
+///
+/// Make sure that the corresponding C file is included in your build
+///   (either by compiling as its own translation unit, or as part of a larger unit).
+///
+/// Then, instantiate this header at a key type name and value type name with:
+///
+/// ```
+/// #define BTREE_KEY <type name>
+/// #define BTREE_VAL <type name>
+/// #define BTREE_LESS(a, b) <expression> // optional
+/// #include <this header>
+/// ```
+/// The type names must be identifiers, _not_ type expressions.
+/// `BTREE_LESS` is the strict ordering of keys, given two key values; by default it is `((a) < (b))`,
+///   which suits arithmetic types. For byte-slice keys, use {@link btree_lessBytes}.
+/// The header will automatically undefine these macros when it is done.
+///
+/// After instantiation, identifiers of the form `/_btree(_<base name>)?/` in {@link btree.h} are rewritten to
+///   `btree(_<base name>)?_<key type name>_<value type name>`.
+/// Arguments marked _suppressed_ are removed from the argument list, and keys and values are passed by value.
+/// For example, instantiating with `uint64_t` keys and `any` values specializes {@link _btree_get}
+///   to `any* btree_get_uint64_t_any(const btree_uint64_t_any* t, uint64_t key)`.
+/// The iterator type is shared by all instantiations, but the accessors are specialized:
+///   `btree_key_<K>_<V>` and `btree_val_<K>_<V>` return typed pointers.
+
+#ifndef CHIM_BTREE
+#define CHIM_BTREE
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "alloc/aligned.h"
+#include "chimtypes.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+/// @brief Target size of a node, in bytes (eight cache lines).
+///
+/// Nodes holding very large keys or values grow past this, to keep at least four entries.
+#define CHIM_BTREE_NODEBYTES 512
+
+/// @brief Greatest height of a tree (far beyond what fits in memory, with at least four entries per node).
+#define CHIM_BTREE_MAXHEIGHT 32
+
+
+/// @brief How to store and order one type of key and value.
+///
+/// Instantiation makes one of these for each key and value type.
+typedef struct _btree_class {
+  /// @brief size of a key
+  size_t keySize;
+  /// @brief alignment of a key
+  size_t keyAlign;
+  /// @brief size of a value
+  size_t valSize;
+  /// @brief alignment of a value
+  size_t valAlign;
+  /// @brief number of the first `n` keys at `keys` which are less than `key`
+  size_t (*search)(const void* keys, size_t n, const void* key);
+  /// @brief whether key `a` orders before key `b`
+  bool (*less)(const void* a, const void* b);
+} _btree_class;
+
+/// @brief Ordered map.
+typedef struct _btree {
+  /// @brief key and value types
+  const _btree_class* cls;
+  /// @brief root node, or `NULL` when empty
+  void* root;
+  /// @brief number of entries
+  size_t len;
+  /// @brief number of internal levels above the leaves
+  uint32_t height;
+  /// @brief most entries in a leaf
+  uint16_t leafCap;
+  /// @brief most keys in an internal node (which has one more child)
+  uint16_t innerCap;
+  /// @brief byte offset of the values in a leaf
+  uint32_t valOff;
+  /// @brief byte offset of the children in an internal node
+  uint32_t kidOff;
+  /// @brief size of a leaf, in bytes
+  uint32_t leafSize;
+  /// @brief size of an internal node, in bytes
+  uint32_t innerSize;
+} _btree;
+
+/// @brief Position of an entry, for scanning in order.
+typedef struct _btree_iter {
+  /// @brief the tree
+  const _btree* tree;
+  /// @brief leaf holding the entry, or `NULL` past the end
+  void* leaf;
+  /// @brief index of the entry in the leaf
+  size_t idx;
+} _btree_iter;
+
+/// @brief Start of every node.
+typedef struct _btree_node {
+  /// @brief number of keys
+  uint32_t len;
+  /// @brief whether this is a leaf
+  uint32_t leaf;
+  /// @brief next leaf to the right, or `NULL` (unused in internal nodes)
+  void* next;
+} _btree_node;
+
+/// @brief Byte offset of the keys in every node.
+#define CHIM_BTREE_KEYOFF sizeof(_btree_node)
+
+/// @brief Initialize an empty tree.
+///
+/// @param t: the tree
+/// @param cls: (_suppressed_) key and value types
+void _btree_init(_btree* t, const _btree_class* cls);
+
+/// @brief Free all of a tree's nodes.
+///
+/// @param mem: allocator
+/// @param t: the tree
+void _btree_deinit(aligned_alloc_t mem, _btree* t);
+
+/// @brief Look up a key.
+///
+/// @param t: the tree
+/// @param key: the key
+/// @return the key's value, or `NULL` if the key is absent (the pointer is invalidated by any update)
+void* _btree_get(const _btree* t, const void* key);
+
+/// @brief Insert a key, or replace its value.
+///
+/// @param mem: allocator
+/// @param t: the tree
+/// @param key: the key
+/// @param val: the value
+/// @return false if allocation fails (the tree is unchanged)
+bool _btree_put(aligned_alloc_t mem, _btree* t, const void* key, const void* val);
+
+/// @brief Remove a key.
+///
+/// @param mem: allocator
+/// @param t: the tree
+/// @param key: the key
+/// @param val: where to store the removed value, or `NULL`
+/// @return false if the key was absent
+bool _btree_del(aligned_alloc_t mem, _btree* t, const void* key, void* val);
+
+/// @brief Fill an empty tree from sorted entries, in linear time.
+///
+/// @param mem: allocator
+/// @param t: the tree, which must be empty
+/// @param keys: the keys, in strictly increasing order
+/// @param vals: the values, as many as the keys
+/// @return false if the keys are not strictly increasing, or allocation fails (the tree stays empty)
+bool _btree_load(aligned_alloc_t mem, _btree* t, _larr keys, const void* vals);
+
+/// @brief Position at the first entry whose key is not less than a given key.
+///
+/// @param t: the tree
+/// @param key: the key
+/// @return the position, which is past the end if every key is less
+_btree_iter _btree_seek(const _btree* t, const void* key);
+
+/// @brief Position at the first entry.
+///
+/// @param t: the tree
+/// @return the position, which is past the end if the tree is empty
+_btree_iter _btree_first(const _btree* t);
+
+/// @brief Whether a position is at an entry (rather than past the end).
+INLINE
+bool _btree_valid(const _btree_iter* it) {
+  return it->leaf != NULL;
+}
+
+/// @brief Move to the next entry.
+///
+/// @param it: a valid position
+INLINE
+void _btree_next(_btree_iter* it) {
+  const _btree_node* leaf = it->leaf;
+  if (++it->idx >= leaf->len) {
+    it->leaf = leaf->next;
+    it->idx = 0;
+  }
+}
+
+/// @brief The key at a position.
+///
+/// @param it: a valid position
+/// @return pointer to the key, which must not be modified
+INLINE
+void* _btree_key(const _btree_iter* it) {
+  return (char*)it->leaf + CHIM_BTREE_KEYOFF + it->idx * it->tree->cls->keySize;
+}
+
+/// @brief The value at a position.
+///
+/// @param it: a valid position
+/// @return pointer to the value (invalidated by any update)
+INLINE
+void* _btree_val(const _btree_iter* it) {
+  return (char*)it->leaf + it->tree->valOff + it->idx * it->tree->cls->valSize;
+}
+
+/// @brief Lexicographic order of byte slices, for `BTREE_LESS`.
+INLINE
+bool btree_lessBytes(larr_byte a, larr_byte b) {
+  size_t n = a.len < b.len ? a.len : b.len;
+  int c = n == 0 ? 0 : memcmp(a.arr, b.arr, n);
+  return c < 0 || (c == 0 && a.len < b.len);
+}
+
+
+#endif
+
+
+
+
+#if defined(BTREE_KEY) && defined(BTREE_VAL)
+  #ifndef BTREE_LESS
+    #define BTREE_LESS(a, b) ((a) < (b))
+  #endif
+  // macros to paste expanded arguments
+  #define _btree_paste(K, V) btree_ ## K ## _ ## V
+  #define _btree_class_paste(K, V) btree_class_ ## K ## _ ## V
+  #define _btree_search_paste(K, V) btree_search_ ## K ## _ ## V
+  #define _btree_less_paste(K, V) btree_less_ ## K ## _ ## V
+  #define _btree_init_paste(K, V) btree_init_ ## K ## _ ## V
+  #define _btree_deinit_paste(K, V) btree_deinit_ ## K ## _ ## V
+  #define _btree_get_paste(K, V) btree_get_ ## K ## _ ## V
+  #define _btree_put_paste(K, V) btree_put_ ## K ## _ ## V
+  #define _btree_del_paste(K, V) btree_del_ ## K ## _ ## V
+  #define _btree_load_paste(K, V) btree_load_ ## K ## _ ## V
+  #define _btree_seek_paste(K, V) btree_seek_ ## K ## _ ## V
+  #define _btree_first_paste(K, V) btree_first_ ## K ## _ ## V
+  #define _btree_key_paste(K, V) btree_key_ ## K ## _ ## V
+  #define _btree_val_paste(K, V) btree_val_ ## K ## _ ## V
+  // macros I actually use
+  #define btree(K, V) _btree_paste(K, V)
+  #define btree_class(K, V) _btree_class_paste(K, V)
+  #define btree_search(K, V) _btree_search_paste(K, V)
+  #define btree_less(K, V) _btree_less_paste(K, V)
+  #define btree_init(K, V) _btree_init_paste(K, V)
+  #define btree_deinit(K, V) _btree_deinit_paste(K, V)
+  #define btree_get(K, V) _btree_get_paste(K, V)
+  #define btree_put(K, V) _btree_put_paste(K, V)
+  #define btree_del(K, V) _btree_del_paste(K, V)
+  #define btree_load(K, V) _btree_load_paste(K, V)
+  #define btree_seek(K, V) _btree_seek_paste(K, V)
+  #define btree_first(K, V) _btree_first_paste(K, V)
+  #define btree_key(K, V) _btree_key_paste(K, V)
+  #define btree_val(K, V) _btree_val_paste(K, V)
+
+typedef struct btree(BTREE_KEY, BTREE_VAL) {
+  _btree base;
+} btree(BTREE_KEY, BTREE_VAL);
+
+// Branchless lower bound: halve the range with a conditional move, rather than a branch, at each step.
+static inline
+size_t btree_search(BTREE_KEY, BTREE_VAL)(const void* keys, size_t n, const void* key) {
+  const BTREE_KEY* base = keys;
+  const BTREE_KEY k = *(const BTREE_KEY*)key;
+  if (n == 0) { return 0; }
+  while (n > 1) {
+    size_t half = n / 2;
+    base = BTREE_LESS(base[half - 1], k) ? base + half : base;
+    n -= half;
+  }
+  return (base - (const BTREE_KEY*)keys) + BTREE_LESS(base[0], k);
+}
+
+static inline
+bool btree_less(BTREE_KEY, BTREE_VAL)(const void* a, const void* b) {
+  return BTREE_LESS(*(const BTREE_KEY*)a, *(const BTREE_KEY*)b);
+}
+
+static const _btree_class btree_class(BTREE_KEY, BTREE_VAL) = {
+  .keySize = sizeof(BTREE_KEY),
+  .keyAlign = alignof(BTREE_KEY),
+  .valSize = sizeof(BTREE_VAL),
+  .valAlign = alignof(BTREE_VAL),
+  .search = btree_search(BTREE_KEY, BTREE_VAL),
+  .less = btree_less(BTREE_KEY, BTREE_VAL),
+};
+
+static inline
+void btree_init(BTREE_KEY, BTREE_VAL)(btree(BTREE_KEY, BTREE_VAL)* t) {
+  _btree_init(&t->base, &btree_class(BTREE_KEY, BTREE_VAL));
+}
+
+static inline
+void btree_deinit(BTREE_KEY, BTREE_VAL)(aligned_alloc_t mem, btree(BTREE_KEY, BTREE_VAL)* t) {
+  _btree_deinit(mem, &t->base);
+}
+
+static inline
+BTREE_VAL* btree_get(BTREE_KEY, BTREE_VAL)(const btree(BTREE_KEY, BTREE_VAL)* t, BTREE_KEY key) {
+  return _btree_get(&t->base, &key);
+}
+
+static inline
+bool btree_put(BTREE_KEY, BTREE_VAL)(aligned_alloc_t mem, btree(BTREE_KEY, BTREE_VAL)* t, BTREE_KEY key, BTREE_VAL val) {
+  return _btree_put(mem, &t->base, &key, &val);
+}
+
+static inline
+bool btree_del(BTREE_KEY, BTREE_VAL)(aligned_alloc_t mem, btree(BTREE_KEY, BTREE_VAL)* t, BTREE_KEY key, BTREE_VAL* val) {
+  return _btree_del(mem, &t->base, &key, val);
+}
+
+// load `n` entries from arrays (e.g. the contents of a larr or dynarr) of keys and values
+static inline
+bool btree_load(BTREE_KEY, BTREE_VAL)(aligned_alloc_t mem, btree(BTREE_KEY, BTREE_VAL)* t, size_t n, const BTREE_KEY* keys, const BTREE_VAL* vals) {
+  return _btree_load(mem, &t->base, _larr_mk(n, (void*)keys), vals);
+}
+
+static inline
+_btree_iter btree_seek(BTREE_KEY, BTREE_VAL)(const btree(BTREE_KEY, BTREE_VAL)* t, BTREE_KEY key) {
+  return _btree_seek(&t->base, &key);
+}
+
+static inline
+_btree_iter btree_first(BTREE_KEY, BTREE_VAL)(const btree(BTREE_KEY, BTREE_VAL)* t) {
+  return _btree_first(&t->base);
+}
+
+static inline
+const BTREE_KEY* btree_key(BTREE_KEY, BTREE_VAL)(const _btree_iter* it) {
+  return _btree_key(it);
+}
+
+static inline
+BTREE_VAL* btree_val(BTREE_KEY, BTREE_VAL)(const _btree_iter* it) {
+  return _btree_val(it);
+}
+
+  #undef btree_val
+  #undef btree_key
+  #undef btree_first
+  #undef btree_seek
+  #undef btree_load
+  #undef btree_del
+  #undef btree_put
+  #undef btree_get
+  #undef btree_deinit
+  #undef btree_init
+  #undef btree_less
+  #undef btree_search
+  #undef btree_class
+  #undef btree
+  #undef _btree_val_paste
+  #undef _btree_key_paste
+  #undef _btree_first_paste
+  #undef _btree_seek_paste
+  #undef _btree_load_paste
+  #undef _btree_del_paste
+  #undef _btree_put_paste
+  #undef _btree_get_paste
+  #undef _btree_deinit_paste
+  #undef _btree_init_paste
+  #undef _btree_less_paste
+  #undef _btree_search_paste
+  #undef _btree_class_paste
+  #undef _btree_paste
+  #undef BTREE_LESS
+  #undef BTREE_VAL
+  #undef BTREE_KEY
+#endif
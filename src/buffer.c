@@ -7,7 +7,7 @@
 
 bool _dynarr_init(alloc_t mem, _dynarr* arr, size_t cap0, size_t size) {
   if (cap0 == 0) { return false; }
-  if (cap0 * size < size) { return false; }
+  if (cap0 > SIZE_MAX / size) { return false; }
   arr->buf = allocIn(mem, cap0 * size);
   if (arr->buf == NULL) { return false; }
   arr->cap = cap0;
@@ -25,11 +25,12 @@ void _dynarr_deinit(alloc_t mem, _dynarr* arr) {
 bool _dynarr_push(alloc_t mem, _dynarr* arr, const void* elem, size_t elemSize) {
   assert(arr->cap != 0);
   if (arr->len == arr->cap) {
-    if (arr->cap >= SIZE_MAX/2) { return false; }
-    arr->cap *= 2;
-    char* new = reallocIn(mem, arr->buf, arr->cap * elemSize);
-    if (arr->buf == NULL) { return false; }
+    if (arr->cap > SIZE_MAX / 2 / elemSize) { return false; }
+    // only commit to the new capacity once the allocator agrees, so that failure leaves the array intact
+    char* new = reallocIn(mem, arr->buf, 2 * arr->cap * elemSize);
+    if (new == NULL) { return false; }
     arr->buf = new;
+    arr->cap *= 2;
   }
   memcpy(&arr->buf[elemSize * arr->len], elem, elemSize);
   arr->len += 1;
@@ -49,7 +50,8 @@ void* _dynarr_pop(_dynarr* arr, size_t elemSize) {
 
 bool _dynarr_resize(alloc_t mem, _dynarr* arr, size_t newCap, size_t elemSize) {
   if (newCap == 0) { return false; }
-  char* new = reallocIn(mem, arr->buf, arr->cap * elemSize);
+  if (newCap > SIZE_MAX / elemSize) { return false; }
+  char* new = reallocIn(mem, arr->buf, newCap * elemSize);
   if (new == NULL) { return false; }
   arr->cap = newCap;
   if (newCap < arr->len) {
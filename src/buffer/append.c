@@ -0,0 +1,130 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "append.h"
+
+
+static
+appendbuf_segment* newSegment(appendbuf* buf) {
+  appendbuf_segment* seg = allocIn(buf->mem, sizeof(appendbuf_segment) + buf->segSize);
+  if (seg == NULL) { return NULL; }
+  atomic_init(&seg->reserved, 0);
+  atomic_init(&seg->committed, 0);
+  atomic_init(&seg->end, SIZE_MAX);
+  atomic_init(&seg->next, NULL);
+  seg->cap = buf->segSize;
+  return seg;
+}
+
+// Ensure `seg` has a successor, which is returned (or `NULL` if allocation fails).
+static
+appendbuf_segment* ensureNext(appendbuf* buf, appendbuf_segment* seg) {
+  appendbuf_segment* next = atomic_load_explicit(&seg->next, memory_order_acquire);
+  if (next != NULL) { return next; }
+  appendbuf_segment* fresh = newSegment(buf);
+  if (fresh == NULL) { return NULL; }
+  if (atomic_compare_exchange_strong(&seg->next, &next, fresh)) {
+    return fresh;
+  }
+  freeIn(buf->mem, fresh);
+  return next;
+}
+
+// Move the tail past a full segment.
+static
+bool advance(appendbuf* buf, appendbuf_segment* full) {
+  appendbuf_segment* next = ensureNext(buf, full);
+  if (next == NULL) { return false; }
+  if (atomic_compare_exchange_strong(&buf->tail, &full, next)) {
+    // whoever moves the tail pays for the segment after it, so that other writers need not allocate;
+    // if this fails, a writer that overflows `next` will try again
+    ensureNext(buf, next);
+  }
+  return true;
+}
+
+
+bool appendbuf_init(appendbuf* buf, alloc_t mem, size_t segSize) {
+  buf->mem = mem;
+  buf->segSize = segSize;
+  buf->head = newSegment(buf);
+  if (buf->head == NULL) { return false; }
+  atomic_init(&buf->tail, buf->head);
+  ensureNext(buf, buf->head);
+  return true;
+}
+
+void appendbuf_deinit(appendbuf* buf) {
+  appendbuf_segment* seg = buf->head;
+  while (seg != NULL) {
+    appendbuf_segment* next = atomic_load_explicit(&seg->next, memory_order_relaxed);
+    freeIn(buf->mem, seg);
+    seg = next;
+  }
+  buf->head = NULL;
+  atomic_store(&buf->tail, NULL);
+}
+
+bool appendbuf_reserve(appendbuf* buf, size_t len, appendbuf_slot* out) {
+  if (len > buf->segSize) { return false; }
+  for (;;) {
+    appendbuf_segment* seg = atomic_load_explicit(&buf->tail, memory_order_acquire);
+    size_t off = atomic_fetch_add_explicit(&seg->reserved, len, memory_order_relaxed);
+    if (off + len <= seg->cap) {
+      out->seg = seg;
+      out->ptr = &seg->data[off];
+      out->len = len;
+      return true;
+    }
+    // reservations partition the number line, so exactly one of them straddles the capacity
+    if (off <= seg->cap) {
+      atomic_store_explicit(&seg->end, off, memory_order_release);
+    }
+    if (!advance(buf, seg)) { return false; }
+  }
+}
+
+void appendbuf_commit(const appendbuf_slot* slot) {
+  atomic_fetch_add_explicit(&slot->seg->committed, slot->len, memory_order_release);
+}
+
+bool appendbuf_append(appendbuf* buf, larr_byte rec) {
+  appendbuf_slot slot;
+  if (!appendbuf_reserve(buf, rec.len, &slot)) { return false; }
+  memcpy(slot.ptr, rec.arr, rec.len);
+  appendbuf_commit(&slot);
+  return true;
+}
+
+appendbuf_cursor appendbuf_begin(const appendbuf* buf) {
+  appendbuf_cursor out = { .seg = buf->head, .off = 0 };
+  return out;
+}
+
+bool appendbuf_read(appendbuf_cursor* cur, larr_byte* out) {
+  for (;;) {
+    appendbuf_segment* seg = cur->seg;
+    size_t end = atomic_load_explicit(&seg->end, memory_order_acquire);
+    // committed must be read before reserved:
+    // then, if they are equal, every reservation made before reading `committed` was already committed
+    size_t committed = atomic_load_explicit(&seg->committed, memory_order_acquire);
+    size_t reserved = atomic_load_explicit(&seg->reserved, memory_order_relaxed);
+    size_t limit = end != SIZE_MAX ? end
+                 : reserved < seg->cap ? reserved
+                 : seg->cap;
+    if (committed != limit) { return false; }
+    if (cur->off < committed) {
+      *out = larr_mk_byte(committed - cur->off, &seg->data[cur->off]);
+      cur->off = committed;
+      return true;
+    }
+    if (end == SIZE_MAX) { return false; }
+    appendbuf_segment* next = atomic_load_explicit(&seg->next, memory_order_acquire);
+    if (next == NULL) { return false; }
+    cur->seg = next;
+    cur->off = 0;
+  }
+}
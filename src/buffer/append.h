@@ -0,0 +1,137 @@
+/// @file
+/// @brief Append-only byte buffer shared by many writers without locks.
+///
+/// The buffer is a chain of fixed-size segments.
+/// A writer reserves space for a whole record with a single `fetch_add` on the current segment,
+///   fills it in without synchronization, and then publishes it by adding its length to the segment's commit counter.
+/// When a reservation does not fit, the segment is sealed and writers move on to the next one
+///   (which is normally allocated ahead of time, so writers rarely allocate).
+///
+/// Records never straddle segments, so a record can be no larger than a segment.
+///
+/// Readers consume the buffer through a cursor (see {@link appendbuf_read}), which yields `larr_byte` views.
+/// A view only ever covers bytes that are committed, and is never interrupted by a record still being written:
+///   a segment's committed bytes become visible when its commit counter catches up with its reservations.
+/// Since segments are never freed while the buffer is live, views remain valid until {@link appendbuf_deinit}.
+
+#ifndef CHIM_BUFFER_APPEND
+#define CHIM_BUFFER_APPEND
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alignment.h"
+#include "alloc/unaligned.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief One fixed-size block of an {@link appendbuf}.
+typedef struct appendbuf_segment {
+  /// @brief number of bytes reserved by writers (exceeds the capacity once the segment is full)
+  atomic_size_t reserved;
+  char _pad0[CHIM_CACHELINE - sizeof(size_t)];
+  /// @brief number of bytes published by writers
+  atomic_size_t committed;
+  char _pad1[CHIM_CACHELINE - sizeof(size_t)];
+  /// @brief length of the segment's data once sealed, or `SIZE_MAX` while writers may still reserve in it
+  atomic_size_t end;
+  /// @brief the following segment, possibly allocated before this one is full
+  _Atomic(struct appendbuf_segment*) next;
+  /// @brief capacity of `data`, in bytes
+  size_t cap;
+  /// @brief the records
+  byte data[];
+} appendbuf_segment;
+
+/// @brief Append-only buffer that multiple threads may write concurrently.
+typedef struct appendbuf {
+  /// @brief segment writers currently reserve into
+  _Atomic(appendbuf_segment*) tail;
+  char _pad[CHIM_CACHELINE - sizeof(void*)];
+  /// @brief first segment
+  appendbuf_segment* head;
+  /// @brief capacity of each segment, in bytes
+  size_t segSize;
+  /// @brief allocator for segments
+  alloc_t mem;
+} appendbuf;
+
+/// @brief Space reserved for one record.
+typedef struct appendbuf_slot {
+  /// @brief segment the space was reserved in
+  appendbuf_segment* seg;
+  /// @brief start of the reserved space
+  byte* ptr;
+  /// @brief size of the reserved space, in bytes
+  size_t len;
+} appendbuf_slot;
+
+/// @brief Position of a reader in an {@link appendbuf}.
+typedef struct appendbuf_cursor {
+  /// @brief segment being read
+  appendbuf_segment* seg;
+  /// @brief number of bytes of the segment already read
+  size_t off;
+} appendbuf_cursor;
+
+/// @brief Initialize an empty buffer.
+///
+/// The first segment is allocated immediately, and so is the one after it.
+///
+/// @param buf: the buffer
+/// @param mem: allocator for segments
+/// @param segSize: capacity of each segment, in bytes (the largest record that can be appended)
+/// @return false if allocation fails
+bool appendbuf_init(appendbuf* buf, alloc_t mem, size_t segSize);
+
+/// @brief Free all segments.
+///
+/// @warning No thread may be writing to or reading from the buffer, and all views into it become invalid.
+///
+/// @param buf: the buffer
+void appendbuf_deinit(appendbuf* buf);
+
+/// @brief Reserve space for a record.
+///
+/// The caller may then write to `out->ptr` without synchronization,
+///   and must eventually call {@link appendbuf_commit}, since readers cannot see past an uncommitted record.
+///
+/// @param buf: the buffer
+/// @param len: size of the record, in bytes
+/// @param out: the reserved space
+/// @return false if `len` is larger than a segment, or a new segment could not be allocated
+bool appendbuf_reserve(appendbuf* buf, size_t len, appendbuf_slot* out);
+
+/// @brief Publish a record written into reserved space.
+///
+/// @param slot: space obtained from {@link appendbuf_reserve}
+void appendbuf_commit(const appendbuf_slot* slot);
+
+/// @brief Copy a record into the buffer.
+///
+/// @param buf: the buffer
+/// @param rec: the record
+/// @return false if the record could not be reserved (see {@link appendbuf_reserve})
+bool appendbuf_append(appendbuf* buf, larr_byte rec);
+
+/// @brief Create a cursor at the start of the buffer.
+///
+/// @param buf: the buffer
+/// @return a cursor before the first byte of the buffer
+appendbuf_cursor appendbuf_begin(const appendbuf* buf);
+
+/// @brief Read the next committed region.
+///
+/// Each call yields bytes that directly follow those of the previous call, up to the end of a segment.
+/// Regions always begin and end on record boundaries.
+///
+/// @param cur: the cursor, which is advanced past the returned region
+/// @param out: the region read
+/// @return false if there is currently no more committed data (`out` is not modified)
+bool appendbuf_read(appendbuf_cursor* cur, larr_byte* out);
+
+
+#endif
@@ -0,0 +1,135 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cow.h"
+
+
+static
+cowbuf_store* newStore(alloc_t mem, size_t cap) {
+  if (cap > SIZE_MAX - sizeof(cowbuf_store)) { return NULL; }
+  cowbuf_store* store = allocIn(mem, sizeof(cowbuf_store) + cap);
+  if (store == NULL) { return NULL; }
+  atomic_init(&store->refs, 1);
+  store->cap = cap;
+  return store;
+}
+
+static
+void release(alloc_t mem, cowbuf_store* store) {
+  if (atomic_fetch_sub_explicit(&store->refs, 1, memory_order_release) == 1) {
+    // make every other handle's reads of the store happen before it is freed
+    atomic_thread_fence(memory_order_acquire);
+    freeIn(mem, store);
+  }
+}
+
+// Give the handle a store of its own with at least `cap` bytes of capacity.
+static
+bool reserve(alloc_t mem, cowbuf* buf, size_t cap) {
+  cowbuf_store* old = buf->store;
+  if (!cowbuf_isShared(buf)) {
+    if (cap <= old->cap) { return true; }
+    if (cap > SIZE_MAX - sizeof(cowbuf_store)) { return false; }
+    cowbuf_store* new = reallocIn(mem, old, sizeof(cowbuf_store) + cap);
+    if (new == NULL) { return false; }
+    new->cap = cap;
+    buf->store = new;
+    return true;
+  }
+  cowbuf_store* new = newStore(mem, cap);
+  if (new == NULL) { return false; }
+  memcpy(new->data, old->data, buf->len);
+  buf->store = new;
+  release(mem, old);
+  return true;
+}
+
+// Make room for `extra` more bytes, doubling the capacity as needed.
+static
+bool grow(alloc_t mem, cowbuf* buf, size_t extra) {
+  if (extra > SIZE_MAX - buf->len) { return false; }
+  size_t need = buf->len + extra;
+  size_t cap = buf->store->cap;
+  if (need > cap) {
+    cap = cap > SIZE_MAX / 2 ? need : 2 * cap;
+    if (cap < need) { cap = need; }
+  }
+  return reserve(mem, buf, cap);
+}
+
+
+bool cowbuf_init(alloc_t mem, cowbuf* buf, size_t cap0) {
+  if (cap0 == 0) { return false; }
+  buf->store = newStore(mem, cap0);
+  if (buf->store == NULL) { return false; }
+  buf->len = 0;
+  return true;
+}
+
+bool cowbuf_fromSlice(alloc_t mem, cowbuf* buf, larr_byte src) {
+  if (!cowbuf_init(mem, buf, src.len == 0 ? 1 : src.len)) { return false; }
+  memcpy(buf->store->data, src.arr, src.len);
+  buf->len = src.len;
+  return true;
+}
+
+void cowbuf_deinit(alloc_t mem, cowbuf* buf) {
+  release(mem, buf->store);
+  buf->store = NULL;
+  buf->len = 0;
+}
+
+cowbuf cowbuf_clone(const cowbuf* buf) {
+  atomic_fetch_add_explicit(&buf->store->refs, 1, memory_order_relaxed);
+  return *buf;
+}
+
+bool cowbuf_isShared(const cowbuf* buf) {
+  return atomic_load_explicit(&buf->store->refs, memory_order_acquire) != 1;
+}
+
+larr_byte cowbuf_view(const cowbuf* buf) {
+  return larr_mk_byte(buf->len, buf->store->data);
+}
+
+byte* cowbuf_mut(alloc_t mem, cowbuf* buf) {
+  if (!reserve(mem, buf, buf->store->cap)) { return NULL; }
+  return buf->store->data;
+}
+
+bool cowbuf_push(alloc_t mem, cowbuf* buf, byte elem) {
+  if (!grow(mem, buf, 1)) { return false; }
+  buf->store->data[buf->len++] = elem;
+  return true;
+}
+
+bool cowbuf_append(alloc_t mem, cowbuf* buf, larr_byte src) {
+  if (!grow(mem, buf, src.len)) { return false; }
+  memcpy(&buf->store->data[buf->len], src.arr, src.len);
+  buf->len += src.len;
+  return true;
+}
+
+bool cowbuf_resize(alloc_t mem, cowbuf* buf, size_t newCap) {
+  if (newCap == 0) { return false; }
+  size_t len = buf->len < newCap ? buf->len : newCap;
+  if (cowbuf_isShared(buf)) {
+    cowbuf_store* new = newStore(mem, newCap);
+    if (new == NULL) { return false; }
+    memcpy(new->data, buf->store->data, len);
+    release(mem, buf->store);
+    buf->store = new;
+  }
+  else {
+    if (newCap > SIZE_MAX - sizeof(cowbuf_store)) { return false; }
+    cowbuf_store* new = reallocIn(mem, buf->store, sizeof(cowbuf_store) + newCap);
+    if (new == NULL) { return false; }
+    new->cap = newCap;
+    buf->store = new;
+  }
+  buf->len = len;
+  return true;
+}
@@ -0,0 +1,124 @@
+/// @file
+/// @brief Growable byte buffer with copy-on-write sharing.
+///
+/// Several handles may share one backing store, which carries an atomic reference count.
+/// Cloning a handle (see {@link cowbuf_clone}) only increments that count, so one assembled payload can be handed to any number of consumers for free.
+/// The first mutation through a handle whose store is shared copies the contents into a store of its own;
+///   after that, the handle mutates in place again.
+///
+/// Handles themselves are not synchronized: each one should be used by one thread at a time.
+/// Different handles to the same store may be used (and released) concurrently.
+///
+/// As with {@link buffer.h}, the allocator is passed to each operation that may need it;
+///   every handle sharing a store must use the same allocator.
+
+#ifndef CHIM_BUFFER_COW
+#define CHIM_BUFFER_COW
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "alloc/unaligned.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief Reference-counted backing store of a {@link cowbuf}.
+typedef struct cowbuf_store {
+  /// @brief number of handles sharing this store
+  atomic_size_t refs;
+  /// @brief capacity of `data`, in bytes
+  size_t cap;
+  /// @brief the contents
+  byte data[];
+} cowbuf_store;
+
+/// @brief Handle to a (possibly shared) byte buffer.
+typedef struct cowbuf {
+  /// @brief number of bytes in this handle's view of the store
+  size_t len;
+  /// @brief backing store
+  cowbuf_store* store;
+} cowbuf;
+
+/// @brief Initialize an empty buffer with its own store.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @param cap0: initial capacity, in bytes (must not be zero)
+/// @return false if allocation fails
+bool cowbuf_init(alloc_t mem, cowbuf* buf, size_t cap0);
+
+/// @brief Initialize a buffer with a copy of some bytes.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @param src: the bytes to copy
+/// @return false if allocation fails
+bool cowbuf_fromSlice(alloc_t mem, cowbuf* buf, larr_byte src);
+
+/// @brief Release a handle, freeing the store if this was the last handle sharing it.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+void cowbuf_deinit(alloc_t mem, cowbuf* buf);
+
+/// @brief Create another handle sharing the same store, in constant time.
+///
+/// @param buf: the buffer
+/// @return a handle with the same contents, which must also be released with {@link cowbuf_deinit}
+cowbuf cowbuf_clone(const cowbuf* buf);
+
+/// @brief Whether other handles currently share this handle's store.
+///
+/// @param buf: the buffer
+/// @return true if a mutation through this handle would copy the store
+bool cowbuf_isShared(const cowbuf* buf);
+
+/// @brief View the contents of a buffer.
+///
+/// The view is invalidated by any mutation through this handle, and by releasing it.
+///
+/// @param buf: the buffer
+/// @return the bytes of the buffer
+larr_byte cowbuf_view(const cowbuf* buf);
+
+/// @brief Obtain write access to the contents of a buffer.
+///
+/// If the store is shared, it is copied first.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @return a pointer to the (unshared) contents, or `NULL` if allocation fails
+byte* cowbuf_mut(alloc_t mem, cowbuf* buf);
+
+/// @brief Copy a byte to the end of the buffer.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @param elem: the byte
+/// @return false if allocation fails
+bool cowbuf_push(alloc_t mem, cowbuf* buf, byte elem);
+
+/// @brief Copy bytes to the end of the buffer.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @param src: the bytes to copy (which may not lie within this buffer's store)
+/// @return false if allocation fails
+bool cowbuf_append(alloc_t mem, cowbuf* buf, larr_byte src);
+
+/// @brief Grow or shrink the capacity of the buffer.
+///
+/// If the capacity is smaller than the current length, bytes will be truncated off the end.
+/// As with {@link cowbuf_init}, the capacity cannot be zero.
+///
+/// @param mem: allocator
+/// @param buf: the buffer
+/// @param newCap: the requested new capacity, in bytes
+/// @return false if allocation fails
+bool cowbuf_resize(alloc_t mem, cowbuf* buf, size_t newCap);
+
+
+#endif
@@ -0,0 +1,93 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "gap.h"
+
+
+static inline
+size_t gapSize(const gapbuf* gb) {
+  return gb->text.cap - gb->text.len;
+}
+
+static inline
+byte* afterGap(const gapbuf* gb) {
+  return gb->text.buf + gb->cursor + gapSize(gb);
+}
+
+
+bool gapbuf_init(alloc_t mem, gapbuf* gb, size_t cap0) {
+  if (!dynarr_init_byte(mem, &gb->text, cap0)) { return false; }
+  gb->cursor = 0;
+  return true;
+}
+
+bool gapbuf_fromSlice(alloc_t mem, gapbuf* gb, larr_byte src, size_t gap0) {
+  if (gap0 == 0 || src.len > SIZE_MAX - gap0) { return false; }
+  if (!dynarr_init_byte(mem, &gb->text, src.len + gap0)) { return false; }
+  memcpy(gb->text.buf, src.arr, src.len);
+  gb->text.len = src.len;
+  gb->cursor = src.len;
+  return true;
+}
+
+void gapbuf_deinit(alloc_t mem, gapbuf* gb) {
+  dynarr_deinit_byte(mem, &gb->text);
+  gb->cursor = 0;
+}
+
+void gapbuf_views(const gapbuf* gb, larr_byte* before, larr_byte* after) {
+  *before = larr_mk_byte(gb->cursor, gb->text.buf);
+  *after = larr_mk_byte(gb->text.len - gb->cursor, afterGap(gb));
+}
+
+byte* gapbuf_addrof(const gapbuf* gb, size_t index) {
+  if (index >= gb->text.len) { return NULL; }
+  if (index < gb->cursor) { return &gb->text.buf[index]; }
+  return &gb->text.buf[index + gapSize(gb)];
+}
+
+void gapbuf_moveTo(gapbuf* gb, size_t pos) {
+  if (pos > gb->text.len) { pos = gb->text.len; }
+  size_t gap = gapSize(gb);
+  if (pos < gb->cursor) {
+    // the bytes in [pos, cursor) move to just before the end of the gap
+    memmove(&gb->text.buf[pos + gap], &gb->text.buf[pos], gb->cursor - pos);
+  }
+  else {
+    // the bytes just after the gap move to its start
+    memmove(&gb->text.buf[gb->cursor], afterGap(gb), pos - gb->cursor);
+  }
+  gb->cursor = pos;
+}
+
+bool gapbuf_insert(alloc_t mem, gapbuf* gb, larr_byte src) {
+  if (src.len > gapSize(gb)) {
+    size_t oldCap = gb->text.cap;
+    size_t len = gb->text.len;
+    if (src.len > SIZE_MAX - len) { return false; }
+    size_t newCap = oldCap > SIZE_MAX / 2 ? SIZE_MAX : 2 * oldCap;
+    if (newCap < len + src.len) { newCap = len + src.len; }
+    if (!dynarr_resize_byte(mem, &gb->text, newCap)) { return false; }
+    // the text after the gap stays at the end of the (now larger) storage
+    size_t tailLen = len - gb->cursor;
+    memmove(&gb->text.buf[newCap - tailLen], &gb->text.buf[oldCap - tailLen], tailLen);
+  }
+  memcpy(&gb->text.buf[gb->cursor], src.arr, src.len);
+  gb->cursor += src.len;
+  gb->text.len += src.len;
+  return true;
+}
+
+void gapbuf_deleteBefore(gapbuf* gb, size_t n) {
+  if (n > gb->cursor) { n = gb->cursor; }
+  gb->cursor -= n;
+  gb->text.len -= n;
+}
+
+void gapbuf_deleteAfter(gapbuf* gb, size_t n) {
+  size_t available = gb->text.len - gb->cursor;
+  if (n > available) { n = available; }
+  gb->text.len -= n;
+}
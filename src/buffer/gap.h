@@ -0,0 +1,103 @@
+/// @file
+/// @brief Gap buffer: a byte buffer with cheap insertion and deletion at a movable cursor.
+///
+/// The storage is a {@link dynarr_byte}, of which the unused capacity (the "gap") sits at the cursor rather than at the end.
+/// Inserting or deleting at the cursor only moves the edges of the gap.
+/// Moving the cursor moves just the bytes between its old and new positions across the gap,
+///   so a cluster of edits near each other costs time proportional to the size of the edits, not of the text.
+///
+/// The text is the bytes before the gap followed by the bytes after it; both halves can be viewed without copying (see {@link gapbuf_views}).
+
+#ifndef CHIM_BUFFER_GAP
+#define CHIM_BUFFER_GAP
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief Byte buffer with a gap at the cursor.
+typedef struct gapbuf {
+  /// @brief storage; its length is the length of the text, and the gap fills the rest of its capacity
+  dynarr_byte text;
+  /// @brief offset of the cursor (and so the start of the gap) in the text
+  size_t cursor;
+} gapbuf;
+
+/// @brief Initialize an empty buffer.
+///
+/// @param mem: allocator
+/// @param gb: the buffer
+/// @param cap0: initial capacity, in bytes (must not be zero)
+/// @return false if allocation fails
+bool gapbuf_init(alloc_t mem, gapbuf* gb, size_t cap0);
+
+/// @brief Initialize a buffer with a copy of some text, with the cursor at its end.
+///
+/// @param mem: allocator
+/// @param gb: the buffer
+/// @param src: the initial text
+/// @param gap0: initial size of the gap, in bytes (must not be zero)
+/// @return false if allocation fails
+bool gapbuf_fromSlice(alloc_t mem, gapbuf* gb, larr_byte src, size_t gap0);
+
+/// @brief Free the storage of a buffer.
+///
+/// @param mem: allocator
+/// @param gb: the buffer
+void gapbuf_deinit(alloc_t mem, gapbuf* gb);
+
+/// @brief View the text without copying.
+///
+/// The views are invalidated by any edit or cursor movement.
+///
+/// @param gb: the buffer
+/// @param before: the text before the cursor
+/// @param after: the text after the cursor
+void gapbuf_views(const gapbuf* gb, larr_byte* before, larr_byte* after);
+
+/// @brief get the address corresponding to an index of the text
+///
+/// As with {@link _larr_addrof}, this performs bounds-checking.
+///
+/// @param gb: the buffer
+/// @param index: offset into the text
+/// @return the address of the byte at `index`, or `NULL` if `index` is not in-bounds
+byte* gapbuf_addrof(const gapbuf* gb, size_t index);
+
+/// @brief Move the cursor.
+///
+/// This takes time proportional to the distance moved.
+///
+/// @param gb: the buffer
+/// @param pos: new offset of the cursor (clamped to the length of the text)
+void gapbuf_moveTo(gapbuf* gb, size_t pos);
+
+/// @brief Insert text at the cursor, leaving the cursor after it.
+///
+/// The gap doubles in size (at least) whenever it is too small.
+///
+/// @param mem: allocator
+/// @param gb: the buffer
+/// @param src: the text to insert (which may not lie within this buffer)
+/// @return false if allocation fails (the buffer is unchanged)
+bool gapbuf_insert(alloc_t mem, gapbuf* gb, larr_byte src);
+
+/// @brief Delete text before the cursor (as backspace).
+///
+/// @param gb: the buffer
+/// @param n: number of bytes to delete (clamped to the number available)
+void gapbuf_deleteBefore(gapbuf* gb, size_t n);
+
+/// @brief Delete text after the cursor (as the delete key).
+///
+/// @param gb: the buffer
+/// @param n: number of bytes to delete (clamped to the number available)
+void gapbuf_deleteAfter(gapbuf* gb, size_t n);
+
+
+#endif
@@ -0,0 +1,166 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+#undef INLINE
+#define INLINE
+#include "sstr.h"
+
+
+// The heap flag is bit 7 of the last byte of the object, which is the last byte of `heap.cap`.
+// That is the top byte of the capacity on little-endian targets, and the bottom byte on big-endian ones.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  #define FLAG ((size_t)0x80 << (8 * (sizeof(size_t) - 1)))
+  #define CAPMAX (FLAG - 1)
+  #define ENCODE(cap) ((cap) | FLAG)
+  #define DECODE(tagged) ((tagged) & ~FLAG)
+#else
+  #define CAPMAX (SIZE_MAX >> 8)
+  #define ENCODE(cap) (((cap) << 8) | 0x80)
+  #define DECODE(tagged) ((tagged) >> 8)
+#endif
+
+static inline
+void setInline(sstr* str, size_t len) {
+  str->small.left = (uint8_t)(CHIM_SSTR_INLINE - len);
+}
+
+static inline
+void setHeap(sstr* str, byte* buf, size_t len, size_t cap) {
+  str->heap.buf = buf;
+  str->heap.len = len;
+  str->heap.cap = ENCODE(cap);
+}
+
+static inline
+void setLen(sstr* str, size_t len) {
+  if (sstr_isInline(str)) { setInline(str, len); }
+  else { str->heap.len = len; }
+}
+
+// Make room for `extra` more bytes, doubling the capacity as needed.
+static
+bool grow(alloc_t mem, sstr* str, size_t extra) {
+  size_t len = sstr_len(str);
+  size_t cap = sstr_cap(str);
+  if (extra <= cap - len) { return true; }
+  if (extra > CAPMAX - len) { return false; }
+  size_t need = len + extra;
+  cap = cap > CAPMAX / 2 ? CAPMAX : 2 * cap;
+  if (cap < need) { cap = need; }
+  return sstr_reserve(mem, str, cap);
+}
+
+
+bool sstr_fromSlice(alloc_t mem, sstr* str, larr_byte src) {
+  sstr_init(str);
+  return sstr_append(mem, str, src);
+}
+
+void sstr_fromDynarr(alloc_t mem, sstr* str, dynarr_byte* src) {
+  assert(src->cap <= CAPMAX);
+  if (src->len <= CHIM_SSTR_INLINE) {
+    if (src->len != 0) { memcpy(str->small.data, src->buf, src->len); }
+    setInline(str, src->len);
+    dynarr_deinit_byte(mem, src);
+    return;
+  }
+  setHeap(str, src->buf, src->len, src->cap);
+  src->buf = NULL;
+  src->len = 0;
+  src->cap = 0;
+}
+
+bool sstr_intoDynarr(alloc_t mem, sstr* str, dynarr_byte* dst) {
+  if (sstr_isInline(str)) {
+    size_t len = sstr_len(str);
+    if (!dynarr_init_byte(mem, dst, len == 0 ? 1 : len)) { return false; }
+    memcpy(dst->buf, str->small.data, len);
+    dst->len = len;
+  }
+  else {
+    dst->buf = str->heap.buf;
+    dst->len = str->heap.len;
+    dst->cap = DECODE(str->heap.cap);
+  }
+  sstr_init(str);
+  return true;
+}
+
+void sstr_deinit(alloc_t mem, sstr* str) {
+  if (!sstr_isInline(str)) { freeIn(mem, str->heap.buf); }
+  sstr_init(str);
+}
+
+size_t sstr_cap(const sstr* str) {
+  return sstr_isInline(str) ? CHIM_SSTR_INLINE : DECODE(str->heap.cap);
+}
+
+byte* sstr_mut(sstr* str) {
+  return sstr_isInline(str) ? str->small.data : str->heap.buf;
+}
+
+bool sstr_reserve(alloc_t mem, sstr* str, size_t cap) {
+  if (cap <= sstr_cap(str)) { return true; }
+  if (cap > CAPMAX) { return false; }
+  if (sstr_isInline(str)) {
+    byte* buf = allocIn(mem, cap);
+    if (buf == NULL) { return false; }
+    size_t len = sstr_len(str);
+    memcpy(buf, str->small.data, len);
+    setHeap(str, buf, len, cap);
+  }
+  else {
+    byte* buf = reallocIn(mem, str->heap.buf, cap);
+    if (buf == NULL) { return false; }
+    setHeap(str, buf, str->heap.len, cap);
+  }
+  return true;
+}
+
+bool sstr_push(alloc_t mem, sstr* str, byte elem) {
+  if (!grow(mem, str, 1)) { return false; }
+  size_t len = sstr_len(str);
+  sstr_mut(str)[len] = elem;
+  setLen(str, len + 1);
+  return true;
+}
+
+bool sstr_append(alloc_t mem, sstr* str, larr_byte src) {
+  if (!grow(mem, str, src.len)) { return false; }
+  size_t len = sstr_len(str);
+  if (src.len != 0) { memcpy(sstr_mut(str) + len, src.arr, src.len); }
+  setLen(str, len + src.len);
+  return true;
+}
+
+void sstr_truncate(sstr* str, size_t len) {
+  assert(len <= sstr_len(str));
+  setLen(str, len);
+}
+
+bool sstr_shrink(alloc_t mem, sstr* str) {
+  if (sstr_isInline(str)) { return true; }
+  size_t len = str->heap.len;
+  byte* buf = str->heap.buf;
+  if (len <= CHIM_SSTR_INLINE) {
+    // the inline bytes overlap the heap fields, so read those first
+    memcpy(str->small.data, buf, len);
+    setInline(str, len);
+    freeIn(mem, buf);
+    return true;
+  }
+  if (len == DECODE(str->heap.cap)) { return true; }
+  buf = reallocIn(mem, buf, len);
+  if (buf == NULL) { return false; }
+  setHeap(str, buf, len, len);
+  return true;
+}
@@ -0,0 +1,191 @@
+/// @file
+/// @brief Owned byte strings which store short contents inline.
+///
+/// An {@link sstr} takes the same 24 bytes (on 64-bit targets) as a {@link dynarr_byte},
+///   but up to {@link CHIM_SSTR_INLINE} bytes of contents are kept in those bytes themselves, rather than on the heap.
+/// So short strings cost no allocation, and live in the same cache line as whatever owns them.
+/// Longer strings switch to a heap buffer transparently, which grows by doubling, as a `dynarr` does.
+///
+/// The last byte of the object tells the two apart.
+/// Inline, it holds how much inline space is left, so a string of exactly {@link CHIM_SSTR_INLINE} bytes is followed by a zero byte.
+/// On the heap, it is the byte of the capacity field which carries a flag bit that no real capacity reaches.
+///
+/// Viewing the contents as a {@link larr_byte} is a branch and two loads, with no copying.
+/// The view is invalidated by any mutation of the string, and by moving the string itself (when it is inline).
+///
+/// As with {@link buffer.h}, the allocator is passed to each operation that may need it.
+
+#ifndef CHIM_BUFFER_SSTR
+#define CHIM_BUFFER_SSTR
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+/// @brief Maximum number of bytes stored inline.
+#define CHIM_SSTR_INLINE (3 * sizeof(size_t) - 1)
+
+/// @brief Owned byte string.
+///
+/// Treat the fields as private: use the functions below.
+typedef union sstr {
+  /// @brief representation of a string on the heap
+  struct {
+    /// @brief the contents
+    byte* buf;
+    /// @brief length of the contents
+    size_t len;
+    /// @brief capacity of `buf`, with the heap flag set (see sstr.c)
+    size_t cap;
+  } heap;
+  /// @brief representation of a short string
+  struct {
+    /// @brief the contents
+    byte data[CHIM_SSTR_INLINE];
+    /// @brief inline space left over (`CHIM_SSTR_INLINE` less the length)
+    uint8_t left;
+  } small;
+} sstr;
+
+static_assert(sizeof(sstr) == 3 * sizeof(size_t), "sstr must be as small as a dynarr");
+static_assert(CHIM_SSTR_INLINE < 0x80, "inline length must leave the heap flag clear");
+
+/// @brief Initialize an empty string, without allocating.
+///
+/// @param str: the string
+INLINE
+void sstr_init(sstr* str) {
+  str->small.left = CHIM_SSTR_INLINE;
+}
+
+/// @brief Whether the contents are stored inline.
+///
+/// @param str: the string
+/// @return false if the string owns a heap buffer
+INLINE
+bool sstr_isInline(const sstr* str) {
+  return (str->small.left & 0x80) == 0;
+}
+
+/// @brief Length of the contents.
+///
+/// @param str: the string
+/// @return number of bytes in the string
+INLINE
+size_t sstr_len(const sstr* str) {
+  return sstr_isInline(str) ? CHIM_SSTR_INLINE - str->small.left : str->heap.len;
+}
+
+/// @brief View the contents of a string.
+///
+/// @param str: the string
+/// @return the bytes of the string
+INLINE
+larr_byte sstr_view(const sstr* str) {
+  larr_byte out;
+  if (sstr_isInline(str)) {
+    out.len = CHIM_SSTR_INLINE - str->small.left;
+    out.arr = (byte*)str->small.data;
+  }
+  else {
+    out.len = str->heap.len;
+    out.arr = str->heap.buf;
+  }
+  return out;
+}
+
+/// @brief Initialize a string with a copy of some bytes.
+///
+/// @param mem: allocator
+/// @param str: the string
+/// @param src: the bytes to copy
+/// @return false if allocation fails
+bool sstr_fromSlice(alloc_t mem, sstr* str, larr_byte src);
+
+/// @brief Initialize a string by taking over the buffer of a dynamic array, without copying.
+///
+/// If the contents fit inline, they are copied there instead, and the buffer freed.
+///
+/// @param mem: allocator (the one the array was allocated with)
+/// @param str: the string
+/// @param src: the array, which is left empty (and must be initialized again before reuse)
+void sstr_fromDynarr(alloc_t mem, sstr* str, dynarr_byte* src);
+
+/// @brief Move the contents of a string into a dynamic array, without copying if they are on the heap.
+///
+/// @param mem: allocator
+/// @param str: the string, which is left empty
+/// @param dst: the array, which must not be initialized (any buffer it has is overwritten)
+/// @return false if allocation fails (in which case the string is unchanged)
+bool sstr_intoDynarr(alloc_t mem, sstr* str, dynarr_byte* dst);
+
+/// @brief Free the heap buffer, if any.
+///
+/// The string is left empty, and may be reused without initializing it again.
+///
+/// @param mem: allocator
+/// @param str: the string
+void sstr_deinit(alloc_t mem, sstr* str);
+
+/// @brief Number of bytes the string can hold without allocating.
+///
+/// @param str: the string
+/// @return the capacity, in bytes
+size_t sstr_cap(const sstr* str);
+
+/// @brief Obtain write access to the contents of a string.
+///
+/// @param str: the string
+/// @return the first byte of the contents (followed by the rest of the capacity)
+byte* sstr_mut(sstr* str);
+
+/// @brief Ensure capacity for at least some number of bytes.
+///
+/// @param mem: allocator
+/// @param str: the string
+/// @param cap: the required capacity, in bytes
+/// @return false if allocation fails
+bool sstr_reserve(alloc_t mem, sstr* str, size_t cap);
+
+/// @brief Copy a byte to the end of the string.
+///
+/// @param mem: allocator
+/// @param str: the string
+/// @param elem: the byte
+/// @return false if allocation fails
+bool sstr_push(alloc_t mem, sstr* str, byte elem);
+
+/// @brief Copy bytes to the end of the string.
+///
+/// @param mem: allocator
+/// @param str: the string
+/// @param src: the bytes to copy (which may not lie within this string)
+/// @return false if allocation fails
+bool sstr_append(alloc_t mem, sstr* str, larr_byte src);
+
+/// @brief Shorten the string, keeping its capacity.
+///
+/// @param str: the string
+/// @param len: the new length, no greater than the current length
+void sstr_truncate(sstr* str, size_t len);
+
+/// @brief Release unused capacity, moving the contents back inline if they fit.
+///
+/// @param mem: allocator
+/// @param str: the string
+/// @return false if allocation fails (in which case the string is unchanged)
+bool sstr_shrink(alloc_t mem, sstr* str);
+
+
+#endif
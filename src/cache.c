@@ -0,0 +1,319 @@
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "cache.h"
+
+
+// Free-list terminator is `c->cap`; table slots hold entry index plus one, so zero is empty.
+
+static
+uint64_t hashBytes(uint64_t seed, larr_byte key) {
+  const uint64_t m = UINT64_C(0x9e3779b97f4a7c15);
+  uint64_t h = seed ^ (key.len * m);
+  size_t i = 0;
+  for (; i + 8 <= key.len; i += 8) {
+    uint64_t w;
+    memcpy(&w, key.arr + i, 8);
+    h = (h ^ w) * m;
+    h ^= h >> 32;
+  }
+  if (i < key.len) {
+    uint64_t w = 0;
+    memcpy(&w, key.arr + i, key.len - i);
+    h = (h ^ w) * m;
+  }
+  // final avalanche, so that both halves depend on every input bit
+  h ^= h >> 31;
+  h *= UINT64_C(0xbf58476d1ce4e5b9);
+  h ^= h >> 29;
+  return h;
+}
+
+static inline
+bool keyEq(const cache_entry* e, uint32_t hash, larr_byte key) {
+  if (e->hash != hash) { return false; }
+  larr_byte have = sstr_view(&e->key);
+  return have.len == key.len && (key.len == 0 || memcmp(have.arr, key.arr, key.len) == 0);
+}
+
+// What an entry is charged beyond the caller's cost: its key's heap buffer, if any.
+static inline
+size_t keyCost(const sstr* key) {
+  return sstr_isInline(key) ? 0 : sstr_cap(key);
+}
+
+// Slot holding `key`, or the empty slot where it would go.
+static
+uint32_t probe(const cache* c, uint32_t hash, larr_byte key) {
+  uint32_t pos = hash & c->mask;
+  for (;;) {
+    uint32_t slot = c->table[pos];
+    if (slot == 0 || keyEq(&c->entries[slot - 1], hash, key)) { return pos; }
+    pos = (pos + 1) & c->mask;
+  }
+}
+
+// Empty a table slot, shifting later members of its cluster back so that probing needs no tombstones.
+static
+void unslot(cache* c, uint32_t pos) {
+  uint32_t hole = pos;
+  for (uint32_t at = (pos + 1) & c->mask; c->table[at] != 0; at = (at + 1) & c->mask) {
+    uint32_t home = c->entries[c->table[at] - 1].hash & c->mask;
+    // move the slot into the hole, unless its home lies cyclically in (hole, at]
+    bool stays = hole <= at ? (hole < home && home <= at) : (hole < home || home <= at);
+    if (!stays) {
+      c->table[hole] = c->table[at];
+      hole = at;
+    }
+  }
+  c->table[hole] = 0;
+}
+
+// Remove entry `i` (whose slot is at `pos`), returning it to the free list.
+static
+void drop(alloc_t mem, cache* c, uint32_t i, uint32_t pos) {
+  cache_entry* e = &c->entries[i];
+  unslot(c, pos);
+  c->used -= e->cost + keyCost(&e->key);
+  sstr_deinit(mem, &e->key);
+  e->live = false;
+  e->link = c->free;
+  c->free = i;
+  c->len -= 1;
+}
+
+// Advance the clock hand to an entry not used since the last sweep, other than entry `keep`, and evict it.
+static
+void evictOne(alloc_t mem, cache* c, uint32_t keep) {
+  for (;;) {
+    cache_entry* e = &c->entries[c->hand];
+    uint32_t i = c->hand;
+    c->hand = c->hand + 1 == c->cap ? 0 : c->hand + 1;
+    if (!e->live || i == keep) { continue; }
+    if (e->ref) {
+      e->ref = false;
+      continue;
+    }
+    if (c->evict != NULL) { c->evict(c->ctx, sstr_view(&e->key), e->val); }
+    drop(mem, c, i, probe(c, e->hash, sstr_view(&e->key)));
+    return;
+  }
+}
+
+
+bool cache_init(alloc_t mem, cache* c, uint32_t maxEntries, size_t budget, cache_evict_fn evict, void* ctx) {
+  if (maxEntries == 0 || maxEntries > CHIM_CACHE_MAXENTRIES) { return false; }
+  // at most half full, which keeps probe sequences short
+  uint32_t slots = 2;
+  while (slots < 2 * (uint64_t)maxEntries) { slots *= 2; }
+  c->entries = allocIn(mem, (size_t)maxEntries * sizeof(cache_entry));
+  if (c->entries == NULL) { return false; }
+  c->table = allocIn(mem, (size_t)slots * sizeof(uint32_t));
+  if (c->table == NULL) {
+    freeIn(mem, c->entries);
+    return false;
+  }
+  memset(c->table, 0, (size_t)slots * sizeof(uint32_t));
+  for (uint32_t i = 0; i < maxEntries; ++i) {
+    c->entries[i].live = false;
+    c->entries[i].link = i + 1;
+  }
+  c->mask = slots - 1;
+  c->cap = maxEntries;
+  c->len = 0;
+  c->free = 0;
+  c->hand = 0;
+  c->budget = budget;
+  c->used = 0;
+  // distinct per cache, so that keys colliding in one cache need not collide in another
+  c->seed = (uint64_t)(uintptr_t)c * UINT64_C(0x9e3779b97f4a7c15);
+  c->evict = evict;
+  c->ctx = ctx;
+  return true;
+}
+
+void cache_deinit(alloc_t mem, cache* c) {
+  for (uint32_t i = 0; i < c->cap; ++i) {
+    cache_entry* e = &c->entries[i];
+    if (!e->live) { continue; }
+    if (c->evict != NULL) { c->evict(c->ctx, sstr_view(&e->key), e->val); }
+    sstr_deinit(mem, &e->key);
+  }
+  freeIn(mem, c->table);
+  freeIn(mem, c->entries);
+  c->entries = NULL;
+  c->table = NULL;
+  c->len = 0;
+  c->used = 0;
+}
+
+static
+bool getHashed(cache* c, uint32_t hash, larr_byte key, any* val) {
+  uint32_t slot = c->table[probe(c, hash, key)];
+  if (slot == 0) { return false; }
+  cache_entry* e = &c->entries[slot - 1];
+  e->ref = true;
+  if (val != NULL) { *val = e->val; }
+  return true;
+}
+
+static
+bool putHashed(alloc_t mem, cache* c, uint32_t hash, larr_byte key, any val, size_t cost) {
+  uint32_t pos = probe(c, hash, key);
+  uint32_t slot = c->table[pos];
+  if (slot != 0) {
+    cache_entry* e = &c->entries[slot - 1];
+    if (c->evict != NULL) { c->evict(c->ctx, sstr_view(&e->key), e->val); }
+    size_t charge = cost + keyCost(&e->key);
+    if (charge < cost || charge > c->budget) {
+      // the old value is gone either way: keeping it would serve what the caller meant to replace
+      drop(mem, c, slot - 1, pos);
+      return false;
+    }
+    c->used -= e->cost;
+    e->val = val;
+    e->cost = cost;
+    e->ref = true;
+    c->used += cost;
+    // the entry fits the budget alone, so this stops before the cache is empty
+    while (c->used > c->budget && c->len > 1) { evictOne(mem, c, slot - 1); }
+    return true;
+  }
+  // checked after the replace path, which must evict the old value even when the new one does not fit
+  if (cost > c->budget) { return false; }
+  sstr k;
+  if (!sstr_fromSlice(mem, &k, key)) { return false; }
+  size_t charge = cost + keyCost(&k);
+  if (charge < cost || charge > c->budget) {
+    sstr_deinit(mem, &k);
+    return false;
+  }
+  while (c->free == c->cap || c->used > c->budget - charge) { evictOne(mem, c, UINT32_MAX); }
+  uint32_t i = c->free;
+  cache_entry* e = &c->entries[i];
+  c->free = e->link;
+  e->key = k;
+  e->val = val;
+  e->cost = cost;
+  e->hash = hash;
+  e->live = true;
+  // a new entry must be hit once before it survives a sweep, so one-off keys are the first to go
+  e->ref = false;
+  c->used += charge;
+  c->len += 1;
+  // eviction may have shifted slots, so find the place again
+  c->table[probe(c, hash, key)] = i + 1;
+  return true;
+}
+
+static
+bool delHashed(alloc_t mem, cache* c, uint32_t hash, larr_byte key, any* val) {
+  uint32_t pos = probe(c, hash, key);
+  uint32_t slot = c->table[pos];
+  if (slot == 0) { return false; }
+  if (val != NULL) { *val = c->entries[slot - 1].val; }
+  drop(mem, c, slot - 1, pos);
+  return true;
+}
+
+bool cache_get(cache* c, larr_byte key, any* val) {
+  return getHashed(c, (uint32_t)hashBytes(c->seed, key), key, val);
+}
+
+bool cache_put(alloc_t mem, cache* c, larr_byte key, any val, size_t cost) {
+  return putHashed(mem, c, (uint32_t)hashBytes(c->seed, key), key, val, cost);
+}
+
+bool cache_del(alloc_t mem, cache* c, larr_byte key, any* val) {
+  return delHashed(mem, c, (uint32_t)hashBytes(c->seed, key), key, val);
+}
+
+
+// Critical sections are a probe and perhaps a few evictions, so spin briefly before giving up the processor.
+static
+void lock(cache_shard* s) {
+  for (;;) {
+    for (int i = 0; i < 64; ++i) {
+      if (!atomic_load_explicit(&s->lock, memory_order_relaxed)
+          && !atomic_exchange_explicit(&s->lock, true, memory_order_acquire)) {
+        return;
+      }
+    }
+    sched_yield();
+  }
+}
+
+static inline
+void unlock(cache_shard* s) {
+  atomic_store_explicit(&s->lock, false, memory_order_release);
+}
+
+// The high half of the hash picks the shard, and the low half the slot within it.
+static inline
+cache_shard* shardOf(const cache_shards* cs, uint64_t hash) {
+  return &cs->shards[(hash >> 32) & cs->mask];
+}
+
+bool cache_shards_init(aligned_alloc_t shardMem, alloc_t mem, cache_shards* cs, uint32_t nShards, uint32_t maxEntries,
+                       size_t budget, cache_evict_fn evict, cache_retain_fn retain, void* ctx) {
+  if (nShards == 0 || (nShards & (nShards - 1)) != 0 || nShards > maxEntries) { return false; }
+  cs->shards = aallocIn(shardMem, CHIM_CACHELINE, (size_t)nShards * sizeof(cache_shard));
+  if (cs->shards == NULL) { return false; }
+  cs->mask = nShards - 1;
+  cs->seed = (uint64_t)(uintptr_t)cs * UINT64_C(0x9e3779b97f4a7c15);
+  cs->retain = retain;
+  for (uint32_t i = 0; i < nShards; ++i) {
+    cache_shard* s = &cs->shards[i];
+    // spread the remainders, so the totals are exactly as asked
+    uint32_t entries = maxEntries / nShards + (i < maxEntries % nShards);
+    size_t share = budget / nShards + (i < budget % nShards);
+    if (!cache_init(mem, &s->c, entries, share, evict, ctx)) {
+      for (uint32_t j = 0; j < i; ++j) { cache_deinit(mem, &cs->shards[j].c); }
+      afreeIn(shardMem, cs->shards);
+      return false;
+    }
+    atomic_init(&s->lock, false);
+  }
+  return true;
+}
+
+void cache_shards_deinit(aligned_alloc_t shardMem, alloc_t mem, cache_shards* cs) {
+  for (uint32_t i = 0; i <= cs->mask; ++i) { cache_deinit(mem, &cs->shards[i].c); }
+  afreeIn(shardMem, cs->shards);
+  cs->shards = NULL;
+}
+
+bool cache_shards_get(cache_shards* cs, larr_byte key, any* val) {
+  uint64_t hash = hashBytes(cs->seed, key);
+  cache_shard* s = shardOf(cs, hash);
+  any found;
+  lock(s);
+  bool hit = getHashed(&s->c, (uint32_t)hash, key, &found);
+  if (hit && cs->retain != NULL) { cs->retain(s->c.ctx, found); }
+  unlock(s);
+  if (hit && val != NULL) { *val = found; }
+  return hit;
+}
+
+bool cache_shards_put(alloc_t mem, cache_shards* cs, larr_byte key, any val, size_t cost) {
+  uint64_t hash = hashBytes(cs->seed, key);
+  cache_shard* s = shardOf(cs, hash);
+  lock(s);
+  bool ok = putHashed(mem, &s->c, (uint32_t)hash, key, val, cost);
+  unlock(s);
+  return ok;
+}
+
+bool cache_shards_del(alloc_t mem, cache_shards* cs, larr_byte key, any* val) {
+  uint64_t hash = hashBytes(cs->seed, key);
+  cache_shard* s = shardOf(cs, hash);
+  lock(s);
+  bool ok = delHashed(mem, &s->c, (uint32_t)hash, key, val);
+  unlock(s);
+  return ok;
+}
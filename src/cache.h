@@ -0,0 +1,227 @@
+/// @file
+/// @brief Bounded caches keyed by byte slices, with CLOCK eviction.
+///
+/// Entries live in one flat array, allocated when the cache is initialized, and refer to one another by index:
+///   a free list threads through unused entries, and an open-addressed table of entry indices finds keys.
+/// Keys are kept as {@link sstr}s, so short keys (the common case) are stored in the entry itself;
+///   there is no allocation per entry beyond keys too long for that.
+///
+/// Eviction is by CLOCK, which approximates least-recently-used:
+///   a hit only sets the entry's reference bit, and the clock hand sweeps the array,
+///   clearing reference bits, until it finds an entry that has not been used since the hand last passed it.
+/// So every operation takes (amortized) constant time, and lookups write nothing but one byte.
+///
+/// The cache is bounded both by the number of entries and by a byte budget:
+///   each entry is charged the cost given when it was inserted (e.g. the size of the decoded object),
+///   plus the heap bytes of its key, if the key is too long to store inline.
+/// Evicted values are handed to a callback, which may release them.
+///
+/// A {@link cache} is not synchronized. For concurrent use, {@link cache_shards} splits the entries and budget
+///   over independently locked caches, chosen by the hash of the key.
+
+#ifndef CHIM_CACHE
+#define CHIM_CACHE
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alignment.h"
+#include "alloc/aligned.h"
+#include "alloc/unaligned.h"
+#include "buffer/sstr.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+/// @brief Most entries a cache (or a shard) may hold.
+#define CHIM_CACHE_MAXENTRIES ((uint32_t)1 << 30)
+
+
+/// @brief Called with each entry that leaves the cache, other than by {@link cache_del}.
+///
+/// @param ctx: the context given to the cache
+/// @param key: the entry's key (valid only during the call)
+/// @param val: the entry's value
+typedef void (*cache_evict_fn)(void* ctx, larr_byte key, any val);
+
+/// @brief An entry of a cache.
+typedef struct cache_entry {
+  /// @brief the key
+  sstr key;
+  /// @brief the value
+  any val;
+  /// @brief what the entry is charged against the budget
+  size_t cost;
+  /// @brief hash of the key
+  uint32_t hash;
+  /// @brief next entry in the free list, while the entry is unused
+  uint32_t link;
+  /// @brief whether the entry holds a key
+  bool live;
+  /// @brief whether the entry has been used since the clock hand last passed it
+  bool ref;
+} cache_entry;
+
+/// @brief Cache keyed by byte slices.
+typedef struct cache {
+  /// @brief all the entries
+  cache_entry* entries;
+  /// @brief open-addressed table of entry indices plus one (zero where empty)
+  uint32_t* table;
+  /// @brief number of slots in the table, less one (the table size is a power of two)
+  uint32_t mask;
+  /// @brief number of entries
+  uint32_t cap;
+  /// @brief number of entries in use
+  uint32_t len;
+  /// @brief first unused entry, or `cap` if every entry is in use
+  uint32_t free;
+  /// @brief position of the clock hand
+  uint32_t hand;
+  /// @brief most the entries may be charged in total
+  size_t budget;
+  /// @brief what the entries are charged in total
+  size_t used;
+  /// @brief seed of the key hash
+  uint64_t seed;
+  /// @brief called with evicted entries (may be `NULL`)
+  cache_evict_fn evict;
+  /// @brief passed to `evict`
+  void* ctx;
+} cache;
+
+/// @brief Allocate an empty cache.
+///
+/// @param mem: allocator
+/// @param c: the cache
+/// @param maxEntries: most entries to hold at once (between one and {@link CHIM_CACHE_MAXENTRIES})
+/// @param budget: most the entries may be charged in total
+/// @param evict: called with each evicted entry (may be `NULL`)
+/// @param ctx: passed to `evict`
+/// @return false if allocation fails, or `maxEntries` is out of range
+bool cache_init(alloc_t mem, cache* c, uint32_t maxEntries, size_t budget, cache_evict_fn evict, void* ctx);
+
+/// @brief Evict every entry, and free the cache.
+///
+/// @param mem: allocator
+/// @param c: the cache
+void cache_deinit(alloc_t mem, cache* c);
+
+/// @brief Look up a key, marking its entry as recently used.
+///
+/// @param c: the cache
+/// @param key: the key
+/// @param val: where to store the value, if found (may be `NULL`)
+/// @return whether the key is cached
+bool cache_get(cache* c, larr_byte key, any* val);
+
+/// @brief Insert or replace an entry, evicting others as needed to stay within bounds.
+///
+/// A replaced value is passed to the eviction callback.
+///
+/// @param mem: allocator
+/// @param c: the cache
+/// @param key: the key (copied)
+/// @param val: the value
+/// @param cost: what to charge the entry against the budget
+/// @return false if the entry could not fit in the budget even alone, or allocation fails
+///   (the value is not cached in either case, and an entry it would have replaced is evicted)
+bool cache_put(alloc_t mem, cache* c, larr_byte key, any val, size_t cost);
+
+/// @brief Remove an entry, handing back its value rather than evicting it.
+///
+/// @param mem: allocator
+/// @param c: the cache
+/// @param key: the key
+/// @param val: where to store the value, if found (may be `NULL`)
+/// @return whether the key was cached
+bool cache_del(alloc_t mem, cache* c, larr_byte key, any* val);
+
+
+/// @brief Called with a value found by {@link cache_shards_get}, while its shard is still locked.
+///
+/// This is the chance to take a reference to the value, before another thread can evict it.
+///
+/// @param ctx: the context given to the cache
+/// @param val: the value
+typedef void (*cache_retain_fn)(void* ctx, any val);
+
+/// @brief One shard of a {@link cache_shards}.
+typedef struct cache_shard {
+  /// @brief held while the cache is in use
+  atomic_bool lock;
+  /// @brief the shard's entries
+  cache c;
+  // each shard in its own cache lines, so that threads working in different shards do not contend
+  char _pad[CHIM_CACHELINE - (sizeof(atomic_bool) + sizeof(cache)) % CHIM_CACHELINE];
+} cache_shard;
+
+/// @brief Cache safe for concurrent use, made of independently locked shards.
+typedef struct cache_shards {
+  /// @brief the shards
+  cache_shard* shards;
+  /// @brief number of shards, less one (the number of shards is a power of two)
+  uint32_t mask;
+  /// @brief seed of the hash choosing the shard
+  uint64_t seed;
+  /// @brief called with each value found, under its shard's lock (may be `NULL`)
+  cache_retain_fn retain;
+} cache_shards;
+
+/// @brief Allocate an empty sharded cache.
+///
+/// Entries and budget are split evenly between the shards, so a shard may evict while others have room.
+/// The shards are allocated at cache-line alignment, so that no two of them share a line.
+///
+/// @param shardMem: allocator for the array of shards
+/// @param mem: allocator (which must be safe to call from any thread)
+/// @param cs: the cache
+/// @param nShards: number of shards (a power of two, no more than `maxEntries`)
+/// @param maxEntries: most entries to hold at once, across all shards
+/// @param budget: most the entries may be charged in total, across all shards
+/// @param evict: called with each evicted entry, under its shard's lock (may be `NULL`)
+/// @param retain: called with each value found by {@link cache_shards_get}, under its shard's lock (may be `NULL`)
+/// @param ctx: passed to `evict` and `retain`
+/// @return false if allocation fails, or the sizes are out of range
+bool cache_shards_init(aligned_alloc_t shardMem, alloc_t mem, cache_shards* cs, uint32_t nShards, uint32_t maxEntries, size_t budget,
+                       cache_evict_fn evict, cache_retain_fn retain, void* ctx);
+
+/// @brief Evict every entry, and free the cache.
+///
+/// @warning No other thread may be using the cache when this is called.
+///
+/// @param shardMem: allocator the shards came from
+/// @param mem: allocator
+/// @param cs: the cache
+void cache_shards_deinit(aligned_alloc_t shardMem, alloc_t mem, cache_shards* cs);
+
+/// @brief Look up a key, as with {@link cache_get}.
+///
+/// @param cs: the cache
+/// @param key: the key
+/// @param val: where to store the value, if found (may be `NULL`)
+/// @return whether the key is cached
+bool cache_shards_get(cache_shards* cs, larr_byte key, any* val);
+
+/// @brief Insert or replace an entry, as with {@link cache_put}.
+///
+/// @param mem: allocator
+/// @param cs: the cache
+/// @param key: the key (copied)
+/// @param val: the value
+/// @param cost: what to charge the entry against its shard's budget
+/// @return false if the entry could not fit in a shard's budget even alone, or allocation fails
+bool cache_shards_put(alloc_t mem, cache_shards* cs, larr_byte key, any val, size_t cost);
+
+/// @brief Remove an entry, as with {@link cache_del}.
+///
+/// @param mem: allocator
+/// @param cs: the cache
+/// @param key: the key
+/// @param val: where to store the value, if found (may be `NULL`)
+/// @return whether the key was cached
+bool cache_shards_del(alloc_t mem, cache_shards* cs, larr_byte key, any* val);
+
+
+#endif
@@ -0,0 +1,92 @@
+/// @file
+/// @brief Checksums of byte slices: CRC-32C, Adler-32, and Fletcher-32.
+///
+/// All checksums are incremental: feed a message in as many pieces as is convenient,
+///   and the result is the same as checksumming it all at once.
+/// The running values of CRC-32C and Adler-32 are the checksums themselves
+///   (so the checksum of the message so far is always at hand),
+///   while Fletcher-32 needs a small state object, as it sums 16-bit words which may straddle pieces.
+///
+/// CRC-32C (the Castagnoli polynomial, as in iSCSI, ext4, and many storage formats) is the one to reach for:
+///   it detects all burst errors up to 32 bits, and it is fast.
+/// On x86-64 processors with SSE4.2 and PCLMULQDQ, it uses the `crc32` instruction on three independent streams at once,
+///   merging their results with carry-less multiplication; elsewhere, it falls back to a portable slicing-by-8 table.
+/// The choice is made at run time, so a portable build still uses the instructions where available.
+///
+/// Adler-32 (as in zlib) and Fletcher-32 are weaker, but cheap to compute anywhere, and needed by some formats.
+
+#ifndef CHIM_CODEC_CHECKSUM
+#define CHIM_CODEC_CHECKSUM
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief Extend a CRC-32C.
+///
+/// Start with `0` (the CRC of the empty message).
+///
+/// @param crc: the CRC of the message so far
+/// @param data: the next bytes of the message
+/// @return the CRC of the message extended with `data`
+uint32_t crc32c_update(uint32_t crc, larr_byte data);
+
+/// @brief Compute the CRC-32C of a concatenation from the CRCs of its parts.
+///
+/// This takes `O(log lenB)` time, so it is suited to combining CRCs of pieces checksummed in parallel.
+///
+/// @param crcA: CRC of the first part
+/// @param crcB: CRC of the second part
+/// @param lenB: length of the second part, in bytes
+/// @return the CRC of the first part followed by the second
+uint32_t crc32c_combine(uint32_t crcA, uint32_t crcB, size_t lenB);
+
+/// @brief Extend an Adler-32 checksum.
+///
+/// Start with `1` (the checksum of the empty message).
+///
+/// @param adler: the checksum of the message so far
+/// @param data: the next bytes of the message
+/// @return the checksum of the message extended with `data`
+uint32_t adler32_update(uint32_t adler, larr_byte data);
+
+
+/// @brief State of a Fletcher-32 checksum computation.
+///
+/// The message is read as little-endian 16-bit words; if its length is odd, the last word is padded with a zero byte.
+typedef struct fletcher32 {
+  /// @brief sum of the words, modulo 65535
+  uint32_t sum1;
+  /// @brief sum of the running values of `sum1`, modulo 65535
+  uint32_t sum2;
+  /// @brief the first byte of a word whose second byte has not been seen yet, if `odd`
+  byte pending;
+  /// @brief whether the message so far has an odd length
+  bool odd;
+} fletcher32;
+
+/// @brief Start a Fletcher-32 checksum.
+///
+/// @param self: the state
+void fletcher32_init(fletcher32* self);
+
+/// @brief Add bytes to a Fletcher-32 checksum.
+///
+/// @param self: the state
+/// @param data: the next bytes of the message
+void fletcher32_update(fletcher32* self, larr_byte data);
+
+/// @brief Get the Fletcher-32 checksum of the message so far.
+///
+/// The state is unchanged, so the message may be extended further.
+///
+/// @param self: the state
+/// @return the checksum (`sum2 << 16 | sum1`)
+uint32_t fletcher32_final(const fletcher32* self);
+
+
+#endif
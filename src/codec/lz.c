@@ -0,0 +1,605 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lz.h"
+
+// parameters of the LZ4 block format
+#define MINMATCH 4
+#define LASTLITERALS 5
+#define MFLIMIT 12
+#define MAXDISTANCE (CHIM_LZ_WINDOW - 1)
+#define CHAINMASK ((uint32_t)CHIM_LZ_WINDOW - 1)
+// log2 of the number of entries in the fast path's tables, for small blocks (in the otherwise unused chains) and larger ones:
+//   as in LZ4, tables that stay in the first-level cache are worth more than the matches larger ones would find
+#define SMALLHASHLOG 13
+#define FASTHASHLOG 12
+
+#define FRAME_MAGIC "CHLZ"
+#define FRAME_STORED ((uint32_t)1 << 31)
+
+
+static inline
+uint32_t read32(const byte* p) {
+  uint32_t out;
+  memcpy(&out, p, sizeof(out));
+  return out;
+}
+
+static inline
+uint64_t read64(const byte* p) {
+  uint64_t out;
+  memcpy(&out, p, sizeof(out));
+  return out;
+}
+
+static inline
+uint32_t read32le(const byte* p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static inline
+void write32le(byte* p, uint32_t x) {
+  p[0] = x;
+  p[1] = x >> 8;
+  p[2] = x >> 16;
+  p[3] = x >> 24;
+}
+
+// Copy in 16-byte chunks, possibly writing (and reading) up to 15 bytes past the end.
+static inline
+void wildCopy16(byte* dst, const byte* src, const byte* dstEnd) {
+  do {
+    memcpy(dst, src, 16);
+    dst += 16;
+    src += 16;
+  } while (dst < dstEnd);
+}
+
+// Number of equal bytes at `a` and `b`, not extending `a` past `aLimit`.
+static inline
+size_t countMatch(const byte* a, const byte* b, const byte* aLimit) {
+  const byte* start = a;
+  while (a + 8 <= aLimit) {
+    uint64_t diff = read64(a) ^ read64(b);
+    if (diff != 0) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      return (size_t)(a - start) + (__builtin_ctzll(diff) >> 3);
+#else
+      return (size_t)(a - start) + (__builtin_clzll(diff) >> 3);
+#endif
+    }
+    a += 8;
+    b += 8;
+  }
+  while (a < aLimit && *a == *b) {
+    a += 1;
+    b += 1;
+  }
+  return a - start;
+}
+
+static inline
+uint32_t hashOf(uint32_t seq) {
+  return (seq * 2654435761u) >> (32 - CHIM_LZ_HASHLOG);
+}
+
+// Hash of the five bytes at `p` (which must have eight readable bytes), as LZ4 does for its fast mode:
+//   five bytes tell more positions apart than four, for the same single load.
+static inline
+uint32_t hash5(const byte* p) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  return (uint32_t)(((read64(p) << 24) * UINT64_C(889523592379)) >> (64 - FASTHASHLOG));
+#else
+  return (uint32_t)(((read64(p) >> 24) * UINT64_C(11400714785074694791)) >> (64 - FASTHASHLOG));
+#endif
+}
+
+static inline
+byte* writeLength(byte* op, size_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (byte)len;
+  return op;
+}
+
+static inline
+bool readLength(const byte** ip, const byte* iend, size_t* len) {
+  byte s;
+  do {
+    if (*ip >= iend) { return false; }
+    s = *(*ip)++;
+    if (*len > SIZE_MAX - s) { return false; }
+    *len += s;
+  } while (s == 255);
+  return true;
+}
+
+static
+byte* emitLiterals(byte* op, byte* token, const byte* lit, size_t litLen) {
+  if (litLen >= 15) {
+    *token = 15 << 4;
+    op = writeLength(op, litLen - 15);
+  }
+  else {
+    *token = litLen << 4;
+  }
+  memcpy(op, lit, litLen);
+  return op + litLen;
+}
+
+// Append a sequence: literals followed by a back-reference.
+// The literals are copied 8 bytes at a time, which may read past them (but at most 7 bytes, not past the input,
+//   as a match is never that close to its end) and write past them (but not past the compressed block's bound,
+//   as the back-reference and the final literals follow).
+static
+byte* emitSequence(byte* op, const byte* lit, size_t litLen, size_t offset, size_t matchLen) {
+  byte* token = op++;
+  if (litLen >= 15) {
+    *token = 15 << 4;
+    op = writeLength(op, litLen - 15);
+  }
+  else {
+    *token = litLen << 4;
+  }
+  byte* litEnd = op + litLen;
+  do {
+    memcpy(op, lit, 8);
+    op += 8;
+    lit += 8;
+  } while (op < litEnd);
+  op = litEnd;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  matchLen -= MINMATCH;
+  if (matchLen >= 15) {
+    *token |= 15;
+    op = writeLength(op, matchLen - 15);
+  }
+  else {
+    *token |= matchLen;
+  }
+  return op;
+}
+
+// Record a position in the match finder's tables.
+// Return the distance back to the previous position with the same hash, or zero if there is none within reach.
+static inline
+uint32_t insert(lz_ctx* ctx, const byte* base, uint32_t blockStart, const byte* p) {
+  uint32_t off = p - base;
+  uint32_t pos = blockStart + off;
+  uint32_t h = hashOf(read32(p));
+  uint32_t dist = pos - ctx->head[h];
+  ctx->head[h] = pos;
+  // positions from earlier blocks number below `blockStart`, so they are out of reach too
+  uint32_t reach = off < MAXDISTANCE ? off : MAXDISTANCE;
+  if (dist > reach) { dist = 0; }
+  if (ctx->depth > 1) { ctx->chain[pos & CHAINMASK] = dist; }
+  return dist;
+}
+
+// Find the longest match for `ip` among the first `depth` candidates on its chain, starting `dist` bytes back.
+// Return its length (zero if there is no match of at least MINMATCH bytes), and store its start in `match`.
+static inline
+size_t longestMatch(const lz_ctx* ctx, const byte* base, uint32_t blockStart, const byte* ip, uint32_t dist
+                   , const byte* matchlimit, const byte** match) {
+  uint32_t off = ip - base;
+  uint32_t pos = blockStart + off;
+  uint32_t reach = off < MAXDISTANCE ? off : MAXDISTANCE;
+  uint32_t seq = read32(ip);
+  size_t best = 0;
+  for (unsigned depth = ctx->depth; ; ) {
+    const byte* m = ip - dist;
+    if (read32(m) == seq) {
+      size_t len = MINMATCH + countMatch(ip + MINMATCH, m + MINMATCH, matchlimit);
+      if (len > best) {
+        best = len;
+        *match = m;
+        if (ip + len == matchlimit) { break; }
+      }
+    }
+    if (--depth == 0) { break; }
+    uint32_t step = ctx->chain[(pos - dist) & CHAINMASK];
+    if (step == 0 || step > reach - dist) { break; }
+    dist += step;
+  }
+  return best;
+}
+
+// Hash of the four bytes at `p`, for the table of a small block (as LZ4 does for blocks within its 16-bit offsets).
+static inline
+uint32_t hashSmall(const byte* p) {
+  return (read32(p) * 2654435761u) >> (32 - SMALLHASHLOG);
+}
+
+// The fast path's table holds, for a small block (no larger than the window), 16-bit offsets from the start of the block:
+//   the table is then a quarter of the size, and everything in it is within reach,
+//   but it must be cleared for each block (which is as cheap as the distance checks it saves).
+// For a larger block, it holds the 32-bit position numbers of the chained path.
+static inline
+uint32_t fastHash(const byte* p, bool small) {
+  return small ? hashSmall(p) : hash5(p);
+}
+
+static inline
+void fastPut(lz_ctx* ctx, const byte* base, uint32_t blockStart, const byte* p, uint32_t h, bool small) {
+  if (small) { ctx->chain[h] = p - base; }
+  else { ctx->head[h] = blockStart + (uint32_t)(p - base); }
+}
+
+// Record `ip` under hash `h`, and return the candidate it replaces (NULL if that is out of reach).
+static inline
+const byte* fastSwap(lz_ctx* ctx, const byte* base, uint32_t blockStart, const byte* ip, uint32_t h, bool small) {
+  uint32_t off = ip - base;
+  if (small) {
+    uint32_t cand = ctx->chain[h];
+    ctx->chain[h] = off;
+    return base + cand;
+  }
+  uint32_t cand = ctx->head[h];
+  ctx->head[h] = blockStart + off;
+  // positions from earlier blocks number below `blockStart`, so they are out of reach too
+  uint32_t dist = blockStart + off - cand;
+  return dist > off || dist > MAXDISTANCE ? NULL : ip - dist;
+}
+
+// The body of a block for a depth of one, as LZ4's fast mode: one candidate per position, and no chains to maintain.
+// The hash of the next position is computed before the current one is probed, so that its load overlaps the probe.
+// Returns where the last literals start, having appended the sequences before them at `*op`.
+// Always inlined, and called with a constant `small`, so that each kind of table gets a loop of its own.
+static inline __attribute__((always_inline))
+const byte* compressFast(lz_ctx* ctx, const byte* base, uint32_t blockStart, const byte* iend, byte** op, bool small) {
+  const byte* const mflimit = iend - MFLIMIT;
+  const byte* const matchlimit = iend - LASTLITERALS;
+  const byte* ip = base;
+  const byte* anchor = base;
+  byte* out = *op;
+
+  if (small) { memset(ctx->chain, 0, sizeof(uint16_t) << SMALLHASHLOG); }
+  fastPut(ctx, base, blockStart, ip, fastHash(ip, small), small);
+  ip += 1;
+  uint32_t nextHash = fastHash(ip, small);
+  for (;;) {
+    const byte* match;
+    // the longer the search goes without a match, the faster it skips ahead
+    const byte* next = ip;
+    unsigned step = 1;
+    unsigned attempts = 1 << 6;
+    for (;;) {
+      uint32_t h = nextHash;
+      ip = next;
+      next += step;
+      step = attempts++ >> 6;
+      if (next > mflimit) { goto last; }
+      nextHash = fastHash(next, small);
+      match = fastSwap(ctx, base, blockStart, ip, h, small);
+      if (match != NULL && read32(match) == read32(ip)) { break; }
+    }
+
+    while (ip > anchor && match > base && ip[-1] == match[-1]) {
+      ip -= 1;
+      match -= 1;
+    }
+    // a match is often followed at once by another, which is then emitted without going back to the search
+    for (;;) {
+      size_t matchLen = MINMATCH + countMatch(ip + MINMATCH, match + MINMATCH, matchlimit);
+      out = emitSequence(out, anchor, ip - anchor, ip - match, matchLen);
+      ip += matchLen;
+      anchor = ip;
+      if (ip > mflimit) { goto last; }
+      fastPut(ctx, base, blockStart, ip - 2, fastHash(ip - 2, small), small);
+      match = fastSwap(ctx, base, blockStart, ip, fastHash(ip, small), small);
+      if (match == NULL || read32(match) != read32(ip)) { break; }
+    }
+    ip += 1;
+    nextHash = fastHash(ip, small);
+  }
+
+last:
+  *op = out;
+  return anchor;
+}
+
+// xxHash32
+#define P1 2654435761u
+#define P2 2246822519u
+#define P3 3266489917u
+#define P4 668265263u
+#define P5 374761393u
+
+static inline
+uint32_t rotl32(uint32_t x, int r) {
+  return (x << r) | (x >> (32 - r));
+}
+
+static inline
+uint32_t xxhRound(uint32_t acc, uint32_t input) {
+  return rotl32(acc + input * P2, 13) * P1;
+}
+
+static
+uint32_t xxh32(const byte* p, size_t len, uint32_t seed) {
+  const byte* end = p + len;
+  uint32_t h;
+  if (len >= 16) {
+    uint32_t v1 = seed + P1 + P2;
+    uint32_t v2 = seed + P2;
+    uint32_t v3 = seed;
+    uint32_t v4 = seed - P1;
+    do {
+      v1 = xxhRound(v1, read32le(p));
+      v2 = xxhRound(v2, read32le(p + 4));
+      v3 = xxhRound(v3, read32le(p + 8));
+      v4 = xxhRound(v4, read32le(p + 12));
+      p += 16;
+    } while (end - p >= 16);
+    h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+  }
+  else {
+    h = seed + P5;
+  }
+  h += (uint32_t)len;
+  for (; end - p >= 4; p += 4) {
+    h = rotl32(h + read32le(p) * P3, 17) * P4;
+  }
+  for (; p < end; p += 1) {
+    h = rotl32(h + *p * P5, 11) * P1;
+  }
+  h ^= h >> 15;
+  h *= P2;
+  h ^= h >> 13;
+  h *= P3;
+  h ^= h >> 16;
+  return h;
+}
+
+static
+bool reserve(alloc_t mem, dynarr_byte* dst, size_t extra) {
+  if (dst->cap - dst->len >= extra) { return true; }
+  if (extra > SIZE_MAX - dst->len) { return false; }
+  size_t cap = dst->cap > SIZE_MAX / 2 ? SIZE_MAX : 2 * dst->cap;
+  if (cap < dst->len + extra) { cap = dst->len + extra; }
+  return dynarr_resize_byte(mem, dst, cap);
+}
+
+
+bool lz_ctx_init(alloc_t mem, lz_ctx* ctx, unsigned depth) {
+  ctx->head = allocIn(mem, sizeof(uint32_t) << CHIM_LZ_HASHLOG);
+  if (ctx->head == NULL) { return false; }
+  ctx->chain = allocIn(mem, sizeof(uint16_t) * CHIM_LZ_WINDOW);
+  if (ctx->chain == NULL) {
+    freeIn(mem, ctx->head);
+    return false;
+  }
+  memset(ctx->head, 0, sizeof(uint32_t) << CHIM_LZ_HASHLOG);
+  ctx->next = 1;
+  ctx->depth = depth == 0 ? 1 : depth;
+  return true;
+}
+
+void lz_ctx_deinit(alloc_t mem, lz_ctx* ctx) {
+  freeIn(mem, ctx->head);
+  freeIn(mem, ctx->chain);
+  ctx->head = NULL;
+  ctx->chain = NULL;
+}
+
+size_t lz_bound(size_t srcLen) {
+  return srcLen + srcLen / 255 + 16;
+}
+
+bool lz_compressBlock(lz_ctx* ctx, larr_byte src, dynarr_byte* dst) {
+  if (src.len > CHIM_LZ_MAXBLOCK) { return false; }
+  if (dst->cap - dst->len < lz_bound(src.len)) { return false; }
+
+  // Positions are numbered continuously across calls, so that stale table entries from earlier blocks
+  // compare below the start of this block, and the tables need not be cleared for every block.
+  if (ctx->next > (uint32_t)INT32_MAX - src.len) {
+    memset(ctx->head, 0, sizeof(uint32_t) << CHIM_LZ_HASHLOG);
+    ctx->next = 1;
+  }
+  const uint32_t blockStart = ctx->next;
+  ctx->next += src.len + 1;
+
+  const byte* const base = src.arr;
+  const byte* const iend = base + src.len;
+  const byte* ip = base;
+  const byte* anchor = base;
+  byte* op = dst->buf + dst->len;
+
+  if (src.len > MFLIMIT && ctx->depth == 1) {
+    anchor = src.len <= CHIM_LZ_WINDOW ? compressFast(ctx, base, blockStart, iend, &op, true)
+                                       : compressFast(ctx, base, blockStart, iend, &op, false);
+  }
+  else if (src.len > MFLIMIT) {
+    const byte* const mflimit = iend - MFLIMIT;
+    const byte* const matchlimit = iend - LASTLITERALS;
+    for (;;) {
+      const byte* match;
+      size_t matchLen;
+      // the longer the search goes without a match, the faster it skips ahead (as in LZ4)
+      unsigned attempts = 1 << 6;
+      for (;;) {
+        if (ip > mflimit) { goto last; }
+        uint32_t dist = insert(ctx, base, blockStart, ip);
+        if (dist != 0) {
+          matchLen = longestMatch(ctx, base, blockStart, ip, dist, matchlimit, &match);
+          if (matchLen != 0) { break; }
+        }
+        ip += attempts++ >> 6;
+      }
+
+      while (ip > anchor && match > base && ip[-1] == match[-1]) {
+        ip -= 1;
+        match -= 1;
+        matchLen += 1;
+      }
+      op = emitSequence(op, anchor, ip - anchor, ip - match, matchLen);
+      ip += matchLen;
+      anchor = ip;
+      if (ip > mflimit) { break; }
+      // index a position near the end of the match, where the next repeat is likely to start
+      insert(ctx, base, blockStart, ip - 2);
+    }
+  }
+
+last:
+  {
+    byte* token = op++;
+    op = emitLiterals(op, token, anchor, iend - anchor);
+  }
+  dst->len = op - dst->buf;
+  return true;
+}
+
+bool lz_decompressBlock(larr_byte src, dynarr_byte* dst) {
+  const byte* ip = src.arr;
+  const byte* const iend = ip + src.len;
+  byte* const ostart = dst->buf + dst->len;
+  byte* const oend = dst->buf + dst->cap;
+  byte* op = ostart;
+
+  for (;;) {
+    if (ip >= iend) { return false; }
+    byte token = *ip++;
+
+    size_t litLen = token >> 4;
+    if (litLen == 15 && !readLength(&ip, iend, &litLen)) { return false; }
+    if (litLen > (size_t)(iend - ip) || litLen > (size_t)(oend - op)) { return false; }
+    if ((size_t)(iend - ip) - litLen >= 16 && (size_t)(oend - op) - litLen >= 16) {
+      wildCopy16(op, ip, op + litLen);
+    }
+    else {
+      memcpy(op, ip, litLen);
+    }
+    ip += litLen;
+    op += litLen;
+    // only the last sequence has no match
+    if (ip == iend) { break; }
+
+    if (iend - ip < 2) { return false; }
+    size_t offset = (size_t)ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > (size_t)(op - ostart)) { return false; }
+    size_t matchLen = token & 15;
+    if (matchLen == 15 && !readLength(&ip, iend, &matchLen)) { return false; }
+    if (matchLen > SIZE_MAX - MINMATCH) { return false; }
+    matchLen += MINMATCH;
+    if (matchLen > (size_t)(oend - op)) { return false; }
+
+    const byte* match = op - offset;
+    byte* mend = op + matchLen;
+    if ((size_t)(oend - op) - matchLen >= 16) {
+      if (offset >= 16) {
+        wildCopy16(op, match, mend);
+      }
+      else {
+        // The source overlaps the destination: write one repetition of the pattern byte-by-byte,
+        // then copy 8 bytes at a time from a whole number of periods (at least 8 bytes) back.
+        size_t period = offset;
+        while (period < 8) { period += offset; }
+        for (size_t i = 0; i < period; ++i) {
+          op[i] = match[i];
+        }
+        for (byte* p = op + period; p < mend; p += 8) {
+          memcpy(p, p - period, 8);
+        }
+      }
+    }
+    else {
+      for (size_t i = 0; i < matchLen; ++i) {
+        op[i] = match[i];
+      }
+    }
+    op = mend;
+  }
+
+  dst->len = op - dst->buf;
+  return true;
+}
+
+bool lz_compressFrame(alloc_t mem, lz_ctx* ctx, larr_byte src, dynarr_byte* dst) {
+  size_t len0 = dst->len;
+  if (!reserve(mem, dst, 4)) { return false; }
+  memcpy(&dst->buf[dst->len], FRAME_MAGIC, 4);
+  dst->len += 4;
+
+  while (src.len != 0) {
+    size_t n = src.len < CHIM_LZ_FRAMEBLOCK ? src.len : CHIM_LZ_FRAMEBLOCK;
+    larr_byte raw = larr_mk_byte(n, src.arr);
+    if (!reserve(mem, dst, 12 + lz_bound(n))) {
+      dst->len = len0;
+      return false;
+    }
+    size_t header = dst->len;
+    dst->len += 8;
+    lz_compressBlock(ctx, raw, dst); // cannot fail: capacity was reserved
+    uint32_t size = dst->len - header - 8;
+    if (size >= n) {
+      // incompressible: store it instead
+      memcpy(&dst->buf[header + 8], raw.arr, n);
+      dst->len = header + 8 + n;
+      size = n | FRAME_STORED;
+    }
+    write32le(&dst->buf[header], size);
+    write32le(&dst->buf[header + 4], n);
+    write32le(&dst->buf[dst->len], xxh32(raw.arr, n, 0));
+    dst->len += 4;
+    larr_advance_byte(&src, n);
+  }
+
+  if (!reserve(mem, dst, 4)) {
+    dst->len = len0;
+    return false;
+  }
+  write32le(&dst->buf[dst->len], 0);
+  dst->len += 4;
+  return true;
+}
+
+bool lz_decompressFrame(alloc_t mem, larr_byte* src, dynarr_byte* dst) {
+  size_t len0 = dst->len;
+  const byte* ip = src->arr;
+  const byte* const iend = ip + src->len;
+  if (iend - ip < 4 || memcmp(ip, FRAME_MAGIC, 4) != 0) { return false; }
+  ip += 4;
+
+  for (;;) {
+    if (iend - ip < 4) { goto fail; }
+    uint32_t size = read32le(ip);
+    ip += 4;
+    if (size == 0) { break; }
+    bool stored = (size & FRAME_STORED) != 0;
+    size &= ~FRAME_STORED;
+    if (iend - ip < 4) { goto fail; }
+    uint32_t rawSize = read32le(ip);
+    ip += 4;
+    if (rawSize == 0 || rawSize > CHIM_LZ_FRAMEBLOCK) { goto fail; }
+    if (size > (size_t)(iend - ip) || (size_t)(iend - ip) - size < 4) { goto fail; }
+    // leave some slack, so that decompression can use its fast paths to the end
+    if (!reserve(mem, dst, rawSize + 32)) { goto fail; }
+
+    size_t start = dst->len;
+    if (stored) {
+      if (size != rawSize) { goto fail; }
+      memcpy(&dst->buf[start], ip, rawSize);
+      dst->len += rawSize;
+    }
+    else if (!lz_decompressBlock(larr_mk_byte(size, (byte*)ip), dst) || dst->len - start != rawSize) {
+      goto fail;
+    }
+    ip += size;
+    if (read32le(ip) != xxh32(&dst->buf[start], rawSize, 0)) { goto fail; }
+    ip += 4;
+  }
+
+  larr_advance_byte(src, ip - src->arr);
+  return true;
+
+fail:
+  dst->len = len0;
+  return false;
+}
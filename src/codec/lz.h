@@ -0,0 +1,120 @@
+/// @file
+/// @brief Fast LZ77-family compression of byte slices.
+///
+/// Blocks use the LZ4 block format: a sequence of (literals, back-reference) pairs,
+///   with match offsets of at most 64 KiB and a minimum match length of four.
+/// Any LZ4 block decoder can decompress them, and {@link lz_decompressBlock} accepts blocks from any LZ4 encoder.
+///
+/// The compressor finds matches through a hash table of recent positions, chained to earlier positions with the same hash.
+/// Searching deeper into the chains ({@link lz_ctx_init}'s `depth`) finds longer matches at the cost of speed;
+///   a depth of one takes a separate path, which mirrors LZ4's fast mode (smaller hash tables, and no chains),
+///   and produces the same blocks as its default acceleration.
+/// The tables live in an {@link lz_ctx}, allocated once through an {@link alloc_t} and reused across calls.
+///
+/// The block functions neither allocate nor grow their output: the caller reserves capacity in the destination buffer
+///   ({@link lz_bound} for compression, the known decompressed size for decompression),
+///   and output is appended after the buffer's current length.
+///
+/// Blocks carry no lengths or checksums of their own, so for storage and transmission there is also a frame format:
+///   ```
+///   frame := "CHLZ" block* end
+///   block := u32le(compressed size, high bit set if stored uncompressed) u32le(raw size) data u32le(xxh32 of the raw data)
+///   end   := u32le(0)
+///   ```
+/// Each block holds at most {@link CHIM_LZ_FRAMEBLOCK} raw bytes, and is compressed independently of the others.
+
+#ifndef CHIM_CODEC_LZ
+#define CHIM_CODEC_LZ
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+/// @brief log2 of the number of entries in the hash table of the chained match finder (depths above one).
+#define CHIM_LZ_HASHLOG 14
+/// @brief Largest distance a back-reference can reach, in bytes.
+#define CHIM_LZ_WINDOW 65536
+/// @brief Largest input accepted by {@link lz_compressBlock}, in bytes.
+#define CHIM_LZ_MAXBLOCK ((size_t)0x7E000000)
+/// @brief Largest raw size of a block within a frame, in bytes.
+#define CHIM_LZ_FRAMEBLOCK ((size_t)1 << 16)
+
+
+/// @brief Compression state: the match finder's tables.
+typedef struct lz_ctx {
+  /// @brief most recent position for each hash
+  uint32_t* head;
+  /// @brief distance from each position (modulo the window) to the previous one with the same hash, or zero
+  ///   (at a depth of one, where there are no chains, the hash table for blocks no larger than the window)
+  uint16_t* chain;
+  /// @brief position number of the start of the next block
+  uint32_t next;
+  /// @brief how many candidates to examine for each match
+  unsigned depth;
+} lz_ctx;
+
+/// @brief Allocate the tables for compression.
+///
+/// @param mem: allocator
+/// @param ctx: the context
+/// @param depth: how many chained candidates to examine per match (at least one)
+/// @return false if allocation fails
+bool lz_ctx_init(alloc_t mem, lz_ctx* ctx, unsigned depth);
+
+/// @brief Free the tables for compression.
+///
+/// @param mem: allocator
+/// @param ctx: the context
+void lz_ctx_deinit(alloc_t mem, lz_ctx* ctx);
+
+/// @brief The largest possible size of a compressed block.
+///
+/// @param srcLen: size of the input, in bytes
+/// @return capacity to reserve for {@link lz_compressBlock}
+size_t lz_bound(size_t srcLen);
+
+/// @brief Compress a block.
+///
+/// @param ctx: the context
+/// @param src: the input, at most {@link CHIM_LZ_MAXBLOCK} bytes
+/// @param dst: the compressed block is appended here; it must have at least {@link lz_bound} bytes of spare capacity
+/// @return false if the input is too large or `dst` has too little spare capacity (`dst` is unchanged)
+bool lz_compressBlock(lz_ctx* ctx, larr_byte src, dynarr_byte* dst);
+
+/// @brief Decompress a block.
+///
+/// Back-references may only refer to data produced by this same call.
+/// Malformed input is detected, and never causes reads or writes out of bounds.
+///
+/// @param src: the compressed block
+/// @param dst: the decompressed data is appended here; it must have enough spare capacity to hold it
+///   (and decompression is fastest with 32 bytes to spare beyond that)
+/// @return false if the block is malformed or `dst` has too little spare capacity
+///   (`dst`'s length is unchanged, though bytes past its length may have been overwritten)
+bool lz_decompressBlock(larr_byte src, dynarr_byte* dst);
+
+/// @brief Compress a whole input into a frame.
+///
+/// @param mem: allocator for `dst`
+/// @param ctx: the context
+/// @param src: the input
+/// @param dst: the frame is appended here, growing the buffer as needed
+/// @return false if allocation fails (`dst`'s length is unchanged)
+bool lz_compressFrame(alloc_t mem, lz_ctx* ctx, larr_byte src, dynarr_byte* dst);
+
+/// @brief Decompress and verify a frame.
+///
+/// @param mem: allocator for `dst`
+/// @param src: the frame; on success, it is advanced past the end of the frame
+/// @param dst: the decompressed data is appended here, growing the buffer as needed
+/// @return false if the frame is malformed, a checksum does not match, or allocation fails
+///   (`src` and `dst`'s length are unchanged)
+bool lz_decompressFrame(alloc_t mem, larr_byte* src, dynarr_byte* dst);
+
+
+#endif
@@ -0,0 +1,247 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/aligned.h"
+#include "io/error.h"
+#include "io/uring.h"
+#include "slice/byte.h"
+
+#include "direct.h"
+
+
+#define BLOCK CHIM_DIRECT_BLOCK
+#define NONE UINT32_MAX
+
+int direct_open(const char* path, int flags, int mode, bool* direct, io_error* err) {
+  int fd;
+  do { fd = open(path, flags | O_DIRECT, mode); } while (fd < 0 && errno == EINTR);
+  bool isDirect = fd >= 0;
+  // filesystems without direct I/O refuse the flag with EINVAL
+  if (fd < 0 && errno == EINVAL) {
+    do { fd = open(path, flags, mode); } while (fd < 0 && errno == EINTR);
+  }
+  if (fd < 0) {
+    io_error_set(err, IO_OP_OPEN, errno, -1, -1);
+    return -1;
+  }
+  if (direct != NULL) { *direct = isDirect; }
+  return fd;
+}
+
+
+////// Reader //////
+
+// Start reading as many chunks as there are free buffers.
+static
+void submitChunks(direct_reader* r) {
+  while (r->nextSubmit < r->nChunks) {
+    int64_t off = r->base + (int64_t)(r->nextSubmit * r->chunk);
+    // the last chunk is cut short, but only to a whole block
+    size_t len = r->chunk;
+    if ((uint64_t)(r->end - off) < len) { len = alignUp(r->end - off, BLOCK); }
+    if (!uring_submit(&r->io, r->fd, off, len, r->nextSubmit)) { break; }
+    r->nextSubmit += 1;
+  }
+}
+
+bool direct_reader_init(aligned_alloc_t mem, direct_reader* r, int fd, int64_t start, int64_t end, size_t chunk, uint32_t depth, io_error* err) {
+  assert(0 <= start && start <= end);
+  assert(depth >= 2);
+  r->fd = fd;
+  r->start = start;
+  r->end = end;
+  r->base = alignDown(start, BLOCK);
+  r->chunk = alignUp(chunk == 0 ? BLOCK : chunk, BLOCK);
+  r->nChunks = (alignUp(end - r->base, BLOCK) + r->chunk - 1) / r->chunk;
+  r->nextSubmit = 0;
+  r->nextReturn = 0;
+  r->lent = NONE;
+  r->held = aallocIn(mem, alignof(uring_completion), depth * sizeof(uring_completion));
+  if (r->held == NULL) {
+    io_error_set(err, IO_OP_ALLOC, ENOMEM, -1, -1);
+    return false;
+  }
+  for (uint32_t i = 0; i < depth; ++i) {
+    r->held[i].tag = UINT64_MAX;
+  }
+  if (!uring_init(mem, &r->io, depth, r->chunk, true, err)) {
+    afreeIn(mem, r->held);
+    return false;
+  }
+  // get the first reads going before the caller asks for anything
+  submitChunks(r);
+  if (uring_isAsync(&r->io)) { uring_poll(&r->io, NULL, 0, 0, NULL); }
+  return true;
+}
+
+void direct_reader_deinit(aligned_alloc_t mem, direct_reader* r) {
+  uring_deinit(mem, &r->io);
+  afreeIn(mem, r->held);
+}
+
+bool direct_next(direct_reader* r, larr_byte* out, io_error* err) {
+  if (r->lent != NONE) {
+    uring_release(&r->io, r->lent);
+    r->lent = NONE;
+  }
+  if (r->nextReturn >= r->nChunks) {
+    *out = larr_mk_byte(0, NULL);
+    return true;
+  }
+  submitChunks(r);
+  uint32_t depth = r->io.depth;
+  uring_completion* want = &r->held[r->nextReturn % depth];
+  // collect completions (and pass on the new submissions) until the one wanted has arrived;
+  //   others are held for later, as they may finish out of order
+  uring_completion done[16];
+  do {
+    size_t n = uring_poll(&r->io, done, 16, want->tag == r->nextReturn ? 0 : 1, err);
+    if (n == 0 && want->tag != r->nextReturn) { return false; }
+    for (size_t i = 0; i < n; ++i) {
+      r->held[done[i].tag % depth] = done[i];
+    }
+  } while (want->tag != r->nextReturn);
+
+  uring_completion c = *want;
+  want->tag = UINT64_MAX;
+  r->lent = c.buf;
+  if (c.err.code != 0) {
+    if (err != NULL) { *err = c.err; }
+    return false;
+  }
+  int64_t off = r->base + (int64_t)(c.tag * r->chunk);
+  size_t asked = r->chunk;
+  if ((uint64_t)(r->end - off) < asked) { asked = alignUp(r->end - off, BLOCK); }
+  // a short read means the file ended: there is nothing more after this chunk
+  if (c.data.len < asked && off + (int64_t)c.data.len < r->end) {
+    r->end = off + c.data.len;
+    r->nChunks = c.tag + 1;
+  }
+  // trim to the range wanted: the head of the first chunk and the tail of the last are outside it
+  size_t head = c.tag == 0 ? (size_t)(r->start - r->base) : 0;
+  size_t tail = c.data.len;
+  if ((uint64_t)(r->end - off) < tail) { tail = r->end - off; }
+  if (tail < head) { tail = head; }
+  *out = larr_mk_byte(tail - head, c.data.arr + head);
+  r->nextReturn += 1;
+  return true;
+}
+
+
+////// Writer //////
+
+// Read whole blocks into `dst`, zero-filling anything past the end of the file.
+static
+bool readBlocks(int fd, byte* dst, size_t len, int64_t offset, io_error* err) {
+  size_t got = 0;
+  while (got < len) {
+    ssize_t res = pread(fd, dst + got, len - got, offset + got);
+    if (res > 0) { got += res; continue; }
+    if (res == 0) { break; }
+    if (errno == EINTR) { continue; }
+    io_error_set(err, IO_OP_READ, errno, fd, offset + got);
+    return false;
+  }
+  memset(dst + got, 0, len - got);
+  return true;
+}
+
+static
+bool writeAll(int fd, const byte* src, size_t len, int64_t offset, io_error* err) {
+  size_t put = 0;
+  while (put < len) {
+    ssize_t res = pwrite(fd, src + put, len - put, offset + put);
+    if (res > 0) { put += res; continue; }
+    if (res < 0 && errno == EINTR) { continue; }
+    io_error_set(err, IO_OP_WRITE, res < 0 ? errno : EIO, fd, offset + put);
+    return false;
+  }
+  return true;
+}
+
+bool direct_writer_init(aligned_alloc_t mem, direct_writer* w, int fd, int64_t offset, size_t bufSize, io_error* err) {
+  assert(offset >= 0);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    io_error_set(err, IO_OP_OPEN, errno, fd, -1);
+    return false;
+  }
+  w->fd = fd;
+  w->size0 = st.st_size;
+  w->cap = alignUp(bufSize == 0 ? BLOCK : bufSize, BLOCK);
+  w->buf = aallocIn(mem, BLOCK, w->cap + BLOCK);
+  if (w->buf == NULL) {
+    io_error_set(err, IO_OP_ALLOC, ENOMEM, -1, -1);
+    return false;
+  }
+  w->pos = alignDown(offset, BLOCK);
+  w->fill = offset - w->pos;
+  // an unaligned start keeps the bytes of its block before it
+  if (w->fill != 0 && !readBlocks(fd, w->buf, BLOCK, w->pos, err)) {
+    afreeIn(mem, w->buf);
+    return false;
+  }
+  return true;
+}
+
+void direct_writer_deinit(aligned_alloc_t mem, direct_writer* w) {
+  afreeIn(mem, w->buf);
+}
+
+bool direct_write(direct_writer* w, larr_byte src, io_error* err) {
+  while (src.len != 0) {
+    size_t n = w->cap - w->fill;
+    if (n > src.len) { n = src.len; }
+    memcpy(w->buf + w->fill, src.arr, n);
+    w->fill += n;
+    larr_advance_byte(&src, n);
+    if (w->fill == w->cap) {
+      if (!writeAll(w->fd, w->buf, w->cap, w->pos, err)) {
+        w->fill -= n;
+        return false;
+      }
+      w->pos += w->cap;
+      w->fill = 0;
+    }
+  }
+  return true;
+}
+
+bool direct_finish(direct_writer* w, io_error* err) {
+  size_t whole = alignDown(w->fill, BLOCK);
+  size_t part = w->fill - whole;
+  size_t len = whole;
+  if (part != 0) {
+    // merge the tail with the rest of its block from the file, using the scratch block after the buffer
+    byte* scratch = w->buf + w->cap;
+    if (!readBlocks(w->fd, scratch, BLOCK, w->pos + whole, err)) { return false; }
+    memcpy(w->buf + w->fill, scratch + part, BLOCK - part);
+    len += BLOCK;
+  }
+  if (!writeAll(w->fd, w->buf, len, w->pos, err)) { return false; }
+  // writing the whole last block may have lengthened the file past what was written
+  int64_t endPos = w->pos + w->fill;
+  int64_t size = endPos > w->size0 ? endPos : w->size0;
+  if (w->pos + (int64_t)len > size && ftruncate(w->fd, size) != 0) {
+    io_error_set(err, IO_OP_TRUNCATE, errno, w->fd, size);
+    return false;
+  }
+  w->size0 = size;
+  // keep the partial block buffered, so that further writes continue it
+  memmove(w->buf, w->buf + whole, part);
+  w->pos += whole;
+  w->fill = part;
+  return true;
+}
@@ -0,0 +1,159 @@
+/// @file
+/// @brief Direct I/O (`O_DIRECT`), bypassing the page cache, for large sequential scans and writes.
+///
+/// Reading a large file through the page cache evicts data that is actually hot, only to cache data read once.
+/// Direct I/O moves data between the device and user buffers without caching,
+///   but requires the buffer address, file offset, and length of every transfer to be multiples of the block size.
+/// The reader and writer here keep to those rules internally
+///   (with block-aligned buffers from an {@link aligned_alloc_t}, and offsets rounded with {@link alignDown} and {@link alignUp}),
+///   so callers can scan or write any byte range:
+///   an unaligned head or tail is read as whole blocks and trimmed, or merged with the file's existing bytes before writing.
+///
+/// The reader is double-buffered (or more): it keeps the next chunks of the range in flight through an {@link uring_reader}
+///   while the caller processes the current one, so the device is never idle waiting for the caller.
+///
+/// Filesystems which do not support direct I/O (such as tmpfs) are handled by {@link direct_open} opening the file normally;
+///   everything else works the same on either kind of file descriptor.
+
+#ifndef CHIM_IO_DIRECT
+#define CHIM_IO_DIRECT
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/aligned.h"
+#include "chimtypes.h"
+#include "io/error.h"
+#include "io/uring.h"
+#include "slice/byte.h"
+
+/// @brief Alignment used for direct transfers.
+///
+/// This is at least the logical block size of any common device (512 or 4096 bytes), and is also the page size.
+#define CHIM_DIRECT_BLOCK 4096
+
+
+/// @brief Sequential reader of a byte range.
+typedef struct direct_reader {
+  /// @brief the reads in flight
+  uring_reader io;
+  /// @brief file being read
+  int fd;
+  /// @brief offset of the first byte wanted
+  int64_t start;
+  /// @brief offset after the last byte wanted (reduced on reaching the end of the file)
+  int64_t end;
+  /// @brief `start`, rounded down to a block
+  int64_t base;
+  /// @brief bytes per chunk read (a multiple of the block size)
+  size_t chunk;
+  /// @brief number of chunks covering the range
+  uint64_t nChunks;
+  /// @brief next chunk to start reading
+  uint64_t nextSubmit;
+  /// @brief next chunk to return
+  uint64_t nextReturn;
+  /// @brief chunks which completed out of order, indexed by chunk number modulo the depth (empty ones have tag `UINT64_MAX`)
+  uring_completion* held;
+  /// @brief buffer of the chunk last returned, to be released on the next call, or `UINT32_MAX`
+  uint32_t lent;
+} direct_reader;
+
+/// @brief Writer of a byte range.
+typedef struct direct_writer {
+  /// @brief file being written
+  int fd;
+  /// @brief block-aligned buffer of `cap` bytes, followed by one block of scratch space
+  byte* buf;
+  /// @brief bytes in `buf` (a multiple of the block size)
+  size_t cap;
+  /// @brief bytes of `buf` filled
+  size_t fill;
+  /// @brief file offset of `buf[0]` (a multiple of the block size)
+  int64_t pos;
+  /// @brief size of the file when the writer was created, so that finishing never truncates existing data
+  int64_t size0;
+} direct_writer;
+
+/// @brief Open a file for direct I/O.
+///
+/// If the filesystem does not support direct I/O, the file is opened normally instead.
+///
+/// @param path: the file
+/// @param flags: flags for `open` (`O_DIRECT` is added)
+/// @param mode: mode for `open`, when creating the file
+/// @param direct: on success, where to store whether the file was opened for direct I/O, or `NULL`
+/// @param err: where to record a failure, or `NULL`
+/// @return the file descriptor, or -1 on failure
+int direct_open(const char* path, int flags, int mode, bool* direct, io_error* err);
+
+/// @brief Start reading a byte range.
+///
+/// @param mem: allocator for the buffers
+/// @param r: the reader
+/// @param fd: the file
+/// @param start: offset of the first byte to read
+/// @param end: offset after the last byte to read (the end of the file stops the read early)
+/// @param chunk: bytes to read at a time (rounded up to a multiple of the block size)
+/// @param depth: chunks to keep in flight, at least two
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool direct_reader_init(aligned_alloc_t mem, direct_reader* r, int fd, int64_t start, int64_t end, size_t chunk, uint32_t depth, io_error* err);
+
+/// @brief Stop reading, and free the buffers.
+///
+/// @param mem: the allocator given to {@link direct_reader_init}
+/// @param r: the reader
+void direct_reader_deinit(aligned_alloc_t mem, direct_reader* r);
+
+/// @brief Get the next part of the range.
+///
+/// The returned slice is valid until the next call.
+///
+/// @param r: the reader
+/// @param out: where to store the next bytes of the range; empty once the range (or file) is exhausted
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool direct_next(direct_reader* r, larr_byte* out, io_error* err);
+
+/// @brief Start writing at an offset.
+///
+/// @param mem: allocator for the buffer
+/// @param w: the writer
+/// @param fd: the file
+/// @param offset: where to start writing
+/// @param bufSize: bytes to buffer between writes (rounded up to a multiple of the block size)
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool direct_writer_init(aligned_alloc_t mem, direct_writer* w, int fd, int64_t offset, size_t bufSize, io_error* err);
+
+/// @brief Free a writer's buffer.
+///
+/// Data not yet written by {@link direct_finish} is discarded.
+///
+/// @param mem: the allocator given to {@link direct_writer_init}
+/// @param w: the writer
+void direct_writer_deinit(aligned_alloc_t mem, direct_writer* w);
+
+/// @brief Append bytes.
+///
+/// @param w: the writer
+/// @param src: the bytes
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool direct_write(direct_writer* w, larr_byte src, io_error* err);
+
+/// @brief Write out buffered bytes, including an unaligned tail.
+///
+/// The tail is written as a whole block, merged with the bytes of the file after it;
+///   if that lengthens the file, it is truncated back to the end of what was written.
+/// The writer may continue to be used afterwards.
+///
+/// @param w: the writer
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool direct_finish(direct_writer* w, io_error* err);
+
+
+#endif
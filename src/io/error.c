@@ -0,0 +1,66 @@
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "text/format.h"
+
+#undef INLINE
+#define INLINE
+#include "error.h"
+
+
+static
+bool reserve(alloc_t mem, dynarr_byte* dst, size_t extra) {
+  if (dst->cap - dst->len >= extra) { return true; }
+  if (extra > SIZE_MAX - dst->len) { return false; }
+  size_t cap = dst->cap > SIZE_MAX / 2 ? SIZE_MAX : 2 * dst->cap;
+  if (cap < dst->len + extra) { cap = dst->len + extra; }
+  return dynarr_resize_byte(mem, dst, cap);
+}
+
+static
+bool appendStr(alloc_t mem, dynarr_byte* dst, const char* str) {
+  size_t len = strlen(str);
+  if (!reserve(mem, dst, len)) { return false; }
+  memcpy(dst->buf + dst->len, str, len);
+  dst->len += len;
+  return true;
+}
+
+const char* io_op_name(io_op op) {
+  switch (op) {
+    case IO_OP_NONE: return "no operation";
+    case IO_OP_SETUP: return "setup";
+    case IO_OP_OPEN: return "open";
+    case IO_OP_ALLOC: return "allocation";
+    case IO_OP_READ: return "read";
+    case IO_OP_WRITE: return "write";
+    case IO_OP_TRUNCATE: return "truncate";
+    case IO_OP_TRANSFER: return "transfer";
+  }
+  return "unknown operation";
+}
+
+bool io_error_describe(alloc_t mem, dynarr_byte* dst, const io_error* err) {
+  size_t len0 = dst->len;
+  bool ok = appendStr(mem, dst, io_op_name(err->op));
+  if (ok && err->fd >= 0) {
+    ok = appendStr(mem, dst, " of fd ") && fmt_i32(mem, dst, err->fd);
+  }
+  if (ok && err->offset >= 0) {
+    ok = appendStr(mem, dst, " at offset ") && fmt_i64(mem, dst, err->offset);
+  }
+  if (ok) {
+    // the GNU `strerror_r` returns a string, which may or may not be in the buffer given
+    char msg[128];
+    ok = appendStr(mem, dst, ": ")
+      && appendStr(mem, dst, err->code == 0 ? "no error" : strerror_r(err->code, msg, sizeof(msg)));
+  }
+  if (!ok) { dst->len = len0; }
+  return ok;
+}
@@ -0,0 +1,99 @@
+/// @file
+/// @brief Structured errors for I/O, shared by the `io/` modules.
+///
+/// A bare `errno` says what went wrong, but not where: which operation, on which file, at which offset.
+/// An {@link io_error} records all of that, so that a failure deep in a batch of asynchronous or bulk I/O
+///   can still be reported usefully (and attributed to the request which caused it).
+///
+/// Functions which can fail take an `io_error*` out-parameter, which may be `NULL` if the caller does not need the details.
+/// It is only written on failure.
+
+#ifndef CHIM_IO_ERROR
+#define CHIM_IO_ERROR
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+
+
+/// @brief The operation which failed.
+typedef enum io_op {
+  /// @brief no operation (the error is clear)
+  IO_OP_NONE = 0,
+  /// @brief setting up an I/O context (e.g. an io_uring instance)
+  IO_OP_SETUP,
+  /// @brief opening a file
+  IO_OP_OPEN,
+  /// @brief allocating buffers
+  IO_OP_ALLOC,
+  /// @brief reading from a file
+  IO_OP_READ,
+  /// @brief writing to a file
+  IO_OP_WRITE,
+  /// @brief setting the size of a file
+  IO_OP_TRUNCATE,
+  /// @brief moving data between files inside the kernel
+  IO_OP_TRANSFER,
+} io_op;
+
+/// @brief Where and why an I/O operation failed.
+typedef struct io_error {
+  /// @brief what was being done
+  io_op op;
+  /// @brief `errno` value describing the failure, or zero if there was none
+  int code;
+  /// @brief file descriptor operated on, or -1 if there was none
+  int fd;
+  /// @brief file offset of the operation, or -1 if there was none
+  int64_t offset;
+} io_error;
+
+/// @brief Record a failure.
+///
+/// @param err: where to record it, or `NULL` to discard it
+/// @param op: what was being done
+/// @param code: `errno` value
+/// @param fd: file descriptor operated on, or -1
+/// @param offset: file offset of the operation, or -1
+INLINE
+void io_error_set(io_error* err, io_op op, int code, int fd, int64_t offset) {
+  if (err == NULL) { return; }
+  err->op = op;
+  err->code = code;
+  err->fd = fd;
+  err->offset = offset;
+}
+
+/// @brief Clear an error, so that it records no failure.
+///
+/// @param err: the error, or `NULL`
+INLINE
+void io_error_clear(io_error* err) {
+  io_error_set(err, IO_OP_NONE, 0, -1, -1);
+}
+
+/// @brief Name an operation, for messages.
+///
+/// @param op: the operation
+/// @return a static, lower-case name, such as `"read"`
+const char* io_op_name(io_op op);
+
+/// @brief Append a human-readable description of an error.
+///
+/// For example, `read of fd 3 at offset 4096: Input/output error`.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param err: the error
+/// @return false if allocation fails
+bool io_error_describe(alloc_t mem, dynarr_byte* dst, const io_error* err);
+
+
+#endif
@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+#define _FILE_OFFSET_BITS 64
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "io/error.h"
+
+#include "transfer.h"
+
+
+// most bytes to ask of one system call (sendfile stops a little short of 2 GiB anyway)
+#define MAXCHUNK ((uint64_t)1 << 30)
+
+// the intermediate pipe is enlarged to this, if the system allows
+#define PIPESIZE (1 << 20)
+
+typedef struct job {
+  int from;
+  int to;
+  // offsets, or -1 to use the files' positions
+  int64_t fromOff;
+  int64_t toOff;
+  uint64_t left;
+  uint64_t moved;
+} job;
+
+typedef enum outcome {
+  // everything was moved, or the source ended
+  DONE,
+  // the method does not apply to these files, and nothing was moved by it
+  UNSUPPORTED,
+  // an error was recorded
+  FAILED,
+} outcome;
+
+// The errors by which the kernel refuses a method for a pair of files.
+// (Some mean misuse, such as EBADF for a file not open for reading; then the buffered copy fails the same way, and reports it.)
+static inline
+bool refused(int code) {
+  return code == EINVAL || code == ENOSYS || code == EXDEV || code == EOPNOTSUPP || code == EBADF;
+}
+
+static inline
+size_t chunkOf(const job* j) {
+  return j->left < MAXCHUNK ? j->left : MAXCHUNK;
+}
+
+static inline
+void advance(job* j, uint64_t n) {
+  j->left -= n;
+  j->moved += n;
+  if (j->fromOff >= 0) { j->fromOff += n; }
+  if (j->toOff >= 0) { j->toOff += n; }
+}
+
+static
+outcome viaCopyFileRange(job* j, io_error* err) {
+  bool any = false;
+  while (j->left != 0) {
+    loff_t in = j->fromOff, out = j->toOff;
+    ssize_t n = copy_file_range(j->from, j->fromOff >= 0 ? &in : NULL, j->to, j->toOff >= 0 ? &out : NULL, chunkOf(j), 0);
+    if (n > 0) { advance(j, n); any = true; continue; }
+    // some kernels answer zero, rather than an error, for files they cannot copy between (e.g. in procfs);
+    //   at a genuine end of file, the next method finds the same end quickly
+    if (n == 0) { return any ? DONE : UNSUPPORTED; }
+    if (errno == EINTR) { continue; }
+    if (!any && refused(errno)) { return UNSUPPORTED; }
+    io_error_set(err, IO_OP_TRANSFER, errno, j->from, j->fromOff);
+    return FAILED;
+  }
+  return DONE;
+}
+
+static
+outcome viaSendfile(job* j, io_error* err) {
+  bool any = false;
+  while (j->left != 0) {
+    off_t in = j->fromOff;
+    ssize_t n = sendfile(j->to, j->from, j->fromOff >= 0 ? &in : NULL, chunkOf(j));
+    if (n > 0) { advance(j, n); any = true; continue; }
+    if (n == 0) { return DONE; }
+    if (errno == EINTR) { continue; }
+    if (!any && refused(errno)) { return UNSUPPORTED; }
+    io_error_set(err, IO_OP_TRANSFER, errno, j->from, j->fromOff);
+    return FAILED;
+  }
+  return DONE;
+}
+
+// Splice when one side is a pipe.
+static
+outcome viaSplice(job* j, io_error* err) {
+  bool any = false;
+  while (j->left != 0) {
+    loff_t in = j->fromOff, out = j->toOff;
+    ssize_t n = splice(j->from, j->fromOff >= 0 ? &in : NULL, j->to, j->toOff >= 0 ? &out : NULL, chunkOf(j), SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n > 0) { advance(j, n); any = true; continue; }
+    if (n == 0) { return DONE; }
+    if (errno == EINTR) { continue; }
+    if (!any && refused(errno)) { return UNSUPPORTED; }
+    io_error_set(err, IO_OP_TRANSFER, errno, j->from, j->fromOff);
+    return FAILED;
+  }
+  return DONE;
+}
+
+// Splice through a pipe of our own, for two files neither of which is a pipe.
+static
+outcome viaPipe(job* j, io_error* err) {
+  int pipeFds[2];
+  if (pipe2(pipeFds, O_CLOEXEC) != 0) { return UNSUPPORTED; }
+  int size = fcntl(pipeFds[1], F_SETPIPE_SZ, PIPESIZE);
+  if (size <= 0) { size = fcntl(pipeFds[1], F_GETPIPE_SZ); }
+  if (size <= 0) { size = 1 << 16; }
+  outcome result = DONE;
+  bool any = false;
+  while (j->left != 0) {
+    loff_t in = j->fromOff;
+    size_t want = j->left < (uint64_t)size ? j->left : (size_t)size;
+    ssize_t n = splice(j->from, j->fromOff >= 0 ? &in : NULL, pipeFds[1], NULL, want, SPLICE_F_MOVE | SPLICE_F_MORE);
+    if (n == 0) { break; }
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      if (!any && refused(errno)) { result = UNSUPPORTED; break; }
+      io_error_set(err, IO_OP_READ, errno, j->from, j->fromOff);
+      result = FAILED;
+      break;
+    }
+    // drain what came in, before advancing past it
+    size_t inPipe = n;
+    while (inPipe != 0) {
+      loff_t out = j->toOff;
+      ssize_t m = splice(pipeFds[0], NULL, j->to, j->toOff >= 0 ? &out : NULL, inPipe, SPLICE_F_MOVE | SPLICE_F_MORE);
+      if (m > 0) { advance(j, m); inPipe -= m; any = true; continue; }
+      if (m < 0 && errno == EINTR) { continue; }
+      // the destination refused at the outset: an explicit source offset has not moved, so another method can start over,
+      //   but from a file's position, the bytes are already taken, and stranded in the pipe
+      if (!any && m < 0 && refused(errno) && j->fromOff >= 0) { result = UNSUPPORTED; break; }
+      io_error_set(err, IO_OP_WRITE, m < 0 ? errno : EIO, j->to, j->toOff);
+      result = FAILED;
+      break;
+    }
+    if (result != DONE) { break; }
+  }
+  close(pipeFds[0]);
+  close(pipeFds[1]);
+  return result;
+}
+
+static
+outcome viaBuffer(alloc_t mem, job* j, io_error* err) {
+  size_t cap = j->left < CHIM_TRANSFER_BUFSIZE ? j->left : CHIM_TRANSFER_BUFSIZE;
+  char* buf = allocIn(mem, cap);
+  if (buf == NULL) {
+    io_error_set(err, IO_OP_ALLOC, ENOMEM, -1, -1);
+    return FAILED;
+  }
+  outcome result = DONE;
+  while (j->left != 0) {
+    size_t want = j->left < cap ? j->left : cap;
+    ssize_t n = j->fromOff >= 0 ? pread(j->from, buf, want, j->fromOff) : read(j->from, buf, want);
+    if (n == 0) { break; }
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      io_error_set(err, IO_OP_READ, errno, j->from, j->fromOff);
+      result = FAILED;
+      break;
+    }
+    for (size_t put = 0; put < (size_t)n;) {
+      ssize_t m = j->toOff >= 0 ? pwrite(j->to, buf + put, n - put, j->toOff) : write(j->to, buf + put, n - put);
+      if (m > 0) { advance(j, m); put += m; continue; }
+      if (m < 0 && errno == EINTR) { continue; }
+      io_error_set(err, IO_OP_WRITE, m < 0 ? errno : EIO, j->to, j->toOff);
+      result = FAILED;
+      break;
+    }
+    if (result != DONE) { break; }
+  }
+  freeIn(mem, buf);
+  return result;
+}
+
+bool transfer_copy(alloc_t mem, int from, int64_t fromOff, int to, int64_t toOff, uint64_t len, uint64_t* moved, io_error* err) {
+  job j = {.from = from, .to = to, .fromOff = fromOff < 0 ? -1 : fromOff, .toOff = toOff < 0 ? -1 : toOff, .left = len, .moved = 0};
+  struct stat fromSt, toSt;
+  bool known = fstat(from, &fromSt) == 0 && fstat(to, &toSt) == 0;
+  outcome result = len == 0 ? DONE : UNSUPPORTED;
+  if (known && result == UNSUPPORTED) {
+    if (S_ISFIFO(fromSt.st_mode) || S_ISFIFO(toSt.st_mode)) {
+      result = viaSplice(&j, err);
+    }
+    else {
+      if (S_ISREG(fromSt.st_mode) && S_ISREG(toSt.st_mode)) {
+        result = viaCopyFileRange(&j, err);
+      }
+      // sendfile writes at the destination's position only
+      if (result == UNSUPPORTED && j.toOff < 0 && (S_ISREG(fromSt.st_mode) || S_ISBLK(fromSt.st_mode))) {
+        result = viaSendfile(&j, err);
+      }
+      if (result == UNSUPPORTED) {
+        result = viaPipe(&j, err);
+      }
+    }
+  }
+  if (result == UNSUPPORTED) {
+    result = viaBuffer(mem, &j, err);
+  }
+  if (moved != NULL) { *moved = j.moved; }
+  return result != FAILED;
+}
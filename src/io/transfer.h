@@ -0,0 +1,44 @@
+/// @file
+/// @brief Moving data from one file descriptor to another without passing it through user space.
+///
+/// Copying by reading into a buffer and writing it back out touches every byte twice in user space.
+/// The kernel can instead move the data itself, by whichever means suits the pair of files:
+///   * `copy_file_range` between regular files (which some filesystems turn into a reflink, copying nothing at all),
+///   * `splice` when either side is a pipe,
+///   * `sendfile` from a regular file to a stream (such as a socket),
+///   * `splice` through an intermediate pipe for other pairs.
+///
+/// When the kernel refuses every method for a pair, {@link transfer_copy} falls back to copying through a large buffer.
+/// Failures are reported as an {@link io_error}, as for the rest of `io/`.
+
+#ifndef CHIM_IO_TRANSFER
+#define CHIM_IO_TRANSFER
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "io/error.h"
+
+/// @brief Size of the buffer used when no in-kernel method is possible.
+#define CHIM_TRANSFER_BUFSIZE (1 << 20)
+
+
+/// @brief Move bytes from one file to another.
+///
+/// For each file, an offset of -1 means to use (and advance) the file's own position, as for a pipe or socket;
+///   otherwise, the transfer is at that offset, and the file's position is unchanged.
+///
+/// @param mem: allocator for the buffer, if one is needed
+/// @param from: file to read
+/// @param fromOff: offset in `from`, or -1
+/// @param to: file to write
+/// @param toOff: offset in `to`, or -1
+/// @param len: bytes to move
+/// @param moved: where to store the number of bytes moved (less than `len` only if `from` ended, or on failure), or `NULL`
+/// @param err: where to record a failure, or `NULL`
+/// @return false on failure
+bool transfer_copy(alloc_t mem, int from, int64_t fromOff, int to, int64_t toOff, uint64_t len, uint64_t* moved, io_error* err);
+
+
+#endif
@@ -0,0 +1,293 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/aligned.h"
+#include "io/error.h"
+#include "slice/byte.h"
+
+#undef INLINE
+#define INLINE
+#include "uring.h"
+
+
+#define PAGE 4096
+
+// There are no libc wrappers for the io_uring system calls (short of liburing), so call them directly.
+
+static inline
+int ringSetup(unsigned entries, struct io_uring_params* p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static inline
+int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static inline
+int ringRegister(int fd, unsigned opcode, const void* arg, unsigned nArgs) {
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nArgs);
+}
+
+// The ring indices are shared with the kernel: we publish the submission tail and completion head with release,
+//   and read the completion tail with acquire, so entries are visible before their index says they are there.
+static inline
+uint32_t loadAcquire(uint32_t* p) {
+  return atomic_load_explicit((_Atomic(uint32_t)*)p, memory_order_acquire);
+}
+
+static inline
+void storeRelease(uint32_t* p, uint32_t x) {
+  atomic_store_explicit((_Atomic(uint32_t)*)p, x, memory_order_release);
+}
+
+static inline
+byte* bufferOf(const uring_reader* r, uint32_t buf) {
+  return r->bufs + (size_t)buf * r->bufSize;
+}
+
+
+////// io_uring setup //////
+
+static
+void unmapRing(uring_reader* r) {
+  if (r->sqes != NULL) { munmap(r->sqes, r->sqesLen); }
+  if (r->cqMap != NULL && r->cqMap != r->sqMap) { munmap(r->cqMap, r->cqMapLen); }
+  if (r->sqMap != NULL) { munmap(r->sqMap, r->sqMapLen); }
+  r->sqes = r->cqMap = r->sqMap = NULL;
+  close(r->ringFd);
+  r->ringFd = -1;
+}
+
+// Set up the ring, or leave `r->ringFd` at -1 if the kernel will not have it.
+static
+void setupRing(aligned_alloc_t mem, uring_reader* r) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  r->ringFd = ringSetup(r->depth, &p);
+  if (r->ringFd < 0) { r->ringFd = -1; return; }
+
+  r->sqMapLen = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  r->cqMapLen = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single) {
+    if (r->cqMapLen > r->sqMapLen) { r->sqMapLen = r->cqMapLen; }
+    r->cqMapLen = r->sqMapLen;
+  }
+  void* sq = mmap(NULL, r->sqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) { unmapRing(r); return; }
+  r->sqMap = sq;
+  if (single) {
+    r->cqMap = sq;
+  }
+  else {
+    void* cq = mmap(NULL, r->cqMapLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) { unmapRing(r); return; }
+    r->cqMap = cq;
+  }
+  r->sqesLen = p.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(NULL, r->sqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) { unmapRing(r); return; }
+  r->sqes = sqes;
+
+  byte* sqBase = r->sqMap;
+  byte* cqBase = r->cqMap;
+  r->sqTail = (uint32_t*)(sqBase + p.sq_off.tail);
+  r->sqMask = (uint32_t*)(sqBase + p.sq_off.ring_mask);
+  r->sqArray = (uint32_t*)(sqBase + p.sq_off.array);
+  r->cqHead = (uint32_t*)(cqBase + p.cq_off.head);
+  r->cqTail = (uint32_t*)(cqBase + p.cq_off.tail);
+  r->cqMask = (uint32_t*)(cqBase + p.cq_off.ring_mask);
+  r->cqes = cqBase + p.cq_off.cqes;
+
+  // Registered buffers save pinning pages on every read, but registration can fail (e.g. over RLIMIT_MEMLOCK);
+  //   then plain reads into the same buffers still work.
+  struct iovec* iov = aallocIn(mem, alignof(struct iovec), r->depth * sizeof(struct iovec));
+  if (iov != NULL) {
+    for (uint32_t i = 0; i < r->depth; ++i) {
+      iov[i].iov_base = bufferOf(r, i);
+      iov[i].iov_len = r->bufSize;
+    }
+    r->fixed = ringRegister(r->ringFd, IORING_REGISTER_BUFFERS, iov, r->depth) == 0;
+    afreeIn(mem, iov);
+  }
+}
+
+
+////// Reader //////
+
+bool uring_init(aligned_alloc_t mem, uring_reader* r, uint32_t depth, size_t bufSize, bool tryAsync, io_error* err) {
+  assert(0 < depth && depth <= CHIM_URING_MAXDEPTH);
+  memset(r, 0, sizeof(*r));
+  r->ringFd = -1;
+  r->depth = depth;
+  if (bufSize == 0 || bufSize > UINT32_MAX - PAGE) {
+    io_error_set(err, IO_OP_ALLOC, EINVAL, -1, -1);
+    return false;
+  }
+  r->bufSize = alignUp(bufSize, PAGE);
+  if (r->bufSize > SIZE_MAX / depth) {
+    io_error_set(err, IO_OP_ALLOC, ENOMEM, -1, -1);
+    return false;
+  }
+  r->bufs = aallocIn(mem, PAGE, depth * r->bufSize);
+  // bookkeeping shares one block: the slots, then the free stack, then the queue
+  size_t metaLen = depth * (sizeof(uring_slot) + 2 * sizeof(uint32_t));
+  byte* meta = aallocIn(mem, alignof(uring_slot), metaLen);
+  if (r->bufs == NULL || meta == NULL) {
+    if (r->bufs != NULL) { afreeIn(mem, r->bufs); }
+    if (meta != NULL) { afreeIn(mem, meta); }
+    io_error_set(err, IO_OP_ALLOC, ENOMEM, -1, -1);
+    return false;
+  }
+  r->slots = (uring_slot*)meta;
+  r->freeList = (uint32_t*)(meta + depth * sizeof(uring_slot));
+  r->queue = r->freeList + depth;
+  // stacked so that the lowest-numbered buffers are used first
+  for (uint32_t i = 0; i < depth; ++i) {
+    r->freeList[i] = depth - 1 - i;
+  }
+  r->nFree = depth;
+  if (tryAsync) { setupRing(mem, r); }
+  return true;
+}
+
+void uring_deinit(aligned_alloc_t mem, uring_reader* r) {
+  if (uring_isAsync(r)) {
+    // the kernel owns the buffers of reads in flight, so let them land before freeing
+    uring_completion done[64];
+    while (r->pending != 0) {
+      if (uring_poll(r, done, 64, 1, NULL) == 0) { break; }
+    }
+    unmapRing(r);
+  }
+  afreeIn(mem, r->slots);
+  afreeIn(mem, r->bufs);
+}
+
+bool uring_submit(uring_reader* r, int fd, int64_t offset, size_t len, uint64_t tag) {
+  assert(len <= r->bufSize);
+  if (r->nFree == 0) { return false; }
+  uint32_t buf = r->freeList[--r->nFree];
+  r->slots[buf] = (uring_slot){.tag = tag, .offset = offset, .fd = fd, .len = (uint32_t)len};
+  r->pending += 1;
+  if (!uring_isAsync(r)) {
+    r->queue[(r->qHead + r->pending - 1) % r->depth] = buf;
+    return true;
+  }
+  // we are the only submitter, so the tail needs no synchronization with ourselves, only publication to the kernel
+  uint32_t tail = *r->sqTail;
+  uint32_t idx = tail & *r->sqMask;
+  struct io_uring_sqe* sqe = (struct io_uring_sqe*)r->sqes + idx;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = r->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->off = (uint64_t)offset;
+  sqe->addr = (uint64_t)(uintptr_t)bufferOf(r, buf);
+  sqe->len = (uint32_t)len;
+  sqe->buf_index = r->fixed ? (uint16_t)buf : 0;
+  sqe->user_data = buf;
+  r->sqArray[idx] = idx;
+  storeRelease(r->sqTail, tail + 1);
+  r->unsent += 1;
+  return true;
+}
+
+// Collect completions already in the completion ring.
+static
+size_t harvest(uring_reader* r, uring_completion* out, size_t max) {
+  uint32_t head = *r->cqHead;
+  uint32_t tail = loadAcquire(r->cqTail);
+  uint32_t mask = *r->cqMask;
+  size_t n = 0;
+  for (; head != tail && n < max; ++head, ++n) {
+    const struct io_uring_cqe* cqe = (const struct io_uring_cqe*)r->cqes + (head & mask);
+    uint32_t buf = (uint32_t)cqe->user_data;
+    const uring_slot* slot = &r->slots[buf];
+    out[n].tag = slot->tag;
+    out[n].buf = buf;
+    if (cqe->res < 0) {
+      out[n].data = larr_mk_byte(0, bufferOf(r, buf));
+      io_error_set(&out[n].err, IO_OP_READ, -cqe->res, slot->fd, slot->offset);
+    }
+    else {
+      out[n].data = larr_mk_byte((size_t)cqe->res, bufferOf(r, buf));
+      io_error_clear(&out[n].err);
+    }
+  }
+  storeRelease(r->cqHead, head);
+  r->pending -= n;
+  return n;
+}
+
+// Perform queued reads in order, blocking.
+static
+size_t readQueued(uring_reader* r, uring_completion* out, size_t max) {
+  size_t n = 0;
+  for (; r->pending != 0 && n < max; ++n) {
+    uint32_t buf = r->queue[r->qHead];
+    r->qHead = (r->qHead + 1) % r->depth;
+    r->pending -= 1;
+    const uring_slot* slot = &r->slots[buf];
+    byte* dst = bufferOf(r, buf);
+    out[n].tag = slot->tag;
+    out[n].buf = buf;
+    io_error_clear(&out[n].err);
+    // keep reading until the request is filled or the file ends, as io_uring does for regular files
+    size_t got = 0;
+    while (got < slot->len) {
+      ssize_t res = pread(slot->fd, dst + got, slot->len - got, slot->offset + got);
+      if (res > 0) { got += res; continue; }
+      if (res == 0) { break; }
+      if (errno == EINTR) { continue; }
+      io_error_set(&out[n].err, IO_OP_READ, errno, slot->fd, slot->offset + got);
+      got = 0;
+      break;
+    }
+    out[n].data = larr_mk_byte(got, dst);
+  }
+  return n;
+}
+
+size_t uring_poll(uring_reader* r, uring_completion* out, size_t max, size_t wait, io_error* err) {
+  if (!uring_isAsync(r)) { return readQueued(r, out, max); }
+  size_t n = harvest(r, out, max);
+  if (wait > max) { wait = max; }
+  if (wait > r->pending + n) { wait = r->pending + n; }
+  size_t need = n < wait ? wait - n : 0;
+  while (r->unsent != 0 || need != 0) {
+    int res = ringEnter(r->ringFd, r->unsent, (unsigned)need, need != 0 ? IORING_ENTER_GETEVENTS : 0);
+    if (res < 0) {
+      if (errno == EINTR) { continue; }
+      // EAGAIN and EBUSY mean the kernel is short of resources for now: collect what there is, and let the caller retry
+      io_error_set(err, IO_OP_READ, errno, -1, -1);
+      break;
+    }
+    r->unsent -= (uint32_t)res;
+    size_t got = harvest(r, out + n, max - n);
+    n += got;
+    need = n < wait ? wait - n : 0;
+    if (res == 0 && got == 0 && need == 0) { break; }
+  }
+  return n;
+}
+
+void uring_release(uring_reader* r, uint32_t buf) {
+  assert(buf < r->depth && r->nFree < r->depth);
+  r->freeList[r->nFree++] = buf;
+}
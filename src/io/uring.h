@@ -0,0 +1,167 @@
+/// @file
+/// @brief Asynchronous file reader, over io_uring where the kernel allows it, and blocking reads otherwise.
+///
+/// One thread can keep many reads (across many files) in flight at once:
+///   it queues reads with {@link uring_submit}, which only fills in submission entries,
+///   and then {@link uring_poll} submits the whole batch and collects whatever has completed in a single system call.
+/// Completed reads arrive as byte slices viewing the reader's own buffers;
+///   each buffer is lent to the caller until it is given back with {@link uring_release}.
+///
+/// The buffers are carved from one page-aligned allocation, and registered with the kernel when it permits,
+///   so the kernel does not map and unmap them for every read.
+/// The number of buffers is the queue depth: a read can only be submitted while a buffer is free.
+///
+/// Where io_uring is unavailable (an old kernel, or forbidden by a sandbox), the reader falls back to `pread`:
+///   submissions are queued, and performed in order, blocking, by {@link uring_poll}.
+/// The interface is the same either way; {@link uring_isAsync} tells which is in use.
+///
+/// A reader is not thread-safe: the intended use is one reader per I/O thread.
+
+#ifndef CHIM_IO_URING
+#define CHIM_IO_URING
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/aligned.h"
+#include "chimtypes.h"
+#include "io/error.h"
+#include "slice/byte.h"
+
+/// @brief Most reads that one reader can have in flight.
+#define CHIM_URING_MAXDEPTH 4096
+
+
+/// @brief A read in progress, and the buffer lent to it.
+typedef struct uring_slot {
+  /// @brief the caller's identifier for the read
+  uint64_t tag;
+  /// @brief file offset to read from
+  int64_t offset;
+  /// @brief file to read from
+  int fd;
+  /// @brief bytes to read
+  uint32_t len;
+} uring_slot;
+
+/// @brief A finished read.
+typedef struct uring_completion {
+  /// @brief the identifier given to {@link uring_submit}
+  uint64_t tag;
+  /// @brief the bytes read, in the reader's buffer: shorter than requested only at end of file, and empty on error
+  larr_byte data;
+  /// @brief the buffer holding `data`, to pass to {@link uring_release} when done with it
+  uint32_t buf;
+  /// @brief why the read failed, or a clear error if it succeeded
+  io_error err;
+} uring_completion;
+
+/// @brief An asynchronous file reader.
+typedef struct uring_reader {
+  /// @brief io_uring file descriptor, or -1 when falling back to blocking reads
+  int ringFd;
+  /// @brief whether the buffers are registered with the kernel
+  bool fixed;
+  /// @brief number of buffers (and so most reads in flight)
+  uint32_t depth;
+  /// @brief size of each buffer, a multiple of the page size
+  size_t bufSize;
+  /// @brief `depth` buffers of `bufSize` bytes each, page-aligned
+  byte* bufs;
+  /// @brief the read using each buffer
+  uring_slot* slots;
+  /// @brief stack of unused buffers
+  uint32_t* freeList;
+  /// @brief number of unused buffers
+  uint32_t nFree;
+  /// @brief submitted reads not yet completed (in blocking mode, the queue of reads to perform, as a circular buffer)
+  uint32_t* queue;
+  /// @brief index of the first read in `queue` (blocking mode only)
+  uint32_t qHead;
+  /// @brief number of reads submitted but not yet returned by {@link uring_poll}
+  uint32_t pending;
+  /// @brief number of reads filled into the submission ring, but not yet passed to the kernel
+  uint32_t unsent;
+  /// @brief the mapped submission ring
+  void* sqMap;
+  /// @brief size of `sqMap`
+  size_t sqMapLen;
+  /// @brief the mapped completion ring (which may be `sqMap`)
+  void* cqMap;
+  /// @brief size of `cqMap`
+  size_t cqMapLen;
+  /// @brief the mapped submission entries
+  void* sqes;
+  /// @brief size of `sqes`
+  size_t sqesLen;
+  /// @brief shared ring indices and masks
+  uint32_t *sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+  /// @brief the completion entries
+  void* cqes;
+} uring_reader;
+
+/// @brief Create a reader.
+///
+/// If io_uring cannot be set up, this is not an error: the reader uses blocking reads instead.
+///
+/// @param mem: allocator for the buffers and bookkeeping
+/// @param r: the reader
+/// @param depth: number of buffers, and so most reads in flight (at most {@link CHIM_URING_MAXDEPTH})
+/// @param bufSize: most bytes in one read (rounded up to a multiple of the page size)
+/// @param tryAsync: false to use blocking reads even when io_uring is available
+/// @param err: where to record a failure, or `NULL`
+/// @return false if allocation fails
+bool uring_init(aligned_alloc_t mem, uring_reader* r, uint32_t depth, size_t bufSize, bool tryAsync, io_error* err);
+
+/// @brief Destroy a reader.
+///
+/// Reads still in flight are waited for first, as the kernel may still write to their buffers.
+///
+/// @param mem: the allocator given to {@link uring_init}
+/// @param r: the reader
+void uring_deinit(aligned_alloc_t mem, uring_reader* r);
+
+/// @brief Whether reads are asynchronous (through io_uring), rather than blocking.
+INLINE
+bool uring_isAsync(const uring_reader* r) {
+  return r->ringFd >= 0;
+}
+
+/// @brief Queue a read.
+///
+/// The read is not started until the next {@link uring_poll}, so that many reads can be submitted at once.
+///
+/// @param r: the reader
+/// @param fd: file to read from
+/// @param offset: file offset to read from
+/// @param len: number of bytes to read (at most the reader's buffer size)
+/// @param tag: an identifier for the read, returned with its completion
+/// @return false if every buffer is in use (so poll, and release some buffers, first)
+bool uring_submit(uring_reader* r, int fd, int64_t offset, size_t len, uint64_t tag);
+
+/// @brief Start queued reads, and collect finished ones.
+///
+/// Completions may arrive in any order (in blocking mode, they are in submission order).
+///
+/// @param r: the reader
+/// @param out: where to store completions
+/// @param max: most completions to store
+/// @param wait: how many completions to wait for (reduced to `max`, and to the number of reads pending);
+///   zero to only collect those already finished
+/// @param err: where to record why fewer than `wait` were returned, or `NULL`
+/// @return the number of completions stored
+size_t uring_poll(uring_reader* r, uring_completion* out, size_t max, size_t wait, io_error* err);
+
+/// @brief Give back a buffer, after a completion's data is no longer needed.
+///
+/// @param r: the reader
+/// @param buf: the buffer of the completion
+void uring_release(uring_reader* r, uint32_t buf);
+
+
+#endif
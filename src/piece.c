@@ -0,0 +1,315 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "piece.h"
+
+
+static inline
+size_t totalOf(const piece_node* node) {
+  return node == NULL ? 0 : node->total;
+}
+
+static inline
+piece_node* retain(piece_node* node) {
+  if (node != NULL) { node->refs += 1; }
+  return node;
+}
+
+static
+void release(alloc_t mem, piece_node* node) {
+  while (node != NULL && --node->refs == 0) {
+    release(mem, node->left);
+    piece_node* right = node->right;
+    freeIn(mem, node);
+    node = right;
+  }
+}
+
+// xorshift32: priorities only need to be well-spread, not unpredictable
+static
+uint32_t nextPrio(piecetab* pt) {
+  uint32_t x = pt->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  pt->seed = x;
+  return x;
+}
+
+// Create a node, taking ownership of the references to its children (which are released on failure).
+static
+piece_node* mk(alloc_t mem, uint32_t prio, bool added, size_t start, size_t len
+              , piece_node* left, piece_node* right) {
+  piece_node* node = allocIn(mem, sizeof(piece_node));
+  if (node == NULL) {
+    release(mem, left);
+    release(mem, right);
+    return NULL;
+  }
+  node->refs = 1;
+  node->prio = prio;
+  node->added = added;
+  node->start = start;
+  node->len = len;
+  node->total = totalOf(left) + len + totalOf(right);
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
+// Join two trees (all of `a` before all of `b`) into a new tree.
+// The input trees are not consumed.
+static
+bool merge(alloc_t mem, piece_node* a, piece_node* b, piece_node** out) {
+  if (a == NULL) {
+    *out = retain(b);
+    return true;
+  }
+  if (b == NULL) {
+    *out = retain(a);
+    return true;
+  }
+  piece_node* sub;
+  if (a->prio > b->prio) {
+    if (!merge(mem, a->right, b, &sub)) { return false; }
+    *out = mk(mem, a->prio, a->added, a->start, a->len, retain(a->left), sub);
+  }
+  else {
+    if (!merge(mem, a, b->left, &sub)) { return false; }
+    *out = mk(mem, b->prio, b->added, b->start, b->len, sub, retain(b->right));
+  }
+  return *out != NULL;
+}
+
+// Rebuild the piece of `node` between two trees, taking ownership of the references to them (which are released on failure).
+// A piece split off further down gets a fresh priority, which may outrank `node`: the trees are then merged, rather than hung below it.
+static
+piece_node* rejoin(alloc_t mem, const piece_node* node, piece_node* left, piece_node* right) {
+  if ((left == NULL || left->prio <= node->prio) && (right == NULL || right->prio <= node->prio)) {
+    return mk(mem, node->prio, node->added, node->start, node->len, left, right);
+  }
+  piece_node* mid = mk(mem, node->prio, node->added, node->start, node->len, NULL, NULL);
+  piece_node* lm = NULL;
+  piece_node* out = NULL;
+  if (mid != NULL && merge(mem, left, mid, &lm)) {
+    if (!merge(mem, lm, right, &out)) { out = NULL; }
+  }
+  release(mem, lm);
+  release(mem, mid);
+  release(mem, left);
+  release(mem, right);
+  return out;
+}
+
+// Split a tree into new trees holding the first `k` bytes and the rest.
+// The input tree is not consumed.
+static
+bool split(alloc_t mem, piecetab* pt, piece_node* node, size_t k, piece_node** l, piece_node** r) {
+  if (node == NULL || k == 0) {
+    *l = NULL;
+    *r = retain(node);
+    return true;
+  }
+  if (k >= node->total) {
+    *l = retain(node);
+    *r = NULL;
+    return true;
+  }
+  size_t leftLen = totalOf(node->left);
+  if (k <= leftLen) {
+    piece_node* a;
+    piece_node* b;
+    if (!split(mem, pt, node->left, k, &a, &b)) { return false; }
+    piece_node* n = rejoin(mem, node, b, retain(node->right));
+    if (n == NULL) {
+      release(mem, a);
+      return false;
+    }
+    *l = a;
+    *r = n;
+    return true;
+  }
+  if (k >= leftLen + node->len) {
+    piece_node* a;
+    piece_node* b;
+    if (!split(mem, pt, node->right, k - leftLen - node->len, &a, &b)) { return false; }
+    piece_node* n = rejoin(mem, node, retain(node->left), a);
+    if (n == NULL) {
+      release(mem, b);
+      return false;
+    }
+    *l = n;
+    *r = b;
+    return true;
+  }
+  // the split falls inside this node's piece, which becomes two pieces.
+  // The second gets a priority of its own: sharing the node's would make repeated edits of one piece chain its fragments
+  //   into a list, as merging breaks ties the same way every time.
+  size_t off = k - leftLen;
+  piece_node* a = mk(mem, node->prio, node->added, node->start, off, retain(node->left), NULL);
+  if (a == NULL) { return false; }
+  piece_node* b = mk(mem, nextPrio(pt), node->added, node->start + off, node->len - off, NULL, NULL);
+  if (b == NULL) {
+    release(mem, a);
+    return false;
+  }
+  bool ok = merge(mem, b, node->right, r);
+  release(mem, b);
+  if (!ok) {
+    release(mem, a);
+    return false;
+  }
+  *l = a;
+  return true;
+}
+
+static inline
+piece_node* currentRoot(const piecetab* pt) {
+  return pt->history.buf[pt->current];
+}
+
+// Make a new root (whose reference is consumed) the current version, discarding any redo history.
+static
+bool commit(alloc_t mem, piecetab* pt, piece_node* root) {
+  while (pt->history.len > pt->current + 1) {
+    release(mem, *dynarr_pop_any(&pt->history));
+  }
+  any elem = root;
+  if (!dynarr_push_any(mem, &pt->history, &elem)) {
+    release(mem, root);
+    return false;
+  }
+  pt->current += 1;
+  return true;
+}
+
+
+bool piecetab_init(alloc_t mem, piecetab* pt, larr_byte original) {
+  pt->original = original;
+  pt->seed = 0x9e3779b9u;
+  pt->current = 0;
+  if (!dynarr_init_byte(mem, &pt->added, 64)) { return false; }
+  if (!dynarr_init_any(mem, &pt->history, 16)) {
+    dynarr_deinit_byte(mem, &pt->added);
+    return false;
+  }
+  piece_node* root = NULL;
+  if (original.len != 0) {
+    root = mk(mem, nextPrio(pt), false, 0, original.len, NULL, NULL);
+    if (root == NULL) {
+      piecetab_deinit(mem, pt);
+      return false;
+    }
+  }
+  any elem = root;
+  dynarr_push_any(mem, &pt->history, &elem); // cannot fail: capacity is reserved
+  return true;
+}
+
+void piecetab_deinit(alloc_t mem, piecetab* pt) {
+  for (size_t i = 0; i < pt->history.len; ++i) {
+    release(mem, pt->history.buf[i]);
+  }
+  dynarr_deinit_any(mem, &pt->history);
+  dynarr_deinit_byte(mem, &pt->added);
+  pt->current = 0;
+}
+
+size_t piecetab_len(const piecetab* pt) {
+  return totalOf(currentRoot(pt));
+}
+
+larr_byte piecetab_chunkAt(const piecetab* pt, size_t pos) {
+  piece_node* node = currentRoot(pt);
+  if (pos >= totalOf(node)) { return larr_mk_byte(0, NULL); }
+  for (;;) {
+    size_t leftLen = totalOf(node->left);
+    if (pos < leftLen) {
+      node = node->left;
+    }
+    else if (pos < leftLen + node->len) {
+      size_t off = pos - leftLen;
+      byte* base = node->added ? pt->added.buf : pt->original.arr;
+      return larr_mk_byte(node->len - off, &base[node->start + off]);
+    }
+    else {
+      pos -= leftLen + node->len;
+      node = node->right;
+    }
+  }
+}
+
+bool piecetab_insert(alloc_t mem, piecetab* pt, size_t pos, larr_byte text) {
+  if (text.len == 0) { return true; }
+  size_t start = pt->added.len;
+  if (text.len > SIZE_MAX - start) { return false; }
+  if (start + text.len > pt->added.cap) {
+    size_t cap = pt->added.cap;
+    while (cap < start + text.len) {
+      cap = cap > SIZE_MAX / 2 ? start + text.len : 2 * cap;
+    }
+    if (!dynarr_resize_byte(mem, &pt->added, cap)) { return false; }
+  }
+  // the added buffer only grows, so text appended by a failed edit is harmless
+  memcpy(&pt->added.buf[start], text.arr, text.len);
+  pt->added.len += text.len;
+
+  piece_node* leaf = mk(mem, nextPrio(pt), true, start, text.len, NULL, NULL);
+  if (leaf == NULL) { return false; }
+  piece_node* l;
+  piece_node* r;
+  piece_node* lm;
+  piece_node* root;
+  if (!split(mem, pt, currentRoot(pt), pos, &l, &r)) {
+    release(mem, leaf);
+    return false;
+  }
+  bool ok = merge(mem, l, leaf, &lm);
+  release(mem, l);
+  release(mem, leaf);
+  if (!ok) {
+    release(mem, r);
+    return false;
+  }
+  ok = merge(mem, lm, r, &root);
+  release(mem, lm);
+  release(mem, r);
+  if (!ok) { return false; }
+  return commit(mem, pt, root);
+}
+
+bool piecetab_delete(alloc_t mem, piecetab* pt, size_t pos, size_t n) {
+  if (n == 0 || pos >= piecetab_len(pt)) { return true; }
+  piece_node* l;
+  piece_node* rest;
+  piece_node* mid;
+  piece_node* r;
+  piece_node* root;
+  if (!split(mem, pt, currentRoot(pt), pos, &l, &rest)) { return false; }
+  bool ok = split(mem, pt, rest, n, &mid, &r);
+  release(mem, rest);
+  if (!ok) {
+    release(mem, l);
+    return false;
+  }
+  release(mem, mid);
+  ok = merge(mem, l, r, &root);
+  release(mem, l);
+  release(mem, r);
+  if (!ok) { return false; }
+  return commit(mem, pt, root);
+}
+
+bool piecetab_undo(piecetab* pt) {
+  if (pt->current == 0) { return false; }
+  pt->current -= 1;
+  return true;
+}
+
+bool piecetab_redo(piecetab* pt) {
+  if (pt->current + 1 >= pt->history.len) { return false; }
+  pt->current += 1;
+  return true;
+}
@@ -0,0 +1,130 @@
+/// @file
+/// @brief Piece table: a text made of pieces of two buffers, for editing large documents with undo.
+///
+/// The original text is never copied or modified (so it may, for example, be a memory-mapped file),
+///   and inserted text is only ever appended to a separate buffer.
+/// The document is a sequence of pieces, each a range of one of those two buffers.
+///
+/// The pieces are kept in a balanced tree (a treap), where each node also records the total length of its subtree,
+///   so finding the piece at an offset, and splitting or joining the sequence, take `O(log n)` time in the number of pieces.
+/// Edits never modify nodes: each edit creates a new version sharing all but `O(log n)` nodes with the previous one.
+/// So undo and redo just switch between versions kept in a history list.
+///
+/// Nodes are reference-counted and are not synchronized: a piece table (with its history) belongs to one thread at a time.
+
+#ifndef CHIM_PIECE
+#define CHIM_PIECE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/boxed.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief A node of the tree of pieces; each node holds one piece.
+typedef struct piece_node {
+  /// @brief number of parents (nodes or history entries) referring to this node
+  size_t refs;
+  /// @brief treap priority: no greater than the parent's
+  uint32_t prio;
+  /// @brief whether the piece refers to the added buffer (rather than the original)
+  bool added;
+  /// @brief offset of the piece in its buffer
+  size_t start;
+  /// @brief length of the piece
+  size_t len;
+  /// @brief length of all pieces in this subtree
+  size_t total;
+  /// @brief pieces before this one
+  struct piece_node* left;
+  /// @brief pieces after this one
+  struct piece_node* right;
+} piece_node;
+
+/// @brief Editable text with undo history.
+typedef struct piecetab {
+  /// @brief the original text (borrowed; it must outlive the table)
+  larr_byte original;
+  /// @brief all text ever inserted, in order of insertion
+  dynarr_byte added;
+  /// @brief root of every version (`NULL` for an empty document), oldest first
+  dynarr_any history;
+  /// @brief index of the current version in the history
+  size_t current;
+  /// @brief state of the priority generator
+  uint32_t seed;
+} piecetab;
+
+/// @brief Initialize a piece table over an original text.
+///
+/// @param mem: allocator
+/// @param pt: the piece table
+/// @param original: the original text, which is not copied
+/// @return false if allocation fails
+bool piecetab_init(alloc_t mem, piecetab* pt, larr_byte original);
+
+/// @brief Free all versions and the added text.
+///
+/// The original text is not freed.
+///
+/// @param mem: allocator
+/// @param pt: the piece table
+void piecetab_deinit(alloc_t mem, piecetab* pt);
+
+/// @brief Get the length of the current version.
+///
+/// @param pt: the piece table
+/// @return length of the document, in bytes
+size_t piecetab_len(const piecetab* pt);
+
+/// @brief View the bytes from an offset up to the end of the piece that contains it.
+///
+/// This is the way to read the document: advance the offset by the length of each view.
+/// Views are invalidated by insertions (which may move the added text).
+///
+/// @param pt: the piece table
+/// @param pos: offset into the current version
+/// @return the bytes from `pos` to the end of its piece, or an empty slice if `pos` is not in-bounds
+larr_byte piecetab_chunkAt(const piecetab* pt, size_t pos);
+
+/// @brief Insert text, creating a new version.
+///
+/// Any versions that could have been redone are discarded.
+///
+/// @param mem: allocator
+/// @param pt: the piece table
+/// @param pos: offset at which to insert (clamped to the length of the document)
+/// @param text: the text to insert (which may not lie within the added text of this table)
+/// @return false if allocation fails (the current version is unchanged)
+bool piecetab_insert(alloc_t mem, piecetab* pt, size_t pos, larr_byte text);
+
+/// @brief Delete text, creating a new version.
+///
+/// Any versions that could have been redone are discarded.
+///
+/// @param mem: allocator
+/// @param pt: the piece table
+/// @param pos: offset of the first byte to delete
+/// @param n: number of bytes to delete (clamped to the end of the document)
+/// @return false if allocation fails (the current version is unchanged)
+bool piecetab_delete(alloc_t mem, piecetab* pt, size_t pos, size_t n);
+
+/// @brief Return to the previous version.
+///
+/// @param pt: the piece table
+/// @return false if there is no previous version
+bool piecetab_undo(piecetab* pt);
+
+/// @brief Return to the version that was most recently undone.
+///
+/// @param pt: the piece table
+/// @return false if there is no such version
+bool piecetab_redo(piecetab* pt);
+
+
+#endif
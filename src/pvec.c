@@ -0,0 +1,310 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pvec.h"
+
+#define MASK ((size_t)CHIM_PVEC_WIDTH - 1)
+
+// Edit ids are never reused, so once a transient ends, no later transient can update its nodes in place.
+// Zero is reserved for nodes that were never private to a transient.
+static atomic_uintptr_t nextEdit = 1;
+
+
+static inline
+size_t tailOffset(size_t len) {
+  return len < CHIM_PVEC_WIDTH ? 0 : ((len - 1) >> CHIM_PVEC_BITS) << CHIM_PVEC_BITS;
+}
+
+static inline
+void retain(pvec_node* node) {
+  if (node != NULL) {
+    atomic_fetch_add_explicit(&node->refs, 1, memory_order_relaxed);
+  }
+}
+
+// Drop a reference to a node at the given height above the leaves (in index bits).
+static
+void release(alloc_t mem, unsigned level, pvec_node* node) {
+  if (node == NULL) { return; }
+  if (atomic_fetch_sub_explicit(&node->refs, 1, memory_order_release) != 1) { return; }
+  atomic_thread_fence(memory_order_acquire);
+  if (level > 0) {
+    for (size_t i = 0; i < CHIM_PVEC_WIDTH; ++i) {
+      release(mem, level - CHIM_PVEC_BITS, node->kids[i]);
+    }
+  }
+  freeIn(mem, node);
+}
+
+static
+pvec_node* newNode(alloc_t mem, uintptr_t edit) {
+  pvec_node* node = allocIn(mem, sizeof(pvec_node));
+  if (node == NULL) { return NULL; }
+  atomic_init(&node->refs, 1);
+  node->edit = edit;
+  for (size_t i = 0; i < CHIM_PVEC_WIDTH; ++i) {
+    node->kids[i] = NULL;
+  }
+  return node;
+}
+
+// Make the node in `slot` private to the transient, copying it if needed.
+static
+bool editable(alloc_t mem, const pvec_transient* t, unsigned level, pvec_node** slot) {
+  pvec_node* old = *slot;
+  if (old->edit == t->edit) { return true; }
+  pvec_node* copy = newNode(mem, t->edit);
+  if (copy == NULL) { return false; }
+  memcpy(copy->kids, old->kids, sizeof(copy->kids));
+  if (level > 0) {
+    for (size_t i = 0; i < CHIM_PVEC_WIDTH; ++i) {
+      retain(copy->kids[i]);
+    }
+  }
+  release(mem, level, old);
+  *slot = copy;
+  return true;
+}
+
+// Build a chain of internal nodes from `level` down to (and including a new reference to) `leaf`.
+static
+pvec_node* newPath(alloc_t mem, uintptr_t edit, unsigned level, pvec_node* leaf) {
+  retain(leaf);
+  pvec_node* top = leaf;
+  for (unsigned l = CHIM_PVEC_BITS; l <= level; l += CHIM_PVEC_BITS) {
+    pvec_node* node = newNode(mem, edit);
+    if (node == NULL) {
+      release(mem, l - CHIM_PVEC_BITS, top);
+      return NULL;
+    }
+    node->kids[0] = top;
+    top = node;
+  }
+  return top;
+}
+
+// Insert a full leaf as the last leaf of the tree under `slot`.
+static
+bool pushTail(alloc_t mem, pvec_transient* t, unsigned level, pvec_node** slot, pvec_node* leaf) {
+  if (*slot == NULL) {
+    pvec_node* path = newPath(mem, t->edit, level, leaf);
+    if (path == NULL) { return false; }
+    *slot = path;
+    return true;
+  }
+  if (!editable(mem, t, level, slot)) { return false; }
+  pvec_node* node = *slot;
+  size_t sub = ((t->v.len - 1) >> level) & MASK;
+  if (level == CHIM_PVEC_BITS) {
+    retain(leaf);
+    node->kids[sub] = leaf;
+    return true;
+  }
+  return pushTail(mem, t, level - CHIM_PVEC_BITS, &node->kids[sub], leaf);
+}
+
+// Remove the last leaf of the tree under `slot`, leaving `NULL` if the subtree becomes empty.
+static
+bool popTail(alloc_t mem, pvec_transient* t, unsigned level, pvec_node** slot) {
+  size_t sub = ((t->v.len - 2) >> level) & MASK;
+  if (level > CHIM_PVEC_BITS) {
+    if (!editable(mem, t, level, slot)) { return false; }
+    pvec_node* node = *slot;
+    if (!popTail(mem, t, level - CHIM_PVEC_BITS, &node->kids[sub])) { return false; }
+    if (node->kids[sub] == NULL && sub == 0) {
+      release(mem, level, node);
+      *slot = NULL;
+    }
+    return true;
+  }
+  if (sub == 0) {
+    release(mem, level, *slot);
+    *slot = NULL;
+    return true;
+  }
+  if (!editable(mem, t, level, slot)) { return false; }
+  pvec_node* node = *slot;
+  release(mem, 0, node->kids[sub]);
+  node->kids[sub] = NULL;
+  return true;
+}
+
+// Find the leaf holding an in-bounds index.
+static
+pvec_node* leafFor(const pvec* v, size_t index) {
+  if (index >= tailOffset(v->len)) { return v->tail; }
+  pvec_node* node = v->root;
+  for (unsigned level = v->shift; level > 0; level -= CHIM_PVEC_BITS) {
+    node = node->kids[(index >> level) & MASK];
+  }
+  return node;
+}
+
+
+pvec pvec_empty(void) {
+  pvec out = { .len = 0, .shift = CHIM_PVEC_BITS, .root = NULL, .tail = NULL };
+  return out;
+}
+
+void pvec_deinit(alloc_t mem, pvec* v) {
+  release(mem, v->shift, v->root);
+  release(mem, 0, v->tail);
+  *v = pvec_empty();
+}
+
+pvec pvec_clone(const pvec* v) {
+  retain(v->root);
+  retain(v->tail);
+  return *v;
+}
+
+const any* pvec_addrof(const pvec* v, size_t index) {
+  if (index >= v->len) { return NULL; }
+  return &leafFor(v, index)->elems[index & MASK];
+}
+
+larr_any pvec_chunkAt(const pvec* v, size_t index) {
+  if (index >= v->len) { return larr_mk_any(0, NULL); }
+  size_t end = (index | MASK) + 1;
+  if (end > v->len) { end = v->len; }
+  return larr_mk_any(end - index, &leafFor(v, index)->elems[index & MASK]);
+}
+
+bool pvec_set(alloc_t mem, const pvec* v, size_t index, any elem, pvec* out) {
+  pvec_transient t;
+  pvec_transient_begin(v, &t);
+  if (!pvec_transient_set(mem, &t, index, elem)) {
+    pvec_deinit(mem, &t.v);
+    return false;
+  }
+  *out = pvec_transient_end(&t);
+  return true;
+}
+
+bool pvec_push(alloc_t mem, const pvec* v, any elem, pvec* out) {
+  pvec_transient t;
+  pvec_transient_begin(v, &t);
+  if (!pvec_transient_push(mem, &t, elem)) {
+    pvec_deinit(mem, &t.v);
+    return false;
+  }
+  *out = pvec_transient_end(&t);
+  return true;
+}
+
+bool pvec_pop(alloc_t mem, const pvec* v, pvec* out) {
+  pvec_transient t;
+  pvec_transient_begin(v, &t);
+  if (!pvec_transient_pop(mem, &t)) {
+    pvec_deinit(mem, &t.v);
+    return false;
+  }
+  *out = pvec_transient_end(&t);
+  return true;
+}
+
+void pvec_transient_begin(const pvec* v, pvec_transient* out) {
+  out->v = pvec_clone(v);
+  out->edit = atomic_fetch_add_explicit(&nextEdit, 1, memory_order_relaxed);
+}
+
+pvec pvec_transient_end(pvec_transient* t) {
+  t->edit = 0;
+  return t->v;
+}
+
+bool pvec_transient_set(alloc_t mem, pvec_transient* t, size_t index, any elem) {
+  assert(index < t->v.len);
+  if (index >= tailOffset(t->v.len)) {
+    if (!editable(mem, t, 0, &t->v.tail)) { return false; }
+    t->v.tail->elems[index & MASK] = elem;
+    return true;
+  }
+  pvec_node** slot = &t->v.root;
+  for (unsigned level = t->v.shift; ; level -= CHIM_PVEC_BITS) {
+    if (!editable(mem, t, level, slot)) { return false; }
+    if (level == 0) { break; }
+    slot = &(*slot)->kids[(index >> level) & MASK];
+  }
+  (*slot)->elems[index & MASK] = elem;
+  return true;
+}
+
+bool pvec_transient_push(alloc_t mem, pvec_transient* t, any elem) {
+  pvec* v = &t->v;
+  size_t inTail = v->len - tailOffset(v->len);
+  if (v->tail == NULL) {
+    v->tail = newNode(mem, t->edit);
+    if (v->tail == NULL) { return false; }
+  }
+  else if (inTail < CHIM_PVEC_WIDTH) {
+    if (!editable(mem, t, 0, &v->tail)) { return false; }
+  }
+  else {
+    // the tail is full: it moves into the tree, and a fresh tail takes the new element
+    pvec_node* tail = newNode(mem, t->edit);
+    if (tail == NULL) { return false; }
+    if ((v->len >> CHIM_PVEC_BITS) > ((size_t)1 << v->shift)) {
+      // the tree is full, so it grows a new root
+      pvec_node* root = newNode(mem, t->edit);
+      pvec_node* path = newPath(mem, t->edit, v->shift, v->tail);
+      if (root == NULL || path == NULL) {
+        release(mem, v->shift + CHIM_PVEC_BITS, root);
+        release(mem, v->shift, path);
+        release(mem, 0, tail);
+        return false;
+      }
+      root->kids[0] = v->root;
+      root->kids[1] = path;
+      v->root = root;
+      v->shift += CHIM_PVEC_BITS;
+    }
+    else if (!pushTail(mem, t, v->shift, &v->root, v->tail)) {
+      release(mem, 0, tail);
+      return false;
+    }
+    release(mem, 0, v->tail);
+    v->tail = tail;
+    inTail = 0;
+  }
+  v->tail->elems[inTail] = elem;
+  v->len += 1;
+  return true;
+}
+
+bool pvec_transient_pop(alloc_t mem, pvec_transient* t) {
+  pvec* v = &t->v;
+  if (v->len == 0) { return false; }
+  if (v->len == 1) {
+    release(mem, 0, v->tail);
+    *v = pvec_empty();
+    return true;
+  }
+  if (v->len - tailOffset(v->len) > 1) {
+    // elements past the length are simply ignored, so the tail need not be copied
+    v->len -= 1;
+    return true;
+  }
+  // the tail is about to be empty, so the last leaf of the tree becomes the tail
+  pvec_node* tail = leafFor(v, v->len - 2);
+  retain(tail);
+  if (!popTail(mem, t, v->shift, &v->root)) {
+    release(mem, 0, tail);
+    return false;
+  }
+  if (v->shift > CHIM_PVEC_BITS && v->root->kids[1] == NULL) {
+    pvec_node* root = v->root->kids[0];
+    retain(root);
+    release(mem, v->shift, v->root);
+    v->root = root;
+    v->shift -= CHIM_PVEC_BITS;
+  }
+  release(mem, 0, v->tail);
+  v->tail = tail;
+  v->len -= 1;
+  return true;
+}
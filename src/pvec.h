@@ -0,0 +1,185 @@
+/// @file
+/// @brief Persistent (immutable) vectors of boxed elements, with structural sharing.
+///
+/// A persistent vector is never modified: "updating" one creates a new version,
+///   which shares all but `O(log32 n)` nodes with the old one.
+/// Both versions stay valid, and cost only the nodes in which they differ.
+///
+/// Elements are stored in a radix-balanced tree of 32-way nodes.
+/// The last (up to) 32 elements live in a separate tail node, outside the tree,
+///   so that appending usually copies just the tail, and only every 32nd append touches the tree.
+/// Elements are `any`, and are not owned by the vector (their lifetime is the caller's business, e.g. a garbage collector's).
+///
+/// Nodes are reference-counted and allocated through an {@link alloc_t}, which must be the same for all versions sharing nodes.
+/// Each version owns its references, so every version must eventually be released with {@link pvec_deinit}.
+///
+/// When building a vector from many updates, use a transient (see {@link pvec_transient_begin}):
+///   nodes created by a transient are updated in place until the transient is made persistent again,
+///   so a batch of updates avoids copying the same path over and over.
+///
+/// Unlike RRB-trees, this tree stays strictly radix-balanced, so concatenation and slicing are not supported.
+
+#ifndef CHIM_PVEC
+#define CHIM_PVEC
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "chimtypes.h"
+#include "slice/boxed.h"
+
+/// @brief Number of index bits consumed by each level of the tree.
+#define CHIM_PVEC_BITS 5
+/// @brief Number of children (or elements) in each node.
+#define CHIM_PVEC_WIDTH (1 << CHIM_PVEC_BITS)
+
+
+/// @brief A node of a persistent vector: internal nodes hold children, leaves hold elements.
+typedef struct pvec_node {
+  /// @brief number of parents (nodes or versions) referring to this node
+  atomic_size_t refs;
+  /// @brief the transient that may update this node in place, or zero
+  uintptr_t edit;
+  union {
+    /// @brief children of an internal node
+    struct pvec_node* kids[CHIM_PVEC_WIDTH];
+    /// @brief elements of a leaf
+    any elems[CHIM_PVEC_WIDTH];
+  };
+} pvec_node;
+
+/// @brief One version of a persistent vector.
+typedef struct pvec {
+  /// @brief number of elements
+  size_t len;
+  /// @brief index bits below the root (a multiple of {@link CHIM_PVEC_BITS}, at least one level)
+  unsigned shift;
+  /// @brief root of the tree, or `NULL` when all elements are in the tail
+  pvec_node* root;
+  /// @brief leaf holding the last elements, or `NULL` when empty
+  pvec_node* tail;
+} pvec;
+
+/// @brief A vector being updated in place.
+///
+/// @warning Transients must not be shared between threads, and must not be cloned.
+typedef struct pvec_transient {
+  /// @brief the current contents
+  pvec v;
+  /// @brief identifies nodes created by (and so private to) this transient
+  uintptr_t edit;
+} pvec_transient;
+
+/// @brief Create an empty vector.
+///
+/// Empty vectors own no nodes, so releasing one is optional.
+///
+/// @return a vector with no elements
+pvec pvec_empty(void);
+
+/// @brief Release a version's references to its nodes.
+///
+/// Nodes no longer shared with any other version are freed.
+///
+/// @param mem: allocator
+/// @param v: the version
+void pvec_deinit(alloc_t mem, pvec* v);
+
+/// @brief Create another reference to the same version, in constant time.
+///
+/// @param v: the version
+/// @return the same version, which must also be released
+pvec pvec_clone(const pvec* v);
+
+/// @brief get the address corresponding to an index
+///
+/// As with {@link _larr_addrof}, this performs bounds-checking.
+///
+/// @param v: the version
+/// @param index: the index of the element
+/// @return the address of the `index`th element, or `NULL` if `index` is not in-bounds
+const any* pvec_addrof(const pvec* v, size_t index);
+
+/// @brief View the (up to 32) contiguous elements around an index.
+///
+/// This is the fast way to iterate: advance the index by the length of each chunk.
+///
+/// @param v: the version
+/// @param index: the index of the first element of the view
+/// @return the elements from `index` up to the end of its leaf, or an empty slice if `index` is not in-bounds
+larr_any pvec_chunkAt(const pvec* v, size_t index);
+
+/// @brief Create a version with one element replaced.
+///
+/// @param mem: allocator
+/// @param v: the original version, which is left unchanged
+/// @param index: the index of the element to replace (must be in-bounds)
+/// @param elem: the new element
+/// @param out: the new version
+/// @return false if allocation fails (`out` is not modified)
+bool pvec_set(alloc_t mem, const pvec* v, size_t index, any elem, pvec* out);
+
+/// @brief Create a version with an element appended.
+///
+/// @param mem: allocator
+/// @param v: the original version, which is left unchanged
+/// @param elem: the new element
+/// @param out: the new version
+/// @return false if allocation fails (`out` is not modified)
+bool pvec_push(alloc_t mem, const pvec* v, any elem, pvec* out);
+
+/// @brief Create a version with the last element removed.
+///
+/// @param mem: allocator
+/// @param v: the original version, which is left unchanged
+/// @param out: the new version
+/// @return false if `v` is empty or allocation fails (`out` is not modified)
+bool pvec_pop(alloc_t mem, const pvec* v, pvec* out);
+
+/// @brief Start a batch of in-place updates.
+///
+/// The original version is left unchanged; the transient takes its own references.
+///
+/// @param v: the version to start from
+/// @param out: the transient
+void pvec_transient_begin(const pvec* v, pvec_transient* out);
+
+/// @brief Finish a batch of in-place updates.
+///
+/// The transient must not be used afterwards.
+///
+/// @param t: the transient
+/// @return a version with the updated contents
+pvec pvec_transient_end(pvec_transient* t);
+
+/// @brief Replace an element in place.
+///
+/// On failure, the contents of the transient are unchanged (though some of its nodes may have been copied).
+///
+/// @param mem: allocator
+/// @param t: the transient
+/// @param index: the index of the element to replace (must be in-bounds)
+/// @param elem: the new element
+/// @return false if allocation fails
+bool pvec_transient_set(alloc_t mem, pvec_transient* t, size_t index, any elem);
+
+/// @brief Append an element in place.
+///
+/// @param mem: allocator
+/// @param t: the transient
+/// @param elem: the new element
+/// @return false if allocation fails (the contents of the transient are unchanged)
+bool pvec_transient_push(alloc_t mem, pvec_transient* t, any elem);
+
+/// @brief Remove the last element in place.
+///
+/// @param mem: allocator
+/// @param t: the transient
+/// @return false if the transient is empty or allocation fails (the contents of the transient are unchanged)
+bool pvec_transient_pop(alloc_t mem, pvec_transient* t);
+
+
+#endif
@@ -0,0 +1,134 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/unaligned.h"
+#include "buffer/boxed.h"
+
+#undef INLINE
+#define INLINE
+#include "epoch.h"
+
+
+static
+void freeLimbo(ebr_domain* dom, dynarr_any* limbo) {
+  for (size_t i = 0; i < limbo->len; ++i) {
+    freeIn(dom->mem, limbo->buf[i]);
+  }
+  limbo->len = 0;
+}
+
+// Free every limbo list filled at least two epochs before `epoch`.
+static
+void reclaim(ebr_thread* self, uintptr_t epoch) {
+  for (int i = 0; i < 3; ++i) {
+    if (self->limbo[i].len != 0 && self->limboEpoch[i] + 2 <= epoch) {
+      freeLimbo(self->domain, &self->limbo[i]);
+    }
+  }
+  self->seen = epoch;
+}
+
+// Advance the global epoch if every thread in a critical section has announced it.
+// Returns the global epoch as it is known after the attempt.
+static
+uintptr_t tryAdvance(ebr_domain* dom) {
+  uintptr_t epoch = atomic_load_explicit(&dom->epoch, memory_order_seq_cst);
+  atomic_thread_fence(memory_order_seq_cst);
+  ebr_thread* t = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  for (; t != NULL; t = t->next) {
+    uintptr_t announce = atomic_load_explicit(&t->announce, memory_order_relaxed);
+    if ((announce & 1) != 0 && (announce >> 1) != epoch) { return epoch; }
+  }
+  atomic_thread_fence(memory_order_acquire);
+  // if this fails, someone else advanced the epoch, which is just as good
+  if (atomic_compare_exchange_strong(&dom->epoch, &epoch, epoch + 1)) {
+    return epoch + 1;
+  }
+  return epoch;
+}
+
+
+void ebr_init(ebr_domain* dom, alloc_t mem) {
+  atomic_init(&dom->epoch, 0);
+  atomic_init(&dom->threads, NULL);
+  dom->mem = mem;
+}
+
+void ebr_deinit(ebr_domain* dom) {
+  ebr_thread* t = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  while (t != NULL) {
+    ebr_thread* next = t->next;
+    for (int i = 0; i < 3; ++i) {
+      freeLimbo(dom, &t->limbo[i]);
+      dynarr_deinit_any(dom->mem, &t->limbo[i]);
+    }
+    freeIn(dom->mem, t);
+    t = next;
+  }
+  atomic_store(&dom->threads, NULL);
+}
+
+ebr_thread* ebr_register(ebr_domain* dom) {
+  ebr_thread* head = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  for (ebr_thread* t = head; t != NULL; t = t->next) {
+    bool expected = false;
+    if (!atomic_load_explicit(&t->claimed, memory_order_relaxed)
+        && atomic_compare_exchange_strong(&t->claimed, &expected, true)) {
+      return t;
+    }
+  }
+
+  ebr_thread* self = allocIn(dom->mem, sizeof(ebr_thread));
+  if (self == NULL) { return NULL; }
+  for (int i = 0; i < 3; ++i) {
+    if (!dynarr_init_any(dom->mem, &self->limbo[i], CHIM_EBR_BATCH)) {
+      while (i-- > 0) { dynarr_deinit_any(dom->mem, &self->limbo[i]); }
+      freeIn(dom->mem, self);
+      return NULL;
+    }
+    self->limboEpoch[i] = 0;
+  }
+  atomic_init(&self->announce, 0);
+  atomic_init(&self->claimed, true);
+  self->domain = dom;
+  self->seen = atomic_load(&dom->epoch);
+  self->pending = 0;
+
+  do {
+    self->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&dom->threads, &head, self
+                                                 , memory_order_release, memory_order_relaxed));
+  return self;
+}
+
+void ebr_unregister(ebr_thread* self) {
+  atomic_store_explicit(&self->announce, 0, memory_order_release);
+  atomic_store_explicit(&self->claimed, false, memory_order_release);
+}
+
+bool ebr_retire(ebr_thread* self, void* ptr) {
+  ebr_domain* dom = self->domain;
+  uintptr_t epoch = atomic_load(&dom->epoch);
+  if (epoch != self->seen) { reclaim(self, epoch); }
+  // after reclaiming, this list is either empty or was filled in this same epoch
+  size_t i = epoch % 3;
+  assert(self->limbo[i].len == 0 || self->limboEpoch[i] == epoch);
+  any elem = ptr;
+  if (!dynarr_push_any(dom->mem, &self->limbo[i], &elem)) { return false; }
+  self->limboEpoch[i] = epoch;
+  if (++self->pending >= CHIM_EBR_BATCH) {
+    self->pending = 0;
+    reclaim(self, tryAdvance(dom));
+  }
+  return true;
+}
+
+void ebr_collect(ebr_thread* self) {
+  self->pending = 0;
+  reclaim(self, tryAdvance(self->domain));
+}
@@ -0,0 +1,148 @@
+/// @file
+/// @brief Epoch-based reclamation of memory shared between threads.
+///
+/// Lock-free structures cannot free a node as soon as it is unlinked, because another thread may still be reading it.
+/// Instead, the node is _retired_, and freed once every thread that could have seen it has moved on.
+///
+/// Time is divided into epochs, counted by a global counter in the {@link ebr_domain}.
+/// A thread announces the epoch it observed when it enters a critical section (see {@link ebr_enter}),
+///   and clears the announcement when it leaves (see {@link ebr_exit}).
+/// The global epoch can only advance once every thread inside a critical section has announced the current epoch.
+/// Thus, anything retired in epoch `e` is unreachable by the time the global epoch reaches `e + 2`.
+///
+/// Retired pointers wait in per-thread limbo lists (one per epoch, modulo three), and are freed in batches through the domain's allocator.
+/// Entering and exiting a critical section costs a store to the thread's own record (plus a fence on entry);
+///   all the scanning is done by threads that retire memory.
+///
+/// @warning A thread that stalls inside a critical section stops the epoch from advancing, so garbage builds up without bound.
+///   When that is unacceptable, see {@link reclaim/hazard.h}.
+
+#ifndef CHIM_RECLAIM_EPOCH
+#define CHIM_RECLAIM_EPOCH
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alignment.h"
+#include "alloc/unaligned.h"
+#include "buffer/boxed.h"
+
+/// @brief Number of retirements a thread makes between attempts to advance the global epoch.
+#define CHIM_EBR_BATCH 64
+
+typedef struct ebr_domain ebr_domain;
+
+/// @brief Per-thread participation record.
+///
+/// Each thread that reads or retires shared memory in a domain must own one of these (see {@link ebr_register}).
+/// Records are never freed until the domain is, so other threads may scan them at any time.
+typedef struct ebr_thread {
+  /// @brief the announced epoch, shifted left by one; the low bit is set while inside a critical section
+  _Atomic uintptr_t announce;
+  char _pad[CHIM_CACHELINE - sizeof(uintptr_t)];
+  /// @brief next record in the domain (immutable once published)
+  struct ebr_thread* next;
+  /// @brief whether some thread currently owns this record
+  atomic_bool claimed;
+  /// @brief the domain this record belongs to
+  ebr_domain* domain;
+  /// @brief the global epoch as last observed by the owner when retiring
+  uintptr_t seen;
+  /// @brief retirements since the last attempt to advance the epoch
+  size_t pending;
+  /// @brief the epoch in which each limbo list was filled
+  uintptr_t limboEpoch[3];
+  /// @brief retired pointers, indexed by epoch modulo three
+  dynarr_any limbo[3];
+} ebr_thread;
+
+/// @brief A set of threads sharing one global epoch.
+///
+/// All memory retired into a domain must have been allocated by the domain's allocator.
+struct ebr_domain {
+  /// @brief the global epoch
+  _Atomic uintptr_t epoch;
+  char _pad[CHIM_CACHELINE - sizeof(uintptr_t)];
+  /// @brief every record ever registered, most recent first
+  _Atomic(ebr_thread*) threads;
+  /// @brief allocator for retired memory, participation records, and limbo lists
+  alloc_t mem;
+};
+
+/// @brief Initialize an empty domain.
+///
+/// @param dom: the domain
+/// @param mem: allocator used to free retired memory (and to allocate the domain's own bookkeeping)
+void ebr_init(ebr_domain* dom, alloc_t mem);
+
+/// @brief Free all retired memory and participation records.
+///
+/// @warning No thread may be using the domain (or any of its records) when this is called.
+///
+/// @param dom: the domain
+void ebr_deinit(ebr_domain* dom);
+
+/// @brief Obtain a participation record for the calling thread.
+///
+/// Records released by {@link ebr_unregister} are reused before new ones are allocated.
+///
+/// @param dom: the domain
+/// @return a record owned by the caller, or `NULL` if allocation fails
+ebr_thread* ebr_register(ebr_domain* dom);
+
+/// @brief Give up ownership of a participation record.
+///
+/// Memory still waiting in the record's limbo lists is inherited by the next thread to register.
+///
+/// @param self: a record owned by the caller, which must not be inside a critical section
+void ebr_unregister(ebr_thread* self);
+
+/// @brief Begin a critical section.
+///
+/// Between this and {@link ebr_exit}, no memory retired into the domain by any thread after this call will be freed.
+/// Critical sections do not nest.
+///
+/// @param self: a record owned by the caller
+INLINE
+void ebr_enter(ebr_thread* self) {
+  uintptr_t epoch = atomic_load_explicit(&self->domain->epoch, memory_order_relaxed);
+  atomic_store_explicit(&self->announce, (epoch << 1) | 1, memory_order_relaxed);
+  // order the announcement before any loads of shared pointers in the critical section
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+/// @brief End a critical section.
+///
+/// After this, the caller may not use any pointers to shared memory it loaded during the critical section.
+///
+/// @param self: a record owned by the caller
+INLINE
+void ebr_exit(ebr_thread* self) {
+  atomic_store_explicit(&self->announce, 0, memory_order_release);
+}
+
+/// @brief Schedule memory to be freed once no thread can be reading it.
+///
+/// The memory must already be unreachable for threads that enter a critical section from now on.
+/// This never blocks; occasionally it will attempt to advance the global epoch, and free memory retired two epochs ago.
+///
+/// @param self: a record owned by the caller
+/// @param ptr: memory allocated by the domain's allocator
+/// @return false if the limbo list could not grow (in which case the caller still owns `ptr`)
+bool ebr_retire(ebr_thread* self, void* ptr);
+
+/// @brief Attempt to advance the global epoch, then free whatever the caller's record can.
+///
+/// Useful at quiescent points (e.g. between batches of work), since otherwise memory is only freed while retiring more.
+///
+/// @param self: a record owned by the caller
+void ebr_collect(ebr_thread* self);
+
+
+#endif
@@ -0,0 +1,134 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/tags.h"
+#include "alloc/unaligned.h"
+#include "buffer/boxed.h"
+
+#undef INLINE
+#define INLINE
+#include "hazard.h"
+
+
+static
+int compareAddress(const void* a, const void* b) {
+  uintptr_t x = (uintptr_t)*(const any*)a;
+  uintptr_t y = (uintptr_t)*(const any*)b;
+  return (x > y) - (x < y);
+}
+
+static
+size_t scanThreshold(hp_domain* dom) {
+  return CHIM_HP_BATCH + 2 * CHIM_HP_SLOTS * atomic_load_explicit(&dom->count, memory_order_relaxed);
+}
+
+
+void hp_init(hp_domain* dom, alloc_t mem) {
+  atomic_init(&dom->threads, NULL);
+  atomic_init(&dom->count, 0);
+  dom->mem = mem;
+}
+
+void hp_deinit(hp_domain* dom) {
+  hp_thread* t = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  while (t != NULL) {
+    hp_thread* next = t->next;
+    for (size_t i = 0; i < t->retired.len; ++i) {
+      freeIn(dom->mem, t->retired.buf[i]);
+    }
+    dynarr_deinit_any(dom->mem, &t->retired);
+    dynarr_deinit_any(dom->mem, &t->snapshot);
+    freeIn(dom->mem, t);
+    t = next;
+  }
+  atomic_store(&dom->threads, NULL);
+  atomic_store(&dom->count, 0);
+}
+
+hp_thread* hp_register(hp_domain* dom) {
+  hp_thread* head = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  for (hp_thread* t = head; t != NULL; t = t->next) {
+    bool expected = false;
+    if (!atomic_load_explicit(&t->claimed, memory_order_relaxed)
+        && atomic_compare_exchange_strong(&t->claimed, &expected, true)) {
+      return t;
+    }
+  }
+
+  hp_thread* self = allocIn(dom->mem, sizeof(hp_thread));
+  if (self == NULL) { return NULL; }
+  if (!dynarr_init_any(dom->mem, &self->retired, CHIM_HP_BATCH)) {
+    freeIn(dom->mem, self);
+    return NULL;
+  }
+  if (!dynarr_init_any(dom->mem, &self->snapshot, CHIM_HP_BATCH)) {
+    dynarr_deinit_any(dom->mem, &self->retired);
+    freeIn(dom->mem, self);
+    return NULL;
+  }
+  for (size_t i = 0; i < CHIM_HP_SLOTS; ++i) {
+    atomic_init(&self->slots[i], NULL);
+  }
+  atomic_init(&self->claimed, true);
+  self->domain = dom;
+
+  do {
+    self->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&dom->threads, &head, self
+                                                 , memory_order_release, memory_order_relaxed));
+  atomic_fetch_add_explicit(&dom->count, 1, memory_order_relaxed);
+  return self;
+}
+
+void hp_unregister(hp_thread* self) {
+  for (size_t i = 0; i < CHIM_HP_SLOTS; ++i) {
+    atomic_store_explicit(&self->slots[i], NULL, memory_order_release);
+  }
+  hp_scan(self);
+  atomic_store_explicit(&self->claimed, false, memory_order_release);
+}
+
+bool hp_retire(hp_thread* self, void* ptr) {
+  any elem = ptr;
+  if (!dynarr_push_any(self->domain->mem, &self->retired, &elem)) { return false; }
+  if (self->retired.len >= scanThreshold(self->domain)) {
+    hp_scan(self);
+  }
+  return true;
+}
+
+bool hp_scan(hp_thread* self) {
+  hp_domain* dom = self->domain;
+  dynarr_any* snapshot = &self->snapshot;
+  snapshot->len = 0;
+  // order the unlinking of retired pointers before reading the hazards
+  atomic_thread_fence(memory_order_seq_cst);
+  hp_thread* t = atomic_load_explicit(&dom->threads, memory_order_acquire);
+  for (; t != NULL; t = t->next) {
+    for (size_t i = 0; i < CHIM_HP_SLOTS; ++i) {
+      any hazard = atomic_load_explicit(&t->slots[i], memory_order_acquire);
+      if (hazard == NULL) { continue; }
+      if (!dynarr_push_any(dom->mem, snapshot, &hazard)) { return false; }
+    }
+  }
+  qsort(snapshot->buf, snapshot->len, sizeof(any), compareAddress);
+
+  // keep the protected pointers, compacting them at the front of the retire list
+  size_t kept = 0;
+  for (size_t i = 0; i < self->retired.len; ++i) {
+    any ptr = self->retired.buf[i];
+    if (bsearch(&ptr, snapshot->buf, snapshot->len, sizeof(any), compareAddress) != NULL) {
+      self->retired.buf[kept++] = ptr;
+    }
+    else {
+      freeIn(dom->mem, ptr);
+    }
+  }
+  self->retired.len = kept;
+  return true;
+}
@@ -0,0 +1,192 @@
+/// @file
+/// @brief Hazard-pointer reclamation of memory shared between threads.
+///
+/// Before dereferencing a shared pointer, a reader publishes it in one of its hazard slots
+///   (see {@link hp_protect}).
+/// A retired pointer is only freed once it appears in no thread's hazard slots.
+///
+/// Unlike {@link reclaim/epoch.h}, a stalled reader only keeps alive the (few) nodes it has published,
+///   so the amount of unreclaimed memory stays bounded even when threads are descheduled.
+/// The price is paid by readers: each protected load is a store, a full fence, and a re-load.
+///
+/// Retired pointers accumulate in a per-thread list.
+/// Once the list is long enough (proportional to the total number of hazard slots),
+///   the retiring thread takes a sorted snapshot of all hazard slots and frees every retired pointer not found in it.
+///
+/// Pointers may carry tag bits (see {@link alloc/tags.h}); hazards are always published and compared untagged.
+
+#ifndef CHIM_RECLAIM_HAZARD
+#define CHIM_RECLAIM_HAZARD
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alignment.h"
+#include "alloc/tags.h"
+#include "alloc/unaligned.h"
+#include "buffer/boxed.h"
+
+/// @brief Number of hazard slots each thread owns.
+#define CHIM_HP_SLOTS 4
+
+/// @brief Minimum number of retired pointers a thread accumulates before scanning.
+///
+/// The actual threshold also grows with the number of hazard slots in the domain,
+///   so that each scan frees at least half of what was retired.
+#define CHIM_HP_BATCH 64
+
+typedef struct hp_domain hp_domain;
+
+/// @brief Per-thread participation record.
+///
+/// Records are never freed until the domain is, so other threads may scan them at any time.
+typedef struct hp_thread {
+  /// @brief published hazards (untagged), `NULL` when unused
+  _Atomic(void*) slots[CHIM_HP_SLOTS];
+  char _pad[CHIM_CACHELINE - CHIM_HP_SLOTS * sizeof(void*)];
+  /// @brief next record in the domain (immutable once published)
+  struct hp_thread* next;
+  /// @brief whether some thread currently owns this record
+  atomic_bool claimed;
+  /// @brief the domain this record belongs to
+  hp_domain* domain;
+  /// @brief pointers retired by the owner and not yet freed
+  dynarr_any retired;
+  /// @brief scratch space for the sorted snapshot of hazards
+  dynarr_any snapshot;
+} hp_thread;
+
+/// @brief A set of threads sharing hazard slots.
+///
+/// All memory retired into a domain must have been allocated by the domain's allocator.
+struct hp_domain {
+  /// @brief every record ever registered, most recent first
+  _Atomic(hp_thread*) threads;
+  /// @brief number of records in `threads`
+  atomic_size_t count;
+  /// @brief allocator for retired memory, participation records, and retire lists
+  alloc_t mem;
+};
+
+/// @brief Initialize an empty domain.
+///
+/// @param dom: the domain
+/// @param mem: allocator used to free retired memory (and to allocate the domain's own bookkeeping)
+void hp_init(hp_domain* dom, alloc_t mem);
+
+/// @brief Free all retired memory and participation records.
+///
+/// @warning No thread may be using the domain (or any of its records) when this is called.
+///
+/// @param dom: the domain
+void hp_deinit(hp_domain* dom);
+
+/// @brief Obtain a participation record for the calling thread.
+///
+/// Records released by {@link hp_unregister} are reused before new ones are allocated.
+///
+/// @param dom: the domain
+/// @return a record owned by the caller, with all slots clear, or `NULL` if allocation fails
+hp_thread* hp_register(hp_domain* dom);
+
+/// @brief Clear all hazards and give up ownership of a participation record.
+///
+/// Retired memory that is still protected by other threads is inherited by the next thread to register.
+///
+/// @param self: a record owned by the caller
+void hp_unregister(hp_thread* self);
+
+/// @brief Load a shared pointer and protect it from reclamation.
+///
+/// The pointer is re-loaded until the published hazard is known to match the shared location,
+///   so the result stays valid until the slot is cleared or reused.
+///
+/// @param self: a record owned by the caller
+/// @param slot: index of the hazard slot to use (less than {@link CHIM_HP_SLOTS})
+/// @param src: the shared location to load from
+/// @return the protected pointer (which may be `NULL`)
+INLINE
+void* hp_protect(hp_thread* self, size_t slot, _Atomic(void*)* src) {
+  assert(slot < CHIM_HP_SLOTS);
+  void* ptr = atomic_load_explicit(src, memory_order_relaxed);
+  for (;;) {
+    atomic_store_explicit(&self->slots[slot], ptr, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    void* again = atomic_load_explicit(src, memory_order_acquire);
+    if (again == ptr) { return ptr; }
+    ptr = again;
+  }
+}
+
+/// @brief Load a shared tagged pointer and protect its referent from reclamation.
+///
+/// Exactly as {@link hp_protect}, except that the tag bits are stripped before publishing the hazard.
+/// The tags must also match when re-loading, so the caller sees a consistent pointer/tag pair.
+///
+/// @param self: a record owned by the caller
+/// @param slot: index of the hazard slot to use (less than {@link CHIM_HP_SLOTS})
+/// @param src: the shared location to load from
+/// @return the protected pointer, with its tag
+INLINE
+tagged_ptr hp_protectTagged(hp_thread* self, size_t slot, _Atomic(tagged_ptr)* src) {
+  assert(slot < CHIM_HP_SLOTS);
+  tagged_ptr ptr = atomic_load_explicit(src, memory_order_relaxed);
+  for (;;) {
+    atomic_store_explicit(&self->slots[slot], unTag(ptr), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    tagged_ptr again = atomic_load_explicit(src, memory_order_acquire);
+    if (again.u == ptr.u) { return ptr; }
+    ptr = again;
+  }
+}
+
+/// @brief Publish a hazard without validating it.
+///
+/// The caller is responsible for checking, after this call, that `ptr` has not been retired
+///   (e.g. by re-reading the location it came from).
+///
+/// @param self: a record owned by the caller
+/// @param slot: index of the hazard slot to use (less than {@link CHIM_HP_SLOTS})
+/// @param ptr: the (untagged) pointer to protect
+INLINE
+void hp_set(hp_thread* self, size_t slot, void* ptr) {
+  assert(slot < CHIM_HP_SLOTS);
+  atomic_store_explicit(&self->slots[slot], ptr, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+}
+
+/// @brief Stop protecting the pointer in a hazard slot.
+///
+/// @param self: a record owned by the caller
+/// @param slot: index of the hazard slot to clear (less than {@link CHIM_HP_SLOTS})
+INLINE
+void hp_clear(hp_thread* self, size_t slot) {
+  assert(slot < CHIM_HP_SLOTS);
+  atomic_store_explicit(&self->slots[slot], NULL, memory_order_release);
+}
+
+/// @brief Schedule memory to be freed once no hazard slot refers to it.
+///
+/// The memory must already be unreachable from shared locations.
+/// When enough pointers have been retired, this scans all hazard slots, which takes time linear in the number of threads.
+///
+/// @param self: a record owned by the caller
+/// @param ptr: memory allocated by the domain's allocator (tagged pointers must be stripped with {@link unTag} first)
+/// @return false if the retire list could not grow (in which case the caller still owns `ptr`)
+bool hp_retire(hp_thread* self, void* ptr);
+
+/// @brief Free every pointer retired by the caller that is not currently protected.
+///
+/// @param self: a record owned by the caller
+/// @return false if there was not enough memory to take a snapshot of the hazards (nothing is freed in that case)
+bool hp_scan(hp_thread* self);
+
+
+#endif
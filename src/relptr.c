@@ -0,0 +1,151 @@
+#include <stdalign.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alignment.h"
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+#undef INLINE
+#define INLINE
+#include "relptr.h"
+
+
+static const byte magic[4] = {'C', 'H', 'R', 'I'};
+
+// most alignment an object in an image may ask for (a page)
+#define MAXALIGN 4096
+
+static inline
+relimg_header* header(const relimg* img) {
+  return (relimg_header*)img->buf.buf;
+}
+
+static
+bool reserve(alloc_t mem, dynarr_byte* dst, size_t extra) {
+  if (dst->cap - dst->len >= extra) { return true; }
+  if (extra > SIZE_MAX - dst->len) { return false; }
+  size_t cap = dst->cap > SIZE_MAX / 2 ? SIZE_MAX : 2 * dst->cap;
+  if (cap < dst->len + extra) { cap = dst->len + extra; }
+  return dynarr_resize_byte(mem, dst, cap);
+}
+
+bool relimg_init(alloc_t mem, relimg* img, size_t cap0) {
+  if (cap0 < sizeof(relimg_header)) { cap0 = sizeof(relimg_header); }
+  if (!dynarr_init_byte(mem, &img->buf, cap0)) { return false; }
+  relimg_header* h = header(img);
+  memset(h, 0, sizeof(relimg_header));
+  memcpy(h->magic, magic, sizeof(magic));
+  h->version = CHIM_RELIMG_VERSION;
+  h->size = sizeof(relimg_header);
+  img->buf.len = sizeof(relimg_header);
+  return true;
+}
+
+void relimg_deinit(alloc_t mem, relimg* img) {
+  dynarr_deinit_byte(mem, &img->buf);
+}
+
+bool relimg_alloc(alloc_t mem, relimg* img, size_t size, size_t align, size_t* off) {
+  assert(align <= MAXALIGN);
+  // offsets are aligned relative to the image's start, which the loader requires to be suitably aligned itself
+  size_t len = img->buf.len;
+  if (len > SIZE_MAX - MAXALIGN) { return false; }
+  size_t start = alignUp(len, align);
+  if (size > SIZE_MAX - start) { return false; }
+  if (!reserve(mem, &img->buf, start + size - len)) { return false; }
+  memset(img->buf.buf + len, 0, start + size - len);
+  img->buf.len = start + size;
+  header(img)->size = img->buf.len;
+  *off = start;
+  return true;
+}
+
+bool relimg_appendSlice(alloc_t mem, relimg* img, _larr src, size_t elemSize, size_t align, size_t* off) {
+  if (elemSize != 0 && src.len > SIZE_MAX / elemSize) { return false; }
+  size_t size = src.len * elemSize;
+  size_t start;
+  if (!relimg_alloc(mem, img, size, align, &start)) { return false; }
+  if (size != 0) { memcpy(img->buf.buf + start, src.arr, size); }
+  *off = start;
+  return true;
+}
+
+void* relimg_at(const relimg* img, size_t off) {
+  assert(off <= img->buf.len);
+  return img->buf.buf + off;
+}
+
+void relimg_link(relimg* img, size_t field, size_t target) {
+  assert(field + sizeof(_relptr) <= img->buf.len);
+  _relptr* p = (_relptr*)relimg_at(img, field);
+  // offsets are independent of where the buffer currently is, so compute the distance from them directly
+  p->off = target == SIZE_MAX ? 0 : (int64_t)target - (int64_t)field;
+}
+
+void relimg_linkSlice(relimg* img, size_t field, size_t target, size_t len) {
+  assert(field + sizeof(_rellarr) <= img->buf.len);
+  _rellarr* p = (_rellarr*)relimg_at(img, field);
+  p->off = len == 0 ? 0 : (int64_t)target - (int64_t)field;
+  p->len = len;
+}
+
+void relimg_setRoot(relimg* img, size_t target) {
+  relimg_link(img, offsetof(relimg_header, root), target);
+}
+
+larr_byte relimg_bytes(const relimg* img) {
+  return larr_mk_byte(img->buf.len, img->buf.buf);
+}
+
+
+// Whether `size` bytes at `off` from `field` lie wholly within the image, at the given alignment.
+// Done in unsigned 64-bit arithmetic on addresses, so that a corrupt offset cannot overflow into a false pass.
+static
+bool inImage(larr_byte image, const void* field, int64_t off, uint64_t size, size_t align) {
+  uint64_t base = (uintptr_t)image.arr;
+  uint64_t end = base + ((const relimg_header*)image.arr)->size;
+  uint64_t at = (uintptr_t)field;
+  if (at < base || at >= end) { return false; }
+  uint64_t target;
+  if (off < 0) {
+    uint64_t back = (uint64_t)0 - (uint64_t)off;
+    if (back > at - base) { return false; }
+    target = at - back;
+  }
+  else {
+    if ((uint64_t)off > end - at) { return false; }
+    target = at + (uint64_t)off;
+  }
+  if (size > end - target) { return false; }
+  return target % align == 0;
+}
+
+const void* relimg_open(larr_byte image, size_t rootSize, size_t rootAlign) {
+  if (image.len < sizeof(relimg_header)) { return NULL; }
+  if ((uintptr_t)image.arr % alignof(relimg_header) != 0) { return NULL; }
+  const relimg_header* h = (const relimg_header*)image.arr;
+  if (memcmp(h->magic, magic, sizeof(magic)) != 0) { return NULL; }
+  if (h->version != CHIM_RELIMG_VERSION) { return NULL; }
+  if (h->size < sizeof(relimg_header) || h->size > image.len) { return NULL; }
+  if (h->root.off == 0) { return NULL; }
+  if (!inImage(image, &h->root, h->root.off, rootSize, rootAlign)) { return NULL; }
+  return _relptr_get(&h->root);
+}
+
+bool relimg_check(larr_byte image, const _relptr* field, size_t size, size_t align) {
+  if (field->off == 0) { return true; }
+  return inImage(image, field, field->off, size, align);
+}
+
+bool relimg_checkSlice(larr_byte image, const _rellarr* field, size_t elemSize, size_t align) {
+  if (field->len == 0) { return true; }
+  if (field->off == 0) { return false; }
+  if (elemSize != 0 && field->len > UINT64_MAX / elemSize) { return false; }
+  return inImage(image, field, field->off, field->len * elemSize, align);
+}
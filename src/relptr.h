@@ -0,0 +1,302 @@
+/// @file
+/// @brief Self-relative pointers, and images of data structures built from them, usable wherever they are mapped.
+///
+/// A relative pointer stores the distance from its own address to its target, rather than the target's address.
+/// So a structure whose internal references are all relative pointers can be copied, written to a file,
+///   and mapped back at any address, and is usable immediately: there is no parsing and no pointer fixup pass.
+/// The fields are fixed-width, so the layout is the same for 32- and 64-bit processes.
+///
+/// An image is such a structure laid out in one contiguous block, which starts with a {@link relimg_header}.
+/// Images are built with a {@link relimg} writer, which appends (suitably aligned) objects and array contents
+///   to a byte buffer, and links relative pointers between them.
+/// As the buffer moves when it grows, the writer deals in offsets into the image, rather than pointers.
+///
+/// Loading is just checking: {@link relimg_open} validates the header and the root,
+///   and {@link relimg_check} and {@link relimg_checkSlice} validate each further reference before it is followed,
+///   so that a truncated or corrupt file is detected rather than read out of bounds.
+///
+/// ### Polymorphic Usage
+///
+/// Make sure that the corresponding C file is included in your build
+///   (either by compiling as its own translation unit, or as part of a larger unit).
+///
+/// Then, instantiate this header at a type name with:
+///
+/// ```
+/// #define RELPTR_TYPE <type name>
+/// #include <this header>
+/// ```
+/// The type name must be an identifier, _not_ a type expression.
+///
+/// After instantiation, identifiers of the form `/_relptr(_<base name>)?/` and `/_rellarr(_<base name>)?/` in {@link relptr.h}
+///   are rewritten to `relptr(_<base name>)?_<type name>` and `rellarr(_<base name>)?_<type name>`,
+///   taking and returning pointers to the type rather than `void*`.
+/// For example, instantiating with a type name `node` will specialize {@link _relptr_get} to `node* relptr_get_node(const relptr_node* self)`.
+
+#ifndef CHIM_RELPTR
+#define CHIM_RELPTR
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+#include "slice.h"
+#include "slice/byte.h"
+
+/// @brief Version of the image layout, checked by {@link relimg_open}.
+#define CHIM_RELIMG_VERSION 1
+
+
+/// @brief Relative pointer.
+typedef struct _relptr {
+  /// @brief distance in bytes from the address of this field to the target, or zero for a null pointer
+  int64_t off;
+} _relptr;
+
+/// @brief Relative slice: a relative pointer to the start of an array, with its length.
+typedef struct _rellarr {
+  /// @brief distance in bytes from the address of this field to the first element, or zero if there are no elements
+  int64_t off;
+  /// @brief number of elements
+  uint64_t len;
+} _rellarr;
+
+/// @brief Follow a relative pointer.
+///
+/// @param self: the relative pointer, at its place in the structure
+/// @return the target, or `NULL`
+INLINE
+void* _relptr_get(const _relptr* self) {
+  return self->off == 0 ? NULL : (char*)self + self->off;
+}
+
+/// @brief Point a relative pointer at a target.
+///
+/// The target should be in the same image (or object) as the pointer, so that they move together.
+///
+/// @param self: the relative pointer, at its place in the structure
+/// @param target: the target, or `NULL`
+INLINE
+void _relptr_set(_relptr* self, const void* target) {
+  self->off = target == NULL ? 0 : (const char*)target - (const char*)self;
+}
+
+/// @brief View a relative slice as a slice.
+///
+/// @param self: the relative slice, at its place in the structure
+/// @return the elements
+INLINE
+_larr _rellarr_view(const _rellarr* self) {
+  return _larr_mk(self->len, self->off == 0 ? NULL : (char*)self + self->off);
+}
+
+/// @brief Point a relative slice at an array.
+///
+/// @param self: the relative slice, at its place in the structure
+/// @param arr: the elements
+INLINE
+void _rellarr_set(_rellarr* self, _larr arr) {
+  self->off = arr.len == 0 ? 0 : arr.arr - (char*)self;
+  self->len = arr.len;
+}
+
+
+/// @brief The start of an image.
+typedef struct relimg_header {
+  /// @brief `"CHRI"`
+  byte magic[4];
+  /// @brief {@link CHIM_RELIMG_VERSION}, in the writer's byte order (so an image from a machine of the other byte order is rejected)
+  uint32_t version;
+  /// @brief size of the whole image, in bytes
+  uint64_t size;
+  /// @brief the root object
+  _relptr root;
+} relimg_header;
+
+/// @brief Writer of an image.
+typedef struct relimg {
+  /// @brief the image so far, starting with its header
+  dynarr_byte buf;
+} relimg;
+
+/// @brief Start a new image.
+///
+/// @param mem: allocator
+/// @param img: the writer
+/// @param cap0: initial capacity, in bytes
+/// @return false if allocation fails
+bool relimg_init(alloc_t mem, relimg* img, size_t cap0);
+
+/// @brief Free the image being written.
+///
+/// @param mem: allocator
+/// @param img: the writer
+void relimg_deinit(alloc_t mem, relimg* img);
+
+/// @brief Append zeroed space for an object.
+///
+/// @param mem: allocator
+/// @param img: the writer
+/// @param size: size of the object, in bytes
+/// @param align: alignment of the object (a power of two, no more than 4096)
+/// @param off: on success, where to store the object's offset in the image
+/// @return false if allocation fails
+bool relimg_alloc(alloc_t mem, relimg* img, size_t size, size_t align, size_t* off);
+
+/// @brief Append a copy of an array.
+///
+/// This is how to lay out the contents of a `dynarr` or `larr`: pass its elements as a slice.
+///
+/// @param mem: allocator
+/// @param img: the writer
+/// @param src: the elements
+/// @param elemSize: size of an element, in bytes
+/// @param align: alignment of an element (a power of two, no more than 4096)
+/// @param off: on success, where to store the offset of the copy in the image
+/// @return false if allocation fails
+bool relimg_appendSlice(alloc_t mem, relimg* img, _larr src, size_t elemSize, size_t align, size_t* off);
+
+/// @brief Get the current address of a position in the image.
+///
+/// @warning The address is invalidated by the next append.
+///
+/// @param img: the writer
+/// @param off: offset in the image
+/// @return address of that offset
+void* relimg_at(const relimg* img, size_t off);
+
+/// @brief Point a relative pointer in the image at another object in the image.
+///
+/// @param img: the writer
+/// @param field: offset of the relative pointer
+/// @param target: offset of the target, or `SIZE_MAX` for a null pointer
+void relimg_link(relimg* img, size_t field, size_t target);
+
+/// @brief Point a relative slice in the image at an array in the image.
+///
+/// @param img: the writer
+/// @param field: offset of the relative slice
+/// @param target: offset of the first element
+/// @param len: number of elements
+void relimg_linkSlice(relimg* img, size_t field, size_t target, size_t len);
+
+/// @brief Set the root object of the image.
+///
+/// @param img: the writer
+/// @param target: offset of the root object
+void relimg_setRoot(relimg* img, size_t target);
+
+/// @brief View the finished image, ready to be written out.
+///
+/// @param img: the writer
+/// @return the bytes of the image
+larr_byte relimg_bytes(const relimg* img);
+
+/// @brief Validate an image's header and root.
+///
+/// The image must be at an address aligned as strictly as any object in it (e.g. page-aligned, when mapped from a file).
+///
+/// @param image: the image (trailing bytes after it are allowed)
+/// @param rootSize: size of the root object
+/// @param rootAlign: alignment of the root object
+/// @return the root object, or `NULL` if the image is malformed
+const void* relimg_open(larr_byte image, size_t rootSize, size_t rootAlign);
+
+/// @brief Validate a relative pointer before following it.
+///
+/// @param image: the image, as passed to {@link relimg_open}
+/// @param field: the relative pointer, within the image
+/// @param size: size of the target
+/// @param align: alignment of the target
+/// @return false if the target is not null, and not wholly within the image or misaligned
+bool relimg_check(larr_byte image, const _relptr* field, size_t size, size_t align);
+
+/// @brief Validate a relative slice before viewing it.
+///
+/// @param image: the image, as passed to {@link relimg_open}
+/// @param field: the relative slice, within the image
+/// @param elemSize: size of an element
+/// @param align: alignment of an element
+/// @return false if the elements are not wholly within the image or misaligned
+bool relimg_checkSlice(larr_byte image, const _rellarr* field, size_t elemSize, size_t align);
+
+
+#endif
+
+
+
+
+#ifdef RELPTR_TYPE
+  // macros to paste expanded arguments
+  #define _relptr_paste(T) relptr_ ## T
+  #define _relptr_get_paste(T) relptr_get_ ## T
+  #define _relptr_set_paste(T) relptr_set_ ## T
+  #define _rellarr_paste(T) rellarr_ ## T
+  #define _rellarr_get_paste(T) rellarr_get_ ## T
+  #define _rellarr_set_paste(T) rellarr_set_ ## T
+  // macros I actually use
+  #define relptr(T) _relptr_paste(T)
+  #define relptr_get(T) _relptr_get_paste(T)
+  #define relptr_set(T) _relptr_set_paste(T)
+  #define rellarr(T) _rellarr_paste(T)
+  #define rellarr_get(T) _rellarr_get_paste(T)
+  #define rellarr_set(T) _rellarr_set_paste(T)
+
+typedef struct relptr(RELPTR_TYPE) {
+  int64_t off;
+} relptr(RELPTR_TYPE);
+
+typedef struct rellarr(RELPTR_TYPE) {
+  int64_t off;
+  uint64_t len;
+} rellarr(RELPTR_TYPE);
+
+// sanity check on compiler struct layout algorithm
+static_assert(sizeof(relptr(RELPTR_TYPE)) == sizeof(_relptr)
+             , "layout of polymorphic relptr does not match _relptr");
+static_assert(sizeof(rellarr(RELPTR_TYPE)) == sizeof(_rellarr)
+             , "layout of polymorphic rellarr does not match _rellarr");
+
+static inline
+RELPTR_TYPE* relptr_get(RELPTR_TYPE)(const relptr(RELPTR_TYPE)* self) {
+  return _relptr_get((const _relptr*)self);
+}
+
+static inline
+void relptr_set(RELPTR_TYPE)(relptr(RELPTR_TYPE)* self, const RELPTR_TYPE* target) {
+  _relptr_set((_relptr*)self, target);
+}
+
+// the first element (the length is in the `len` field)
+static inline
+RELPTR_TYPE* rellarr_get(RELPTR_TYPE)(const rellarr(RELPTR_TYPE)* self) {
+  return (RELPTR_TYPE*)_rellarr_view((const _rellarr*)self).arr;
+}
+
+static inline
+void rellarr_set(RELPTR_TYPE)(rellarr(RELPTR_TYPE)* self, RELPTR_TYPE* arr, size_t len) {
+  _rellarr_set((_rellarr*)self, _larr_mk(len, arr));
+}
+
+  #undef rellarr_set
+  #undef rellarr_get
+  #undef rellarr
+  #undef relptr_set
+  #undef relptr_get
+  #undef relptr
+  #undef _rellarr_set_paste
+  #undef _rellarr_get_paste
+  #undef _rellarr_paste
+  #undef _relptr_set_paste
+  #undef _relptr_get_paste
+  #undef _relptr_paste
+  #undef RELPTR_TYPE
+#endif
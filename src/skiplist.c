@@ -0,0 +1,283 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/tags.h"
+#include "alloc/unaligned.h"
+#include "reclaim/epoch.h"
+
+#undef INLINE
+#define INLINE
+#include "skiplist.h"
+
+
+// tag set in a next pointer once its node is deleted
+#define MARK 1
+
+// `state` bits.
+// Whoever of the inserter and the deleter finishes with a node last retires it:
+//   the inserter may still link an upper level after the deleter has unlinked the others,
+//   so the node is only unreachable once both are done with it.
+#define LINKING 1u
+#define DELETED 2u
+
+static_assert(CHIM_PTRTAGBITS_MAX >= 1, "skip list needs a tag bit in node pointers");
+
+static inline
+uintptr_t loadNext(const skip_node* node, uint32_t lvl) {
+  return atomic_load_explicit((_Atomic uintptr_t*)&node->next[lvl], memory_order_acquire);
+}
+
+static inline
+bool marked(uintptr_t next) {
+  tagged_ptr p = {.u = next};
+  return getTag(p) == MARK;
+}
+
+static inline
+skip_node* ptrOf(uintptr_t next) {
+  tagged_ptr p = {.u = next};
+  return unTag(p);
+}
+
+static inline
+uintptr_t markOf(uintptr_t next) {
+  tagged_ptr p = {.u = next};
+  return setTag(p, MARK).u;
+}
+
+static inline
+bool swing(_Atomic uintptr_t* field, uintptr_t expect, uintptr_t desired) {
+  return atomic_compare_exchange_strong_explicit(field, &expect, desired, memory_order_acq_rel, memory_order_acquire);
+}
+
+// xorshift64: heights only need to be well-spread, not unpredictable
+static _Thread_local uint64_t seed = 0;
+
+// Each level above the first with probability one half.
+static
+uint32_t randomHeight(void) {
+  uint64_t x = seed;
+  // seeding from the address of the thread-local keeps threads from building identical towers
+  if (x == 0) { x = (uint64_t)(uintptr_t)&seed * UINT64_C(0x9e3779b97f4a7c15) | 1; }
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  seed = x;
+  return 1 + (uint32_t)__builtin_ctzll(x | (UINT64_C(1) << (CHIM_SKIP_MAXHEIGHT - 1)));
+}
+
+static
+skip_node* newNode(alloc_t mem, uint64_t key, any val, uint32_t height) {
+  skip_node* node = allocIn(mem, sizeof(skip_node) + height * sizeof(_Atomic uintptr_t));
+  if (node == NULL) { return NULL; }
+  assert(is_taggable(node));
+  node->key = key;
+  atomic_init(&node->val, val);
+  atomic_init(&node->state, LINKING);
+  node->height = height;
+  for (uint32_t i = 0; i < height; ++i) { atomic_init(&node->next[i], 0); }
+  return node;
+}
+
+static
+void retire(ebr_thread* self, skip_node* node) {
+  // the limbo list only fails to grow when memory is exhausted, and leaking one node beats freeing it early
+  (void)ebr_retire(self, node);
+}
+
+bool skip_init(skiplist* list, ebr_domain* dom) {
+  list->dom = dom;
+  list->head = newNode(dom->mem, 0, NULL, CHIM_SKIP_MAXHEIGHT);
+  return list->head != NULL;
+}
+
+void skip_deinit(skiplist* list) {
+  skip_node* node = list->head;
+  while (node != NULL) {
+    skip_node* next = ptrOf(loadNext(node, 0));
+    freeIn(list->dom->mem, node);
+    node = next;
+  }
+  list->head = NULL;
+}
+
+
+// Search for `key`, unlinking every marked node met on the way, including those holding `key` itself.
+// Fills `preds` and `succs` with the last node before `key` and the first node at or after it, at every level.
+// Returns the node holding `key`, if it is present.
+static
+skip_node* find(const skiplist* list, uint64_t key, skip_node** preds, skip_node** succs) {
+retry:;
+  skip_node* pred = list->head;
+  for (int lvl = CHIM_SKIP_MAXHEIGHT - 1; lvl >= 0; --lvl) {
+    skip_node* curr = ptrOf(loadNext(pred, lvl));
+    while (curr != NULL) {
+      uintptr_t succ = loadNext(curr, lvl);
+      if (marked(succ)) {
+        // fails if `pred` was itself marked, or something was linked after it: either way, its view is stale
+        if (!swing(&pred->next[lvl], (uintptr_t)curr, (uintptr_t)ptrOf(succ))) { goto retry; }
+        curr = ptrOf(succ);
+        continue;
+      }
+      if (curr->key >= key) { break; }
+      pred = curr;
+      curr = ptrOf(succ);
+    }
+    preds[lvl] = pred;
+    succs[lvl] = curr;
+    // A deleted node may sit behind a live one with the same key, at an upper level:
+    //   the key was added again while its previous node was deleted, and the new node linked in front of it
+    //   (by an inserter which found the old node unmarked at that level).
+    // Its deleter's search stops at the new node, so go on past equal keys, lest the old node outlive its retirement.
+    for (skip_node* p = curr; p != NULL && p->key == key; ) {
+      uintptr_t next = loadNext(p, lvl);
+      skip_node* q = ptrOf(next);
+      if (q == NULL || q->key != key) { break; }
+      uintptr_t succ = loadNext(q, lvl);
+      if (!marked(succ)) {
+        p = q;
+        continue;
+      }
+      if (marked(next) || !swing(&p->next[lvl], next, (uintptr_t)ptrOf(succ))) { goto retry; }
+    }
+  }
+  return succs[0] != NULL && succs[0]->key == key ? succs[0] : NULL;
+}
+
+// Search for the first live node at or after `key`, stepping over marked nodes instead of unlinking them.
+// Reads only, so lookups do not contend with one another on the nodes they pass.
+static
+skip_node* search(const skiplist* list, uint64_t key) {
+  const skip_node* pred = list->head;
+  skip_node* curr = NULL;
+  for (int lvl = CHIM_SKIP_MAXHEIGHT - 1; lvl >= 0; --lvl) {
+    curr = ptrOf(loadNext(pred, lvl));
+    while (curr != NULL) {
+      uintptr_t succ = loadNext(curr, lvl);
+      if (marked(succ)) {
+        curr = ptrOf(succ);
+        continue;
+      }
+      if (curr->key >= key) { break; }
+      pred = curr;
+      curr = ptrOf(succ);
+    }
+  }
+  return curr;
+}
+
+bool skip_get(skiplist* list, ebr_thread* self, uint64_t key, any* val) {
+  ebr_enter(self);
+  skip_node* node = search(list, key);
+  bool found = node != NULL && node->key == key;
+  if (found && val != NULL) { *val = skip_val(node); }
+  ebr_exit(self);
+  return found;
+}
+
+skip_node* skip_seek(const skiplist* list, uint64_t key) {
+  return search(list, key);
+}
+
+
+// Returns 1 if inserted, 0 if already present, and -1 if allocation fails.
+static
+int insert(skiplist* list, ebr_thread* self, uint64_t key, any val, bool replace) {
+  skip_node* preds[CHIM_SKIP_MAXHEIGHT];
+  skip_node* succs[CHIM_SKIP_MAXHEIGHT];
+  skip_node* node = NULL;
+  ebr_enter(self);
+  // link the bottom level, which is what makes the key present
+  for (;;) {
+    skip_node* found = find(list, key, preds, succs);
+    if (found != NULL) {
+      if (replace) { atomic_store_explicit(&found->val, val, memory_order_release); }
+      // never published, so no other thread can have seen it
+      if (node != NULL) { freeIn(list->dom->mem, node); }
+      ebr_exit(self);
+      return 0;
+    }
+    if (node == NULL) {
+      node = newNode(list->dom->mem, key, val, randomHeight());
+      if (node == NULL) {
+        ebr_exit(self);
+        return -1;
+      }
+    }
+    atomic_store_explicit(&node->next[0], (uintptr_t)succs[0], memory_order_relaxed);
+    if (swing(&preds[0]->next[0], (uintptr_t)succs[0], (uintptr_t)node)) { break; }
+  }
+  // then the rest of the tower, giving up as soon as the node is deleted
+  for (uint32_t lvl = 1; lvl < node->height; ++lvl) {
+    for (;;) {
+      uintptr_t old = loadNext(node, lvl);
+      if (marked(old)) { goto done; }
+      // only the deleter writes an unlinked level of the tower, so this fails only once the node is marked
+      if (old != (uintptr_t)succs[lvl] && !swing(&node->next[lvl], old, (uintptr_t)succs[lvl])) { goto done; }
+      if (swing(&preds[lvl]->next[lvl], (uintptr_t)succs[lvl], (uintptr_t)node)) { break; }
+      find(list, key, preds, succs);
+      if (succs[0] != node) { goto done; }
+    }
+  }
+done:;
+  uint32_t state = atomic_fetch_and_explicit(&node->state, ~LINKING, memory_order_acq_rel);
+  if (state & DELETED) {
+    // the deleter has come and gone: unlink whatever was linked since, then retire on its behalf
+    find(list, key, preds, succs);
+    retire(self, node);
+  }
+  ebr_exit(self);
+  return 1;
+}
+
+bool skip_put(skiplist* list, ebr_thread* self, uint64_t key, any val) {
+  return insert(list, self, key, val, true) >= 0;
+}
+
+bool skip_add(skiplist* list, ebr_thread* self, uint64_t key, any val, bool* ok) {
+  int res = insert(list, self, key, val, false);
+  if (ok != NULL) { *ok = res >= 0; }
+  return res > 0;
+}
+
+bool skip_del(skiplist* list, ebr_thread* self, uint64_t key, any* val) {
+  skip_node* preds[CHIM_SKIP_MAXHEIGHT];
+  skip_node* succs[CHIM_SKIP_MAXHEIGHT];
+  ebr_enter(self);
+  skip_node* node = find(list, key, preds, succs);
+  if (node == NULL) {
+    ebr_exit(self);
+    return false;
+  }
+  // mark from the top down, so that once the bottom is marked (and the key is gone)
+  //   no level of the tower can be linked after another node anymore
+  for (uint32_t lvl = node->height - 1; lvl >= 1; --lvl) {
+    uintptr_t next = loadNext(node, lvl);
+    while (!marked(next)) {
+      if (swing(&node->next[lvl], next, markOf(next))) { break; }
+      next = loadNext(node, lvl);
+    }
+  }
+  for (;;) {
+    uintptr_t next = loadNext(node, 0);
+    if (marked(next)) {
+      ebr_exit(self);
+      return false;
+    }
+    if (swing(&node->next[0], next, markOf(next))) { break; }
+  }
+  if (val != NULL) { *val = skip_val(node); }
+  // announce the deletion before unlinking: an inserter still linking levels will see it, and unlink and retire the node itself,
+  //   whereas once it has finished linking, the find below cannot miss a level it linked
+  uint32_t state = atomic_fetch_or_explicit(&node->state, DELETED, memory_order_acq_rel);
+  if (!(state & LINKING)) {
+    find(list, key, preds, succs);
+    retire(self, node);
+  }
+  ebr_exit(self);
+  return true;
+}
@@ -0,0 +1,157 @@
+/// @file
+/// @brief Lock-free ordered map from 64-bit keys to pointers, as a skip list.
+///
+/// Any number of threads may insert, delete, look up, and iterate at once, without locks.
+/// Every node is linked into the bottom level list, and into a random number of the levels above it (its _tower_),
+///   each level holding about half the nodes of the level below, so a search skips across most of the list.
+/// Towers are linked one level at a time with compare-and-swap.
+///
+/// Deletion follows Harris: a node is first _marked_, by setting a tag bit (see {@link alloc/tags.h}) in each of its next pointers,
+///   from the top of the tower down; whichever thread marks the bottom level has deleted the node.
+/// A marked pointer can no longer be swung, so nothing can be linked after a marked node,
+///   and any thread that finds a marked node in its path unlinks it.
+///
+/// Unlinked nodes are retired into an {@link ebr_domain}, and allocated from that domain's allocator.
+/// Initialize the domain with {@link arena_alloc} to draw nodes from per-thread arenas, which makes allocation nearly free
+///   and leaves no shared allocator state for threads to contend on (an arena block may be freed from any thread).
+///
+/// Every operation takes the calling thread's {@link ebr_thread} record, and enters and exits a critical section itself,
+///   except iteration, which must be bracketed by the caller (see {@link skip_seek}).
+
+#ifndef CHIM_SKIPLIST
+#define CHIM_SKIPLIST
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/tags.h"
+#include "chimtypes.h"
+#include "reclaim/epoch.h"
+
+/// @brief Maximum number of levels in a list.
+///
+/// With each level half as full as the one below, this is plenty for any list that fits in memory.
+#define CHIM_SKIP_MAXHEIGHT 32
+
+
+/// @brief A node of the list.
+///
+/// Only valid while the critical section in which it was found lasts.
+typedef struct skip_node {
+  /// @brief the key (immutable)
+  uint64_t key;
+  /// @brief the value (replaced in place by {@link skip_put})
+  _Atomic(any) val;
+  /// @brief whether the node is still being linked, and whether it has been deleted (see skiplist.c)
+  _Atomic uint32_t state;
+  /// @brief number of levels in the tower
+  uint32_t height;
+  /// @brief successor at each level, as a {@link tagged_ptr} whose tag is set once the node is deleted
+  _Atomic uintptr_t next[];
+} skip_node;
+
+/// @brief A skip list.
+typedef struct skiplist {
+  /// @brief sentinel node of full height, before every key
+  skip_node* head;
+  /// @brief domain into which unlinked nodes are retired, and whose allocator holds them
+  ebr_domain* dom;
+} skiplist;
+
+/// @brief Initialize an empty list.
+///
+/// @param list: the list
+/// @param dom: reclamation domain shared by every thread using the list
+/// @return false if allocation fails
+bool skip_init(skiplist* list, ebr_domain* dom);
+
+/// @brief Free every node in the list.
+///
+/// @warning No thread may be using the list when this is called.
+/// Nodes already retired are freed by the domain, not here.
+///
+/// @param list: the list
+void skip_deinit(skiplist* list);
+
+/// @brief Look up a key.
+///
+/// @param list: the list
+/// @param self: the caller's record in the list's domain
+/// @param key: the key
+/// @param val: where to store the value, if found (may be `NULL`)
+/// @return whether the key is present
+bool skip_get(skiplist* list, ebr_thread* self, uint64_t key, any* val);
+
+/// @brief Insert a key, or replace its value if it is already present.
+///
+/// @param list: the list
+/// @param self: the caller's record in the list's domain
+/// @param key: the key
+/// @param val: the value
+/// @return false if allocation fails
+bool skip_put(skiplist* list, ebr_thread* self, uint64_t key, any val);
+
+/// @brief Insert a key unless it is already present.
+///
+/// @param list: the list
+/// @param self: the caller's record in the list's domain
+/// @param key: the key
+/// @param val: the value
+/// @param ok: set false if allocation fails (may be `NULL`)
+/// @return whether the key was inserted
+bool skip_add(skiplist* list, ebr_thread* self, uint64_t key, any val, bool* ok);
+
+/// @brief Delete a key.
+///
+/// @param list: the list
+/// @param self: the caller's record in the list's domain
+/// @param key: the key
+/// @param val: where to store the value of the deleted entry, if any (may be `NULL`)
+/// @return whether this call deleted the key (false if it was absent, or another thread deleted it first)
+bool skip_del(skiplist* list, ebr_thread* self, uint64_t key, any* val);
+
+/// @brief Find the first live node at or after a key, to begin a range iteration.
+///
+/// The caller must be inside a critical section (see {@link ebr_enter}) from before this call
+///   until it is done with the nodes returned by this and {@link skip_next}.
+/// Iteration is weakly consistent: it sees every key present for the whole iteration, in increasing order,
+///   and may or may not see keys inserted or deleted concurrently.
+/// Keep critical sections short, as they hold back reclamation for every thread.
+///
+/// @param list: the list
+/// @param key: where to start
+/// @return the node, or `NULL` if there is no key at or after `key`
+skip_node* skip_seek(const skiplist* list, uint64_t key);
+
+/// @brief Step to the next live node.
+///
+/// @param node: a node found in the current critical section
+/// @return the next node, or `NULL` at the end of the list
+INLINE
+skip_node* skip_next(const skip_node* node) {
+  for (;;) {
+    tagged_ptr next = {.u = atomic_load_explicit(&node->next[0], memory_order_acquire)};
+    node = unTag(next);
+    if (node == NULL) { return NULL; }
+    tagged_ptr after = {.u = atomic_load_explicit(&node->next[0], memory_order_acquire)};
+    if (getTag(after) == 0) { return (skip_node*)node; }
+  }
+}
+
+/// @brief Read a node's value.
+///
+/// @param node: a node found in the current critical section
+/// @return its value
+INLINE
+any skip_val(const skip_node* node) {
+  return atomic_load_explicit((_Atomic(any)*)&node->val, memory_order_acquire);
+}
+
+
+#endif
@@ -0,0 +1,119 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "buffer.h"
+#include "slice.h"
+
+#undef INLINE
+#define INLINE
+#include "slotmap.h"
+
+
+#define NONE UINT32_MAX
+
+static inline
+_slotmap_slot* slotAt(const _slotmap* m, uint32_t index) {
+  return &((_slotmap_slot*)m->slots.buf)[index];
+}
+
+static inline
+uint32_t* owners(const _slotmap* m) {
+  return (uint32_t*)m->owners.buf;
+}
+
+// The live slot named by `h`, or NULL if `h` is stale.
+static
+_slotmap_slot* lookup(const _slotmap* m, slot_handle h) {
+  uint32_t index = (uint32_t)h;
+  uint32_t gen = (uint32_t)(h >> 32);
+  if (index >= m->slots.len) { return NULL; }
+  _slotmap_slot* slot = slotAt(m, index);
+  if (slot->gen != gen || (gen & 1) == 0) { return NULL; }
+  return slot;
+}
+
+
+bool _slotmap_init(alloc_t mem, _slotmap* m, size_t cap0, size_t elemSize) {
+  if (!_dynarr_init(mem, &m->vals, cap0, elemSize)) { return false; }
+  if (!_dynarr_init(mem, &m->owners, cap0, sizeof(uint32_t))) {
+    _dynarr_deinit(mem, &m->vals);
+    return false;
+  }
+  if (!_dynarr_init(mem, &m->slots, cap0, sizeof(_slotmap_slot))) {
+    _dynarr_deinit(mem, &m->owners);
+    _dynarr_deinit(mem, &m->vals);
+    return false;
+  }
+  m->free = NONE;
+  return true;
+}
+
+void _slotmap_deinit(alloc_t mem, _slotmap* m) {
+  _dynarr_deinit(mem, &m->slots);
+  _dynarr_deinit(mem, &m->owners);
+  _dynarr_deinit(mem, &m->vals);
+  m->free = NONE;
+}
+
+slot_handle _slotmap_insert(alloc_t mem, _slotmap* m, const void* elem, size_t elemSize) {
+  if (m->vals.len >= CHIM_SLOTMAP_MAX) { return 0; }
+  // do everything that can fail before changing anything
+  // each array grows on its own, as a failure may leave one grown and not the other
+  if (m->vals.len == m->vals.cap) {
+    size_t cap = m->vals.cap > CHIM_SLOTMAP_MAX / 2 ? CHIM_SLOTMAP_MAX : 2 * m->vals.cap;
+    if (!_dynarr_resize(mem, &m->vals, cap, elemSize)) { return 0; }
+  }
+  if (m->owners.len == m->owners.cap) {
+    size_t cap = m->owners.cap > CHIM_SLOTMAP_MAX / 2 ? CHIM_SLOTMAP_MAX : 2 * m->owners.cap;
+    if (!_dynarr_resize(mem, &m->owners, cap, sizeof(uint32_t))) { return 0; }
+  }
+  uint32_t index = m->free;
+  if (index == NONE) {
+    if (m->slots.len >= CHIM_SLOTMAP_MAX) { return 0; }
+    _slotmap_slot fresh = {.gen = 0, .at = NONE};
+    if (!_dynarr_push(mem, &m->slots, &fresh, sizeof(_slotmap_slot))) { return 0; }
+    index = (uint32_t)(m->slots.len - 1);
+  }
+  else {
+    m->free = slotAt(m, index)->at;
+  }
+  _slotmap_slot* slot = slotAt(m, index);
+  uint32_t at = (uint32_t)m->vals.len;
+  slot->gen += 1;
+  slot->at = at;
+  memcpy(m->vals.buf + (size_t)at * elemSize, elem, elemSize);
+  owners(m)[at] = index;
+  m->vals.len += 1;
+  m->owners.len += 1;
+  return (slot_handle)slot->gen << 32 | index;
+}
+
+bool _slotmap_remove(_slotmap* m, slot_handle h, void* out, size_t elemSize) {
+  _slotmap_slot* slot = lookup(m, h);
+  if (slot == NULL) { return false; }
+  uint32_t index = (uint32_t)h;
+  uint32_t at = slot->at;
+  uint32_t last = (uint32_t)(m->vals.len - 1);
+  char* dst = m->vals.buf + (size_t)at * elemSize;
+  if (out != NULL) { memcpy(out, dst, elemSize); }
+  if (at != last) {
+    memcpy(dst, m->vals.buf + (size_t)last * elemSize, elemSize);
+    uint32_t moved = owners(m)[last];
+    owners(m)[at] = moved;
+    slotAt(m, moved)->at = at;
+  }
+  m->vals.len -= 1;
+  m->owners.len -= 1;
+  slot->gen += 1;
+  // once a slot has used up its live generations, retire it, rather than let handles repeat
+  if (slot->gen != UINT32_MAX - 1) {
+    slot->at = m->free;
+    m->free = index;
+  }
+  return true;
+}
@@ -0,0 +1,287 @@
+/// @file
+/// @brief Polymorphic slot maps: densely packed values, addressed by generation-checked handles.
+///
+/// Values are stored contiguously in a {@link _dynarr}, so iterating over them is a linear scan of one array.
+/// References to values are {@link slot_handle}s, which stay valid however other values are inserted and removed:
+///   a handle names a _slot_, which records where its value currently sits in the dense array.
+/// Removing a value moves the last value into its place (and updates that value's slot), so insertion and removal are constant-time,
+///   but the order of the dense array is not the order of insertion.
+///
+/// Each slot has a generation, bumped whenever the slot is filled or emptied, and each handle records the generation it was issued at.
+/// So a handle to a removed value is recognized as stale, even after its slot is reused, rather than aliasing the new value.
+/// Odd generations are live, and even generations free; a slot whose generation would wrap around is never reused.
+///
+/// ### Polymorphic Usage
+///
+/// Make sure that the corresponding C file is included in your build
+///   (either by compiling as its own translation unit, or as part of a larger unit).
+///
+/// The typed map stores a `dynarr` of the value type, and views it as an `larr`,
+///   so first instantiate {@link buffer.h} (with `DYNARR_TYPE`) and {@link slice.h} (with `LARR_TYPE`) at the same type name.
+/// Then, instantiate this header with:
+///
+/// ```
+/// #define SLOTMAP_TYPE <type name>
+/// #include <this header>
+/// ```
+/// The type name must be an identifier, _not_ a type expression.
+/// The header will automatically undefine `SLOTMAP_TYPE` when it is done.
+///
+/// After instantiation, identifiers of the form `/_slotmap(_<base name>)?/` in {@link slotmap.h} are rewritten to
+///   `slotmap(_<base name>)?_<type name>`.
+/// Arguments marked _suppressed_ are removed from the argument list, and values are passed by value.
+/// For example, instantiating with a type name `entity` will specialize {@link _slotmap_get}
+///   to `entity* slotmap_get_entity(const slotmap_entity* m, slot_handle h)`,
+///   and {@link _slotmap_values} to `larr_entity slotmap_values_entity(const slotmap_entity* m)`.
+
+#ifndef CHIM_SLOTMAP
+#define CHIM_SLOTMAP
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer.h"
+#include "slice.h"
+
+/// @brief Most values a slot map can hold.
+#define CHIM_SLOTMAP_MAX ((size_t)UINT32_MAX - 1)
+
+
+/// @brief Reference to a value in a slot map: the slot index in the low 32 bits, and the slot's generation in the high 32 bits.
+///
+/// Zero is never a valid handle, so it may be used as a null handle.
+typedef uint64_t slot_handle;
+
+/// @brief Indirection from a handle to a value.
+typedef struct _slotmap_slot {
+  /// @brief bumped on every insertion and removal (odd while the slot is in use)
+  uint32_t gen;
+  /// @brief position of the value in the dense array while in use, or the next free slot while free
+  uint32_t at;
+} _slotmap_slot;
+
+/// @brief Slot map.
+typedef struct _slotmap {
+  /// @brief the values, densely packed
+  _dynarr vals;
+  /// @brief the slots, as `_slotmap_slot`s
+  _dynarr slots;
+  /// @brief the slot index of each value, as `uint32_t`s (with the same length as `vals`, but a capacity of its own)
+  _dynarr owners;
+  /// @brief first free slot, or `UINT32_MAX` if there is none
+  uint32_t free;
+} _slotmap;
+
+/// @brief Initialize an empty slot map.
+///
+/// @param mem: allocator
+/// @param m: the map
+/// @param cap0: initial capacity, in values (must not be zero)
+/// @param elemSize: (_suppressed_) size of a value, in bytes
+/// @return false if allocation fails
+bool _slotmap_init(alloc_t mem, _slotmap* m, size_t cap0, size_t elemSize);
+
+/// @brief Free a slot map.
+///
+/// Makes no attempt to free any pointers owned by the values.
+///
+/// @param mem: allocator
+/// @param m: the map
+void _slotmap_deinit(alloc_t mem, _slotmap* m);
+
+/// @brief Copy a value into the map.
+///
+/// The value goes at the end of the dense array.
+///
+/// @param mem: allocator
+/// @param m: the map
+/// @param elem: the value
+/// @param elemSize: (_suppressed_) size of a value, in bytes
+/// @return a handle to the value, or zero if allocation fails or the map is full
+slot_handle _slotmap_insert(alloc_t mem, _slotmap* m, const void* elem, size_t elemSize);
+
+/// @brief Remove a value, moving the last value in the dense array into its place.
+///
+/// @param m: the map
+/// @param h: handle to the value
+/// @param out: where to copy the removed value (may be `NULL`)
+/// @param elemSize: (_suppressed_) size of a value, in bytes
+/// @return false if the handle is stale (or was never valid)
+bool _slotmap_remove(_slotmap* m, slot_handle h, void* out, size_t elemSize);
+
+/// @brief Look up a value.
+///
+/// The pointer is invalidated by the next insertion or removal.
+///
+/// @param m: the map
+/// @param h: handle to the value
+/// @param elemSize: (_suppressed_) size of a value, in bytes
+/// @return the value, or `NULL` if the handle is stale (or was never valid)
+INLINE
+void* _slotmap_get(const _slotmap* m, slot_handle h, size_t elemSize) {
+  uint32_t index = (uint32_t)h;
+  uint32_t gen = (uint32_t)(h >> 32);
+  if (index >= m->slots.len) { return NULL; }
+  const _slotmap_slot* slot = &((const _slotmap_slot*)m->slots.buf)[index];
+  if (slot->gen != gen || (gen & 1) == 0) { return NULL; }
+  return m->vals.buf + (size_t)slot->at * elemSize;
+}
+
+/// @brief Number of values in the map.
+///
+/// @param m: the map
+/// @return number of values
+INLINE
+size_t _slotmap_len(const _slotmap* m) {
+  return m->vals.len;
+}
+
+/// @brief View the values, densely packed, for iteration.
+///
+/// The view is invalidated by the next insertion or removal.
+/// Values may be modified through it.
+///
+/// @param m: the map
+/// @return the values, in no particular order
+INLINE
+_larr _slotmap_values(const _slotmap* m) {
+  return _larr_mk(m->vals.len, m->vals.buf);
+}
+
+/// @brief Get the handle of a value by its position in the dense array.
+///
+/// Useful while iterating, e.g. to collect values for removal.
+///
+/// @param m: the map
+/// @param i: position in the dense array (less than the length)
+/// @return a handle to the value
+INLINE
+slot_handle _slotmap_handleAt(const _slotmap* m, size_t i) {
+  assert(i < m->vals.len);
+  uint32_t index = ((const uint32_t*)m->owners.buf)[i];
+  uint32_t gen = ((const _slotmap_slot*)m->slots.buf)[index].gen;
+  return (slot_handle)gen << 32 | index;
+}
+
+
+#endif
+
+
+
+
+#ifdef SLOTMAP_TYPE
+  // macros to paste expanded arguments
+  #define _slotmap_paste(T) slotmap_ ## T
+  #define _slotmap_init_paste(T) slotmap_init_ ## T
+  #define _slotmap_deinit_paste(T) slotmap_deinit_ ## T
+  #define _slotmap_insert_paste(T) slotmap_insert_ ## T
+  #define _slotmap_remove_paste(T) slotmap_remove_ ## T
+  #define _slotmap_get_paste(T) slotmap_get_ ## T
+  #define _slotmap_len_paste(T) slotmap_len_ ## T
+  #define _slotmap_values_paste(T) slotmap_values_ ## T
+  #define _slotmap_handleAt_paste(T) slotmap_handleAt_ ## T
+  #define _slotmap_dynarr_paste(T) dynarr_ ## T
+  #define _slotmap_larr_paste(T) larr_ ## T
+  #define _slotmap_larr_mk_paste(T) larr_mk_ ## T
+  // macros I actually use
+  #define slotmap(T) _slotmap_paste(T)
+  #define slotmap_init(T) _slotmap_init_paste(T)
+  #define slotmap_deinit(T) _slotmap_deinit_paste(T)
+  #define slotmap_insert(T) _slotmap_insert_paste(T)
+  #define slotmap_remove(T) _slotmap_remove_paste(T)
+  #define slotmap_get(T) _slotmap_get_paste(T)
+  #define slotmap_len(T) _slotmap_len_paste(T)
+  #define slotmap_values(T) _slotmap_values_paste(T)
+  #define slotmap_handleAt(T) _slotmap_handleAt_paste(T)
+  #define slotmap_dynarr(T) _slotmap_dynarr_paste(T)
+  #define slotmap_larr(T) _slotmap_larr_paste(T)
+  #define slotmap_larr_mk(T) _slotmap_larr_mk_paste(T)
+
+typedef struct slotmap(SLOTMAP_TYPE) {
+  slotmap_dynarr(SLOTMAP_TYPE) vals;
+  _dynarr slots;
+  _dynarr owners;
+  uint32_t free;
+} slotmap(SLOTMAP_TYPE);
+
+// sanity check on compiler struct layout algorithm
+static_assert(sizeof(slotmap(SLOTMAP_TYPE)) == sizeof(_slotmap)
+             , "layout of polymorphic slotmap does not match _slotmap");
+static_assert(offsetof(slotmap(SLOTMAP_TYPE), vals) == offsetof(_slotmap, vals)
+             , "layout of polymorphic slotmap does not match _slotmap");
+static_assert(offsetof(slotmap(SLOTMAP_TYPE), free) == offsetof(_slotmap, free)
+             , "layout of polymorphic slotmap does not match _slotmap");
+
+static inline
+bool slotmap_init(SLOTMAP_TYPE)(alloc_t mem, slotmap(SLOTMAP_TYPE)* m, size_t cap0) {
+  return _slotmap_init(mem, (_slotmap*)m, cap0, sizeof(SLOTMAP_TYPE));
+}
+
+static inline
+void slotmap_deinit(SLOTMAP_TYPE)(alloc_t mem, slotmap(SLOTMAP_TYPE)* m) {
+  _slotmap_deinit(mem, (_slotmap*)m);
+}
+
+static inline
+slot_handle slotmap_insert(SLOTMAP_TYPE)(alloc_t mem, slotmap(SLOTMAP_TYPE)* m, SLOTMAP_TYPE elem) {
+  return _slotmap_insert(mem, (_slotmap*)m, &elem, sizeof(SLOTMAP_TYPE));
+}
+
+static inline
+bool slotmap_remove(SLOTMAP_TYPE)(slotmap(SLOTMAP_TYPE)* m, slot_handle h, SLOTMAP_TYPE* out) {
+  return _slotmap_remove((_slotmap*)m, h, out, sizeof(SLOTMAP_TYPE));
+}
+
+static inline
+SLOTMAP_TYPE* slotmap_get(SLOTMAP_TYPE)(const slotmap(SLOTMAP_TYPE)* m, slot_handle h) {
+  return _slotmap_get((const _slotmap*)m, h, sizeof(SLOTMAP_TYPE));
+}
+
+static inline
+size_t slotmap_len(SLOTMAP_TYPE)(const slotmap(SLOTMAP_TYPE)* m) {
+  return m->vals.len;
+}
+
+static inline
+slotmap_larr(SLOTMAP_TYPE) slotmap_values(SLOTMAP_TYPE)(const slotmap(SLOTMAP_TYPE)* m) {
+  return slotmap_larr_mk(SLOTMAP_TYPE)(m->vals.len, m->vals.buf);
+}
+
+static inline
+slot_handle slotmap_handleAt(SLOTMAP_TYPE)(const slotmap(SLOTMAP_TYPE)* m, size_t i) {
+  return _slotmap_handleAt((const _slotmap*)m, i);
+}
+
+  #undef slotmap_larr_mk
+  #undef slotmap_larr
+  #undef slotmap_dynarr
+  #undef slotmap_handleAt
+  #undef slotmap_values
+  #undef slotmap_len
+  #undef slotmap_get
+  #undef slotmap_remove
+  #undef slotmap_insert
+  #undef slotmap_deinit
+  #undef slotmap_init
+  #undef slotmap
+  #undef _slotmap_larr_mk_paste
+  #undef _slotmap_larr_paste
+  #undef _slotmap_dynarr_paste
+  #undef _slotmap_handleAt_paste
+  #undef _slotmap_values_paste
+  #undef _slotmap_len_paste
+  #undef _slotmap_get_paste
+  #undef _slotmap_remove_paste
+  #undef _slotmap_insert_paste
+  #undef _slotmap_deinit_paste
+  #undef _slotmap_init_paste
+  #undef _slotmap_paste
+  #undef SLOTMAP_TYPE
+#endif
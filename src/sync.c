@@ -0,0 +1,152 @@
+#define _GNU_SOURCE
+#include <assert.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#undef INLINE
+#define INLINE
+#include "sync.h"
+
+
+#define FOREVER INT64_MIN
+
+// the semaphore's flag saying that threads may be sleeping, and the rest of its state
+#define WAITERS ((uint32_t)1 << 31)
+#define COUNT (WAITERS - 1)
+
+static inline
+void relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// Absolute CLOCK_MONOTONIC deadline, in nanoseconds, for a relative timeout (FOREVER if negative).
+static
+int64_t deadlineOf(int64_t timeoutNs) {
+  if (timeoutNs < 0) { return FOREVER; }
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t base = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  return timeoutNs > INT64_MAX - base ? INT64_MAX : base + timeoutNs;
+}
+
+// Sleep while `*addr == expected`, until an absolute deadline (FOREVER for none).
+// Returns false once the deadline has passed.
+// The bitset form of the operation takes an absolute time, so that waiting again after a spurious wake-up needs no arithmetic.
+static
+bool waitUntil(_Atomic uint32_t* addr, uint32_t expected, int64_t deadline) {
+  struct timespec at;
+  struct timespec* timeout = NULL;
+  if (deadline != FOREVER) {
+    at.tv_sec = deadline / 1000000000;
+    at.tv_nsec = deadline % 1000000000;
+    timeout = &at;
+  }
+  long res = syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_BITSET_PRIVATE, expected, timeout, NULL, FUTEX_BITSET_MATCH_ANY);
+  return !(res < 0 && errno == ETIMEDOUT);
+}
+
+
+bool sync_wait(_Atomic uint32_t* addr, uint32_t expected, int64_t timeoutNs) {
+  return waitUntil(addr, expected, deadlineOf(timeoutNs));
+}
+
+void sync_wake(_Atomic uint32_t* addr, int32_t n) {
+  syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+
+////// Mutex //////
+
+void sync_mutex_lockContended(sync_mutex* m) {
+  // the holder will likely be done soon, so try for a while before paying for a sleep and a wake-up
+  for (int i = 0; i < CHIM_SYNC_SPIN; ++i) {
+    uint32_t state = atomic_load_explicit(&m->state, memory_order_relaxed);
+    if (state == 0) {
+      if (atomic_compare_exchange_weak_explicit(&m->state, &state, 1, memory_order_acquire, memory_order_relaxed)) { return; }
+    }
+    // others are asleep already, so there is no point in spinning
+    else if (state == 2) { break; }
+    relax();
+  }
+  // from here on, whoever takes the lock cannot know whether others are asleep, so it marks the lock contended
+  while (atomic_exchange_explicit(&m->state, 2, memory_order_acquire) != 0) {
+    waitUntil(&m->state, 2, FOREVER);
+  }
+}
+
+void sync_mutex_unlockContended(sync_mutex* m) {
+  atomic_store_explicit(&m->state, 0, memory_order_release);
+  sync_wake(&m->state, 1);
+}
+
+
+////// Event //////
+
+void sync_event_set(sync_event* e) {
+  if (atomic_exchange_explicit(&e->state, 1, memory_order_release) == 2) {
+    sync_wake(&e->state, INT32_MAX);
+  }
+}
+
+bool sync_event_wait(sync_event* e, int64_t timeoutNs) {
+  int64_t deadline = FOREVER;
+  bool timed = timeoutNs >= 0;
+  for (;;) {
+    uint32_t state = atomic_load_explicit(&e->state, memory_order_acquire);
+    if (state == 1) { return true; }
+    // announce a sleeper, so that setting the event knows to wake it
+    if (state == 0 && !atomic_compare_exchange_weak_explicit(&e->state, &state, 2, memory_order_relaxed, memory_order_relaxed)) { continue; }
+    // the clock is only read once there is actually a wait ahead
+    if (timed && deadline == FOREVER) { deadline = deadlineOf(timeoutNs); }
+    if (!waitUntil(&e->state, 2, deadline)) { return sync_event_isSet(e); }
+  }
+}
+
+
+////// Semaphore //////
+
+bool sync_sem_wait(sync_sem* s, int64_t timeoutNs) {
+  if (sync_sem_trywait(s)) { return true; }
+  int64_t deadline = deadlineOf(timeoutNs);
+  bool slept = false;
+  uint32_t state = atomic_load_explicit(&s->state, memory_order_relaxed);
+  for (;;) {
+    if ((state & COUNT) != 0) {
+      // a thread that has slept cannot know whether others still sleep, so it leaves the flag set for the next post
+      uint32_t next = (state - 1) | (slept ? WAITERS : 0);
+      if (atomic_compare_exchange_weak_explicit(&s->state, &state, next, memory_order_acquire, memory_order_relaxed)) {
+        // more posts arrived while asleep than were woken for: pass them on
+        if (slept && (next & COUNT) != 0) { sync_wake(&s->state, 1); }
+        return true;
+      }
+      continue;
+    }
+    if ((state & WAITERS) == 0
+        && !atomic_compare_exchange_weak_explicit(&s->state, &state, state | WAITERS, memory_order_relaxed, memory_order_relaxed)) {
+      continue;
+    }
+    if (!waitUntil(&s->state, WAITERS, deadline)) { return sync_sem_trywait(s); }
+    slept = true;
+    state = atomic_load_explicit(&s->state, memory_order_relaxed);
+  }
+}
+
+void sync_sem_post(sync_sem* s) {
+  uint32_t old = atomic_fetch_add_explicit(&s->state, 1, memory_order_release);
+  assert((old & COUNT) != COUNT);
+  if (old & WAITERS) {
+    // the woken thread sets the flag again if it might not be the only sleeper
+    atomic_fetch_and_explicit(&s->state, ~WAITERS, memory_order_relaxed);
+    sync_wake(&s->state, 1);
+  }
+}
@@ -0,0 +1,196 @@
+/// @file
+/// @brief Blocking synchronization in four bytes each, built on Linux futexes.
+///
+/// A futex is just an aligned 32-bit word: threads sleep in the kernel until the word changes (see {@link sync_wait}),
+///   and the kernel is only involved when a thread actually has to sleep or be woken.
+/// So the uncontended paths here are a single atomic instruction, inlined into the caller,
+///   and each primitive is small enough to embed in the header of the structure it protects.
+///
+/// * {@link sync_mutex}: mutual exclusion, which spins briefly before sleeping, as critical sections are usually short.
+/// * {@link sync_event}: a one-shot flag which threads can wait to be set.
+/// * {@link sync_sem}: a counting semaphore.
+/// * {@link sync_wait} and {@link sync_wake}: waiting on, and waking waiters on, any 32-bit word.
+///
+/// The futexes are process-private, so these primitives synchronize threads, not processes (even within a shared region).
+/// None of them is fair: a thread that has just released may well reacquire before a sleeper wakes up.
+
+#ifndef CHIM_SYNC
+#define CHIM_SYNC
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Number of attempts a contended {@link sync_mutex_lock} makes before sleeping.
+#define CHIM_SYNC_SPIN 100
+
+
+/// @brief Sleep until a word no longer holds a value (or a wake-up arrives).
+///
+/// Returns immediately if the word does not hold `expected` when the kernel checks it.
+/// Wake-ups may be spurious, so the caller should check the word again.
+///
+/// @param addr: the word
+/// @param expected: the value to sleep while the word holds
+/// @param timeoutNs: longest to sleep, in nanoseconds, or a negative number to sleep indefinitely
+/// @return false if the timeout expired
+bool sync_wait(_Atomic uint32_t* addr, uint32_t expected, int64_t timeoutNs);
+
+/// @brief Wake threads sleeping on a word.
+///
+/// @param addr: the word
+/// @param n: most threads to wake (`INT32_MAX` for all)
+void sync_wake(_Atomic uint32_t* addr, int32_t n);
+
+
+/// @brief Mutual exclusion lock.
+///
+/// The state is zero when unlocked, one when locked, and two when locked with (possible) sleepers.
+typedef struct sync_mutex {
+  /// @brief the state
+  _Atomic uint32_t state;
+} sync_mutex;
+
+/// @brief Initializer of an unlocked mutex.
+#define SYNC_MUTEX_INIT {0}
+
+/// @brief Lock a mutex, after finding it locked (called by {@link sync_mutex_lock}).
+///
+/// @param m: the mutex
+void sync_mutex_lockContended(sync_mutex* m);
+
+/// @brief Unlock a mutex with sleepers (called by {@link sync_mutex_unlock}).
+///
+/// @param m: the mutex
+void sync_mutex_unlockContended(sync_mutex* m);
+
+/// @brief Initialize an unlocked mutex.
+///
+/// @param m: the mutex
+INLINE
+void sync_mutex_init(sync_mutex* m) {
+  atomic_init(&m->state, 0);
+}
+
+/// @brief Lock a mutex, sleeping until it is available.
+///
+/// @param m: the mutex
+INLINE
+void sync_mutex_lock(sync_mutex* m) {
+  uint32_t unlocked = 0;
+  if (atomic_compare_exchange_strong_explicit(&m->state, &unlocked, 1, memory_order_acquire, memory_order_relaxed)) { return; }
+  sync_mutex_lockContended(m);
+}
+
+/// @brief Lock a mutex if it is available.
+///
+/// @param m: the mutex
+/// @return whether the caller now holds the mutex
+INLINE
+bool sync_mutex_trylock(sync_mutex* m) {
+  uint32_t unlocked = 0;
+  return atomic_compare_exchange_strong_explicit(&m->state, &unlocked, 1, memory_order_acquire, memory_order_relaxed);
+}
+
+/// @brief Unlock a mutex held by the caller.
+///
+/// @param m: the mutex
+INLINE
+void sync_mutex_unlock(sync_mutex* m) {
+  if (atomic_fetch_sub_explicit(&m->state, 1, memory_order_release) != 1) { sync_mutex_unlockContended(m); }
+}
+
+
+/// @brief One-shot event: once set, it stays set, and every waiter (present and future) proceeds.
+///
+/// The state is zero when unset, one when set, and two when unset with (possible) sleepers.
+typedef struct sync_event {
+  /// @brief the state
+  _Atomic uint32_t state;
+} sync_event;
+
+/// @brief Initializer of an unset event.
+#define SYNC_EVENT_INIT {0}
+
+/// @brief Initialize an unset event.
+///
+/// @param e: the event
+INLINE
+void sync_event_init(sync_event* e) {
+  atomic_init(&e->state, 0);
+}
+
+/// @brief Whether an event has been set.
+///
+/// @param e: the event
+/// @return true if it has been set (in which case everything done before setting it is visible to the caller)
+INLINE
+bool sync_event_isSet(sync_event* e) {
+  return atomic_load_explicit(&e->state, memory_order_acquire) == 1;
+}
+
+/// @brief Set an event, waking every thread waiting for it.
+///
+/// @param e: the event
+void sync_event_set(sync_event* e);
+
+/// @brief Wait for an event to be set.
+///
+/// @param e: the event
+/// @param timeoutNs: longest to wait, in nanoseconds, or a negative number to wait indefinitely
+/// @return whether the event is set (false only if the timeout expired)
+bool sync_event_wait(sync_event* e, int64_t timeoutNs);
+
+
+/// @brief Counting semaphore.
+///
+/// The state holds the count in its low 31 bits, and in its top bit a flag saying that threads may be sleeping.
+typedef struct sync_sem {
+  /// @brief the state
+  _Atomic uint32_t state;
+} sync_sem;
+
+/// @brief Largest count a semaphore can hold.
+#define CHIM_SYNC_SEMMAX INT32_MAX
+
+/// @brief Initialize a semaphore.
+///
+/// @param s: the semaphore
+/// @param count: initial count (no more than {@link CHIM_SYNC_SEMMAX})
+INLINE
+void sync_sem_init(sync_sem* s, uint32_t count) {
+  atomic_init(&s->state, count);
+}
+
+/// @brief Take one from the count, if it is positive.
+///
+/// @param s: the semaphore
+/// @return false if the count was zero
+INLINE
+bool sync_sem_trywait(sync_sem* s) {
+  uint32_t state = atomic_load_explicit(&s->state, memory_order_relaxed);
+  while ((state & (uint32_t)INT32_MAX) != 0) {
+    if (atomic_compare_exchange_weak_explicit(&s->state, &state, state - 1, memory_order_acquire, memory_order_relaxed)) { return true; }
+  }
+  return false;
+}
+
+/// @brief Take one from the count, sleeping until it is positive.
+///
+/// @param s: the semaphore
+/// @param timeoutNs: longest to wait, in nanoseconds, or a negative number to wait indefinitely
+/// @return false if the timeout expired
+bool sync_sem_wait(sync_sem* s, int64_t timeoutNs);
+
+/// @brief Add one to the count, waking a sleeper if there is one.
+///
+/// @param s: the semaphore
+void sync_sem_post(sync_sem* s);
+
+
+#endif
@@ -0,0 +1,169 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "slice/byte.h"
+#include "text/format.h"
+
+#include "builder.h"
+
+
+typedef struct directive {
+  bool left;
+  bool zero;
+  unsigned width;
+  char conv;
+} directive;
+
+static
+bool reserve(alloc_t mem, dynarr_byte* dst, size_t extra) {
+  if (dst->cap - dst->len >= extra) { return true; }
+  if (extra > SIZE_MAX - dst->len) { return false; }
+  size_t cap = dst->cap > SIZE_MAX / 2 ? SIZE_MAX : 2 * dst->cap;
+  if (cap < dst->len + extra) { cap = dst->len + extra; }
+  return dynarr_resize_byte(mem, dst, cap);
+}
+
+// Parse the directive starting just after a `%`.
+// Return the position after it, or `NULL` if it is malformed.
+static
+const char* parseDirective(const char* p, directive* d) {
+  d->left = false;
+  d->zero = false;
+  d->width = 0;
+  if (*p == '-') { d->left = true; ++p; }
+  if (*p == '0') { d->zero = true; ++p; }
+  for (; '0' <= *p && *p <= '9'; ++p) {
+    d->width = 10 * d->width + (*p - '0');
+    if (d->width > CHIM_BUILDER_MAXWIDTH) { return NULL; }
+  }
+  d->conv = *p;
+  switch (d->conv) {
+    case 'i': case 'u': case 'x': case 'X':
+      break;
+    case 'f': case 's': case 'c':
+      d->zero = false;
+      break;
+    case '%':
+      if (d->left || d->zero || d->width != 0) { return NULL; }
+      break;
+    default:
+      return NULL;
+  }
+  return p + 1;
+}
+
+// Length of the literal text at `p` (up to the next directive or the end).
+static inline
+size_t literalLen(const char* p) {
+  const char* pct = strchr(p, '%');
+  return pct != NULL ? (size_t)(pct - p) : strlen(p);
+}
+
+// Most bytes the format could produce, or `SIZE_MAX` if the format is malformed.
+static
+size_t estimate(const char* format, va_list args) {
+  size_t total = 0;
+  for (const char* p = format; *p != '\0';) {
+    size_t lit = literalLen(p);
+    total += lit;
+    p += lit;
+    if (*p == '\0') { break; }
+    directive d;
+    p = parseDirective(p + 1, &d);
+    if (p == NULL) { return SIZE_MAX; }
+    size_t width = CHIM_FMT_MAXWIDTH;
+    switch (d.conv) {
+      case 'i': va_arg(args, int64_t); break;
+      case 'u': case 'x': case 'X': va_arg(args, uint64_t); break;
+      case 'f': va_arg(args, double); break;
+      case 's': width = va_arg(args, larr_byte).len; break;
+      case 'c': va_arg(args, int); width = 1; break;
+      case '%': width = 1; break;
+    }
+    if (width < d.width) { width = d.width; }
+    // the estimate is only an allocation size: saturate rather than wrap, so an absurd one fails to allocate
+    if (width >= SIZE_MAX - total) { return SIZE_MAX - 1; }
+    total += width;
+  }
+  return total;
+}
+
+static
+void writeHex(dynarr_byte* dst, uint64_t x, bool upper) {
+  const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  unsigned n = x == 0 ? 1 : (64 - __builtin_clzll(x) + 3) / 4;
+  byte* end = dst->buf + dst->len + n;
+  for (unsigned i = 0; i < n; ++i, x >>= 4) {
+    *--end = digits[x & 0xf];
+  }
+  dst->len += n;
+}
+
+// Pad the text written since `start` out to the directive's width.
+static
+void pad(dynarr_byte* dst, size_t start, const directive* d) {
+  size_t n = dst->len - start;
+  if (n >= d->width) { return; }
+  size_t fill = d->width - n;
+  byte* s = dst->buf + start;
+  if (d->left) {
+    memset(s + n, ' ', fill);
+  }
+  else {
+    // zeros go between the sign and the digits
+    size_t sign = d->zero && s[0] == '-';
+    memmove(s + sign + fill, s + sign, n - sign);
+    memset(s + sign, d->zero ? '0' : ' ', fill);
+  }
+  dst->len += fill;
+}
+
+bool builder_vappend(alloc_t mem, dynarr_byte* dst, const char* format, va_list args) {
+  va_list scan;
+  va_copy(scan, args);
+  size_t est = estimate(format, scan);
+  va_end(scan);
+  if (est == SIZE_MAX || !reserve(mem, dst, est)) { return false; }
+
+  // Everything now fits, so the formatters below cannot fail.
+  for (const char* p = format; *p != '\0';) {
+    size_t lit = literalLen(p);
+    memcpy(dst->buf + dst->len, p, lit);
+    dst->len += lit;
+    p += lit;
+    if (*p == '\0') { break; }
+    directive d;
+    p = parseDirective(p + 1, &d);
+    size_t start = dst->len;
+    switch (d.conv) {
+      case 'i': fmt_i64(mem, dst, va_arg(args, int64_t)); break;
+      case 'u': fmt_u64(mem, dst, va_arg(args, uint64_t)); break;
+      case 'x': writeHex(dst, va_arg(args, uint64_t), false); break;
+      case 'X': writeHex(dst, va_arg(args, uint64_t), true); break;
+      case 'f': fmt_f64(mem, dst, va_arg(args, double)); break;
+      case 's': {
+        larr_byte s = va_arg(args, larr_byte);
+        if (s.len != 0) { memcpy(dst->buf + dst->len, s.arr, s.len); }
+        dst->len += s.len;
+      } break;
+      case 'c': dst->buf[dst->len++] = (byte)va_arg(args, int); break;
+      case '%': dst->buf[dst->len++] = '%'; break;
+    }
+    pad(dst, start, &d);
+  }
+  return true;
+}
+
+bool builder_append(alloc_t mem, dynarr_byte* dst, const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  bool ok = builder_vappend(mem, dst, format, args);
+  va_end(args);
+  return ok;
+}
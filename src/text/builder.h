@@ -0,0 +1,66 @@
+/// @file
+/// @brief Formatted text, appended to a byte buffer in a single pass.
+///
+/// This is a replacement for `snprintf` where the output goes into a {@link dynarr_byte}:
+///   there is no measuring call followed by a writing call, no temporary buffer, no `FILE*`, and no locale.
+/// The format is scanned once to estimate the width of the output (exact, except that numbers count as their widest),
+///   the destination is grown once to fit, and then everything is written straight into it:
+///   literal text and slice arguments with one `memcpy` each, and numbers by the formatters of {@link text/format.h}.
+/// So a buffer reused across messages stops allocating once it has grown to fit them.
+///
+/// ### Format
+///
+/// The format is text, in which directives `%[-][0][width]conv` are replaced by the arguments, in order:
+///
+/// | conv | argument     | text                                                             |
+/// |------|--------------|------------------------------------------------------------------|
+/// | `i`  | `int64_t`    | decimal                                                          |
+/// | `u`  | `uint64_t`   | decimal                                                          |
+/// | `x`  | `uint64_t`   | hexadecimal, lower-case                                          |
+/// | `X`  | `uint64_t`   | hexadecimal, upper-case                                          |
+/// | `f`  | `double`     | shortest round-trip, as {@link fmt_f64}                          |
+/// | `s`  | `larr_byte`  | the bytes of the slice (passed by value)                         |
+/// | `c`  | `int`        | one byte                                                         |
+///
+/// and `%%` is a literal `%`.
+/// Smaller integer types may be passed to `i`, `u`, `x`, and `X` only after casting to the 64-bit type,
+///   as the argument is read as exactly that type.
+///
+/// If the text is narrower than `width`, it is padded to the left with spaces (right-justified),
+///   or, with the `-` flag, to the right with spaces (left-justified).
+/// The `0` flag pads integers with zeros instead, after any sign.
+
+#ifndef CHIM_TEXT_BUILDER
+#define CHIM_TEXT_BUILDER
+
+#include <stdarg.h>
+#include <stdbool.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "slice/byte.h"
+
+/// @brief Widest padding a directive may ask for.
+#define CHIM_BUILDER_MAXWIDTH 4096
+
+
+/// @brief Append formatted text.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param format: literal text and directives, as described in {@link text/builder.h}
+/// @param ...: one argument per directive
+/// @return false if allocation fails or the format is malformed (`dst` is unchanged)
+bool builder_append(alloc_t mem, dynarr_byte* dst, const char* format, ...);
+
+/// @brief Append formatted text, with the arguments in a `va_list`.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param format: literal text and directives, as described in {@link text/builder.h}
+/// @param args: one argument per directive
+/// @return false if allocation fails or the format is malformed (`dst` is unchanged)
+bool builder_vappend(alloc_t mem, dynarr_byte* dst, const char* format, va_list args);
+
+
+#endif
@@ -0,0 +1,333 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// dependencies keep their own inline definitions; only this module's are emitted here
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "text/pow10.h"
+
+#undef INLINE
+#define INLINE
+#include "format.h"
+
+
+static const char digitPairs[200] =
+  "00010203040506070809"
+  "10111213141516171819"
+  "20212223242526272829"
+  "30313233343536373839"
+  "40414243444546474849"
+  "50515253545556575859"
+  "60616263646566676869"
+  "70717273747576777879"
+  "80818283848586878889"
+  "90919293949596979899";
+
+static const uint64_t powersOf10[20] = {
+  1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+  10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+  1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull,
+  10000000000000000000ull,
+};
+
+// Number of decimal digits in `x`.
+// The bit-length times log10(2) (as 1233/4096) is within one of the answer, and one comparison decides which.
+// (Setting the low bit never changes the number of digits, and makes zero count as one digit.)
+static inline
+unsigned countDigits(uint64_t x) {
+  x |= 1;
+  unsigned t = ((64 - __builtin_clzll(x)) * 1233) >> 12;
+  return t + (x >= powersOf10[t]);
+}
+
+// Write the digits of `x` backwards from `end`.
+static inline
+void writeDigits64(byte* end, uint64_t x) {
+  while (x >= 100) {
+    uint64_t q = x / 100;
+    end -= 2;
+    memcpy(end, &digitPairs[2 * (x - 100 * q)], 2);
+    x = q;
+  }
+  if (x >= 10) {
+    memcpy(end - 2, &digitPairs[2 * x], 2);
+  }
+  else {
+    end[-1] = '0' + x;
+  }
+}
+
+static inline
+void writeDigits32(byte* end, uint32_t x) {
+  while (x >= 100) {
+    uint32_t q = x / 100;
+    end -= 2;
+    memcpy(end, &digitPairs[2 * (x - 100 * q)], 2);
+    x = q;
+  }
+  if (x >= 10) {
+    memcpy(end - 2, &digitPairs[2 * x], 2);
+  }
+  else {
+    end[-1] = '0' + x;
+  }
+}
+
+static inline
+void writeDigits(byte* end, uint64_t x) {
+  if (x <= UINT32_MAX) { writeDigits32(end, x); }
+  else { writeDigits64(end, x); }
+}
+
+static
+bool reserve(alloc_t mem, dynarr_byte* dst, size_t extra) {
+  if (dst->cap - dst->len >= extra) { return true; }
+  if (extra > SIZE_MAX - dst->len) { return false; }
+  size_t cap = dst->cap > SIZE_MAX / 2 ? SIZE_MAX : 2 * dst->cap;
+  if (cap < dst->len + extra) { cap = dst->len + extra; }
+  return dynarr_resize_byte(mem, dst, cap);
+}
+
+
+////// Shortest round-trip floating point (Schubfach) //////
+// See Raffaello Giulietti, "The Schubfach way to render doubles" (2020).
+// The power-of-ten table comes from pow10.h, which also serves parsing.
+
+// {high, low} 64-bit halves of the product of `a` and `b`
+static inline
+void mul64(uint64_t a, uint64_t b, uint64_t* hi, uint64_t* lo) {
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 p = (unsigned __int128)a * b;
+  *hi = p >> 64;
+  *lo = (uint64_t)p;
+#else
+  uint64_t aLo = (uint32_t)a, aHi = a >> 32;
+  uint64_t bLo = (uint32_t)b, bHi = b >> 32;
+  uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  *lo = (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+// The high 64 bits of the 192-bit product of `g` (128 bits) and `cp`, with the lowest bit set if any lower bits are.
+static inline
+uint64_t roundToOdd(uint64_t gHi, uint64_t gLo, uint64_t cp) {
+  uint64_t xHi, xLo, yHi, yLo;
+  mul64(gLo, cp, &xHi, &xLo);
+  mul64(gHi, cp, &yHi, &yLo);
+  yLo += xHi;
+  yHi += yLo < xHi;
+  return yHi | (yLo > 1);
+}
+
+// Shortest decimal `digits * 10^exp10` that rounds to the binary number `c * 2^q`.
+// `lowerCloser` says the next smaller number is half as far away as the next larger (c is a power of two, and not subnormal).
+static
+void shortest(uint64_t c, int q, bool lowerCloser, uint64_t* digits, int* exp10) {
+  const bool even = (c & 1) == 0;
+  const uint64_t cbl = 4 * c - 2 + lowerCloser;
+  const uint64_t cb = 4 * c;
+  const uint64_t cbr = 4 * c + 2;
+  // (q * 1262611) >> 22 == floor(log10(2^q)), and (q * 1262611 - 524031) >> 22 == floor(log10(3/4 * 2^q))
+  const int k = (q * 1262611 - (lowerCloser ? 524031 : 0)) >> 22;
+  // (e * 1741647) >> 19 == floor(log2(10^e))
+  const int h = q + ((-k * 1741647) >> 19) + 1;
+  // the table is truncated, but the algorithm needs the power rounded up
+  uint64_t gHi = pow10_128[-k - CHIM_POW10_MIN][0];
+  uint64_t gLo = pow10_128[-k - CHIM_POW10_MIN][1];
+  if (-k < 0 || -k > CHIM_POW10_MAXEXACT) {
+    gLo += 1;
+    gHi += gLo == 0;
+  }
+
+  // the number and its rounding interval's bounds, scaled by 4 * 10^-k
+  const uint64_t vbl = roundToOdd(gHi, gLo, cbl << h);
+  const uint64_t vb = roundToOdd(gHi, gLo, cb << h);
+  const uint64_t vbr = roundToOdd(gHi, gLo, cbr << h);
+  const uint64_t lower = vbl + !even;
+  const uint64_t upper = vbr - !even;
+
+  const uint64_t s = vb / 4;
+  // prefer one digit fewer, if exactly one of its two neighbours is within the interval
+  if (s >= 10) {
+    const uint64_t sp = s / 10;
+    const bool upInside = lower <= 40 * sp;
+    const bool wpInside = 40 * sp + 40 <= upper;
+    if (upInside != wpInside) {
+      *digits = sp + wpInside;
+      *exp10 = k + 1;
+      return;
+    }
+  }
+  const bool uInside = lower <= 4 * s;
+  const bool wInside = 4 * s + 4 <= upper;
+  if (uInside != wInside) {
+    *digits = uInside ? s : s + 1;
+    *exp10 = k;
+    return;
+  }
+  // both are inside: take the closer one, breaking ties to even
+  const uint64_t mid = 4 * s + 2;
+  const bool roundUp = vb > mid || (vb == mid && (s & 1) != 0);
+  *digits = roundUp ? s + 1 : s;
+  *exp10 = k;
+}
+
+// Write a decimal `digits * 10^exp10` (with no trailing zeros in `digits`) at `out`, returning the end.
+static
+byte* writeDecimal(byte* out, uint64_t digits, int exp10) {
+  const int n = countDigits(digits);
+  const int sci = exp10 + n - 1;
+  if (-4 <= sci && sci < 16) {
+    if (exp10 >= 0) {
+      // all digits before the point
+      writeDigits(out + n, digits);
+      out += n;
+      memset(out, '0', exp10);
+      out += exp10;
+      memcpy(out, ".0", 2);
+      return out + 2;
+    }
+    if (sci >= 0) {
+      // the point falls among the digits: write them shifted, then open a gap for the point
+      writeDigits(out + n, digits);
+      const int before = n + exp10;
+      memmove(out + before + 1, out + before, n - before);
+      out[before] = '.';
+      return out + n + 1;
+    }
+    // all digits after the point
+    memcpy(out, "0.", 2);
+    out += 2;
+    memset(out, '0', -sci - 1);
+    out += -sci - 1;
+    writeDigits(out + n, digits);
+    return out + n;
+  }
+  // scientific: the first digit, then the point and the rest (if any), then the exponent
+  writeDigits(out + n + 1, digits);
+  out[0] = out[1];
+  if (n > 1) {
+    out[1] = '.';
+    out += n + 1;
+  }
+  else {
+    out += 1;
+  }
+  *out++ = 'e';
+  *out++ = sci < 0 ? '-' : '+';
+  unsigned e = sci < 0 ? -sci : sci;
+  if (e >= 100) {
+    *out++ = '0' + e / 100;
+    e %= 100;
+  }
+  memcpy(out, &digitPairs[2 * e], 2);
+  return out + 2;
+}
+
+// Append a finite or non-finite binary number: `sign`, then `c * 2^q` in a format with `mantBits` explicit significand bits.
+static
+bool appendFloat(alloc_t mem, dynarr_byte* dst, bool sign, uint64_t sig, uint32_t biasedExp
+                , int mantBits, uint32_t maxExp, int bias) {
+  if (!reserve(mem, dst, CHIM_FMT_MAXWIDTH)) { return false; }
+  byte* out = dst->buf + dst->len;
+  if (biasedExp == maxExp) {
+    if (sig != 0) {
+      memcpy(out, "nan", 3);
+      dst->len += 3;
+      return true;
+    }
+    if (sign) { *out++ = '-'; }
+    memcpy(out, "inf", 3);
+    dst->len = out + 3 - dst->buf;
+    return true;
+  }
+  if (sign) { *out++ = '-'; }
+  if (biasedExp == 0 && sig == 0) {
+    memcpy(out, "0.0", 3);
+    dst->len = out + 3 - dst->buf;
+    return true;
+  }
+
+  uint64_t c;
+  int q;
+  if (biasedExp != 0) {
+    c = sig | (uint64_t)1 << mantBits;
+    q = (int)biasedExp - bias - mantBits;
+  }
+  else {
+    c = sig;
+    q = 1 - bias - mantBits;
+  }
+  uint64_t digits;
+  int exp10;
+  if (-mantBits <= q && q <= 0 && (c & (((uint64_t)1 << -q) - 1)) == 0) {
+    // an integer in range of the significand is exact as it is
+    digits = c >> -q;
+    exp10 = 0;
+  }
+  else {
+    shortest(c, q, sig == 0 && biasedExp > 1, &digits, &exp10);
+  }
+  while (digits % 10 == 0) {
+    digits /= 10;
+    exp10 += 1;
+  }
+  out = writeDecimal(out, digits, exp10);
+  dst->len = out - dst->buf;
+  return true;
+}
+
+
+bool fmt_u64(alloc_t mem, dynarr_byte* dst, uint64_t x) {
+  unsigned n = countDigits(x);
+  if (!reserve(mem, dst, n)) { return false; }
+  writeDigits(dst->buf + dst->len + n, x);
+  dst->len += n;
+  return true;
+}
+
+bool fmt_i64(alloc_t mem, dynarr_byte* dst, int64_t x) {
+  uint64_t mag = x < 0 ? 0 - (uint64_t)x : (uint64_t)x;
+  unsigned n = countDigits(mag) + (x < 0);
+  if (!reserve(mem, dst, n)) { return false; }
+  byte* out = dst->buf + dst->len;
+  out[0] = '-';
+  writeDigits(out + n, mag);
+  dst->len += n;
+  return true;
+}
+
+bool fmt_u32(alloc_t mem, dynarr_byte* dst, uint32_t x) {
+  unsigned n = countDigits(x);
+  if (!reserve(mem, dst, n)) { return false; }
+  writeDigits32(dst->buf + dst->len + n, x);
+  dst->len += n;
+  return true;
+}
+
+bool fmt_i32(alloc_t mem, dynarr_byte* dst, int32_t x) {
+  uint32_t mag = x < 0 ? 0 - (uint32_t)x : (uint32_t)x;
+  unsigned n = countDigits(mag) + (x < 0);
+  if (!reserve(mem, dst, n)) { return false; }
+  byte* out = dst->buf + dst->len;
+  out[0] = '-';
+  writeDigits32(out + n, mag);
+  dst->len += n;
+  return true;
+}
+
+bool fmt_f64(alloc_t mem, dynarr_byte* dst, double x) {
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return appendFloat(mem, dst, bits >> 63, bits & (((uint64_t)1 << 52) - 1), (bits >> 52) & 0x7ff, 52, 0x7ff, 1023);
+}
+
+bool fmt_f32(alloc_t mem, dynarr_byte* dst, float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return appendFloat(mem, dst, bits >> 31, bits & (((uint32_t)1 << 23) - 1), (bits >> 23) & 0xff, 23, 0xff, 127);
+}
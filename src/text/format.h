@@ -0,0 +1,132 @@
+/// @file
+/// @brief Fast conversion of numbers to text, appended to byte buffers.
+///
+/// Each formatter reserves exactly the space it needs in the destination buffer (growing it through the given allocator),
+///   then writes the text in place: there are no intermediate buffers, no format strings, and no locale.
+///
+/// Integers are written two digits at a time from a table, after computing their length from their bit-length.
+/// To format a `bitsN_t` from {@link chimtypes.h}, pass its `.u` or `.i` member, according to how it should be read.
+///
+/// Floating-point numbers are written with the fewest digits that read back as the same number
+///   (the Schubfach algorithm), in the same layout as Python's `repr`:
+///   positional notation when the decimal exponent is in `[-4, 16)`, otherwise scientific notation,
+///   always with a decimal point or exponent (e.g. `1.0`, `0.001`, `1e+16`, `2.5e-07`), and `inf`, `-inf`, or `nan` otherwise.
+
+#ifndef CHIM_TEXT_FORMAT
+#define CHIM_TEXT_FORMAT
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "alloc/unaligned.h"
+#include "buffer/byte.h"
+#include "chimtypes.h"
+
+#ifndef INLINE
+  #define INLINE inline
+#endif
+
+/// @brief Most bytes written by any one formatter.
+#define CHIM_FMT_MAXWIDTH 32
+
+
+/// @brief Append the decimal text of an unsigned integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_u64(alloc_t mem, dynarr_byte* dst, uint64_t x);
+
+/// @brief Append the decimal text of a signed integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_i64(alloc_t mem, dynarr_byte* dst, int64_t x);
+
+/// @brief Append the decimal text of an unsigned integer.
+///
+/// This is {@link fmt_u64}, but with cheaper division.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_u32(alloc_t mem, dynarr_byte* dst, uint32_t x);
+
+/// @brief Append the decimal text of a signed integer.
+///
+/// This is {@link fmt_i64}, but with cheaper division.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_i32(alloc_t mem, dynarr_byte* dst, int32_t x);
+
+/// @brief Append the decimal text of an unsigned integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+INLINE
+bool fmt_u16(alloc_t mem, dynarr_byte* dst, uint16_t x) {
+  return fmt_u32(mem, dst, x);
+}
+
+/// @brief Append the decimal text of a signed integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+INLINE
+bool fmt_i16(alloc_t mem, dynarr_byte* dst, int16_t x) {
+  return fmt_i32(mem, dst, x);
+}
+
+/// @brief Append the decimal text of an unsigned integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+INLINE
+bool fmt_u8(alloc_t mem, dynarr_byte* dst, uint8_t x) {
+  return fmt_u32(mem, dst, x);
+}
+
+/// @brief Append the decimal text of a signed integer.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+INLINE
+bool fmt_i8(alloc_t mem, dynarr_byte* dst, int8_t x) {
+  return fmt_i32(mem, dst, x);
+}
+
+/// @brief Append the shortest text that reads back as the same double.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_f64(alloc_t mem, dynarr_byte* dst, double x);
+
+/// @brief Append the shortest text that reads back as the same float.
+///
+/// The text has as few digits as identify the number among floats (not doubles): `0.1f` is written `0.1`.
+///
+/// @param mem: allocator for `dst`
+/// @param dst: the text is appended here
+/// @param x: the number
+/// @return false if allocation fails (`dst` is unchanged)
+bool fmt_f32(alloc_t mem, dynarr_byte* dst, float x);
+
+
+#endif
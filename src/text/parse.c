@@ -0,0 +1,575 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "text/pow10.h"
+
+#include "parse.h"
+
+
+static inline
+bool isDigit(byte c) {
+  return (byte)(c - '0') < 10;
+}
+
+static inline
+uint64_t read64le(const byte* p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  v = __builtin_bswap64(v);
+#endif
+  return v;
+}
+
+// Whether all eight bytes (read little-endian) are ASCII digits.
+static inline
+bool is8Digits(uint64_t v) {
+  return ((v & 0xF0F0F0F0F0F0F0F0u) | (((v + 0x0606060606060606u) & 0xF0F0F0F0F0F0F0F0u) >> 4))
+      == 0x3333333333333333u;
+}
+
+// The value of eight ASCII digits (read little-endian), combining pairs, then quads, then the two halves.
+static inline
+uint32_t parse8Digits(uint64_t v) {
+  v -= 0x3030303030303030u;
+  v = v * 10 + (v >> 8);
+  v = ((v & 0x000000FF000000FFu) * (100 + (1000000ull << 32))
+     + ((v >> 16) & 0x000000FF000000FFu) * (1 + (10000ull << 32))) >> 32;
+  return (uint32_t)v;
+}
+
+// Parse decimal digits into a number no greater than `max`, advancing `*pp` past them.
+static
+bool parseDigits(const byte** pp, const byte* end, uint64_t max, uint64_t* out) {
+  const byte* p = *pp;
+  if (p == end || !isDigit(*p)) { return false; }
+  uint64_t v = 0;
+  // while the value has at most eleven digits, eight more cannot overflow
+  while (end - p >= 8 && v < 100000000000u) {
+    uint64_t chunk = read64le(p);
+    if (!is8Digits(chunk)) { break; }
+    v = v * 100000000 + parse8Digits(chunk);
+    p += 8;
+  }
+  for (; p < end && isDigit(*p); p += 1) {
+    unsigned d = *p - '0';
+    if (v > (max - d) / 10) { return false; }
+    v = v * 10 + d;
+  }
+  if (v > max) { return false; }
+  *pp = p;
+  *out = v;
+  return true;
+}
+
+static
+bool parseSigned(larr_byte* src, uint64_t maxPos, int64_t* out) {
+  const byte* p = src->arr;
+  const byte* end = p + src->len;
+  bool neg = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    neg = *p == '-';
+    p += 1;
+  }
+  uint64_t mag;
+  if (!parseDigits(&p, end, maxPos + neg, &mag)) { return false; }
+  bits64_t v = {.u = neg ? 0 - mag : mag};
+  *out = v.i;
+  larr_advance_byte(src, p - src->arr);
+  return true;
+}
+
+
+bool parse_u64(larr_byte* src, uint64_t* out) {
+  const byte* p = src->arr;
+  if (!parseDigits(&p, p + src->len, UINT64_MAX, out)) { return false; }
+  larr_advance_byte(src, p - src->arr);
+  return true;
+}
+
+bool parse_i64(larr_byte* src, int64_t* out) {
+  return parseSigned(src, INT64_MAX, out);
+}
+
+bool parse_u32(larr_byte* src, uint32_t* out) {
+  const byte* p = src->arr;
+  uint64_t v;
+  if (!parseDigits(&p, p + src->len, UINT32_MAX, &v)) { return false; }
+  *out = v;
+  larr_advance_byte(src, p - src->arr);
+  return true;
+}
+
+bool parse_i32(larr_byte* src, int32_t* out) {
+  int64_t v;
+  if (!parseSigned(src, INT32_MAX, &v)) { return false; }
+  *out = v;
+  return true;
+}
+
+
+////// Floating point //////
+
+// Parameters of a binary floating-point format.
+typedef struct binfmt {
+  // explicit significand bits
+  int mantBits;
+  // exponent bias
+  int bias;
+  // decimal exponents (of a 64-bit significand) where an exact halfway case is possible, so ties must round to even
+  int minRoundEven;
+  int maxRoundEven;
+  // decimal exponents (of a 64-bit significand) below which every number rounds to zero, or above which to infinity
+  int minPow10;
+  int maxPow10;
+} binfmt;
+
+static const binfmt binary64 = {52, 1023, -4, 23, -342, 308};
+static const binfmt binary32 = {23, 127, -17, 10, -65, 38};
+
+static inline
+uint64_t infBits(const binfmt* f) {
+  return (uint64_t)(2 * f->bias + 1) << f->mantBits;
+}
+
+// A decimal number, as scanned from text.
+typedef struct decimal {
+  // the first (up to) nineteen significant digits
+  uint64_t w;
+  // the number is about w * 10^q
+  int64_t q;
+  // whether significant digits were left out of `w`
+  bool truncated;
+  // all of the digits, before and after the point
+  const byte* intDigits;
+  size_t intLen;
+  const byte* fracDigits;
+  size_t fracLen;
+  // the explicit exponent
+  int64_t exp;
+} decimal;
+
+static inline
+byte digitAt(const decimal* d, size_t i) {
+  return i < d->intLen ? d->intDigits[i] : d->fracDigits[i - d->intLen];
+}
+
+static
+const byte* scanDigits(const byte* p, const byte* end, uint64_t* w) {
+  // the value wraps past nineteen digits, in which case it is recomputed
+  while (end - p >= 8 && is8Digits(read64le(p))) {
+    *w = *w * 100000000 + parse8Digits(read64le(p));
+    p += 8;
+  }
+  for (; p < end && isDigit(*p); p += 1) {
+    *w = *w * 10 + (*p - '0');
+  }
+  return p;
+}
+
+static
+bool scanDecimal(const byte** pp, const byte* end, decimal* d) {
+  const byte* p = *pp;
+  uint64_t w = 0;
+  d->intDigits = p;
+  p = scanDigits(p, end, &w);
+  d->intLen = p - d->intDigits;
+  d->fracDigits = p;
+  d->fracLen = 0;
+  if (p < end && *p == '.') {
+    d->fracDigits = p + 1;
+    p = scanDigits(p + 1, end, &w);
+    d->fracLen = p - d->fracDigits;
+  }
+  if (d->intLen + d->fracLen == 0) { return false; }
+
+  d->exp = 0;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const byte* e = p + 1;
+    bool negExp = false;
+    if (e < end && (*e == '+' || *e == '-')) {
+      negExp = *e == '-';
+      e += 1;
+    }
+    // without digits, the `e` is not part of the number
+    if (e < end && isDigit(*e)) {
+      int64_t exp = 0;
+      for (; e < end && isDigit(*e); e += 1) {
+        // saturate: anything this large is out of range anyway
+        if (exp < 100000000) { exp = exp * 10 + (*e - '0'); }
+      }
+      d->exp = negExp ? -exp : exp;
+      p = e;
+    }
+  }
+
+  size_t total = d->intLen + d->fracLen;
+  d->q = d->exp - (int64_t)d->fracLen;
+  d->truncated = false;
+  if (total > 19) {
+    size_t first = 0;
+    while (first < total && digitAt(d, first) == '0') { first += 1; }
+    if (total - first > 19) {
+      w = 0;
+      for (size_t i = first; i < first + 19; ++i) {
+        w = w * 10 + (digitAt(d, i) - '0');
+      }
+      d->q += total - first - 19;
+      d->truncated = true;
+    }
+  }
+  d->w = w;
+  *pp = p;
+  return true;
+}
+
+// {high, low} 64-bit halves of the product of `a` and `b`
+static inline
+void mul64(uint64_t a, uint64_t b, uint64_t* hi, uint64_t* lo) {
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 p = (unsigned __int128)a * b;
+  *hi = p >> 64;
+  *lo = (uint64_t)p;
+#else
+  uint64_t aLo = (uint32_t)a, aHi = a >> 32;
+  uint64_t bLo = (uint32_t)b, bHi = b >> 32;
+  uint64_t ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+  uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+  *hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+  *lo = (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+// The bits (without sign) of the binary number nearest to w * 10^q, for nonzero `w`.
+// See Daniel Lemire, "Number Parsing at a Gigabyte per Second" (2021),
+//   and Noble Mushtak and Daniel Lemire, "Fast Number Parsing Without Fallback" (2023),
+//   which shows that the truncated 128-bit power of five always suffices.
+static
+uint64_t eiselLemire(int64_t q, uint64_t w, const binfmt* f) {
+  if (q < f->minPow10) { return 0; }
+  if (q > f->maxPow10) { return infBits(f); }
+  int lz = __builtin_clzll(w);
+  w <<= lz;
+  uint64_t powHi = pow10_128[q - CHIM_POW10_MIN][0];
+  uint64_t powLo = pow10_128[q - CHIM_POW10_MIN][1];
+  // The published algorithm rounds the powers 10^-27 to 10^-1 up (they are the reciprocals of powers of five
+  //   small enough for exact halfway cases), which its test for those cases relies on.
+  if (-27 <= q && q < 0) {
+    powLo += 1;
+    powHi += powLo == 0;
+  }
+  uint64_t hi, lo;
+  mul64(w, powHi, &hi, &lo);
+  // only when the bits below the result's precision are all ones could the low half of the power carry into them
+  uint64_t mask = UINT64_MAX >> (f->mantBits + 3);
+  if ((hi & mask) == mask) {
+    uint64_t hi2, lo2;
+    mul64(w, powLo, &hi2, &lo2);
+    lo += hi2;
+    hi += hi2 > lo;
+  }
+  int upperBit = hi >> 63;
+  int shift = upperBit + 64 - f->mantBits - 3;
+  uint64_t m = hi >> shift;
+  // (q * 217706) >> 16 == floor(log2(10^q))
+  int power2 = (int)(((q * 217706) >> 16) + 63) + upperBit - lz + f->bias;
+
+  if (power2 <= 0) {
+    // subnormal
+    if (-power2 + 1 >= 64) { return 0; }
+    m >>= -power2 + 1;
+    m += m & 1;
+    m >>= 1;
+    // rounding up may make it normal; the significand then has its implicit bit set, which is the exponent's low bit
+    return m;
+  }
+  // an exact halfway case rounds to even rather than up
+  if (lo <= 1 && q >= f->minRoundEven && q <= f->maxRoundEven && (m & 3) == 1 && (m << shift) == hi) {
+    m &= ~(uint64_t)1;
+  }
+  m += m & 1;
+  m >>= 1;
+  if (m >= (uint64_t)2 << f->mantBits) {
+    m = (uint64_t)1 << f->mantBits;
+    power2 += 1;
+  }
+  m &= ~((uint64_t)1 << f->mantBits);
+  if (power2 >= 2 * f->bias + 1) { return infBits(f); }
+  return (uint64_t)power2 << f->mantBits | m;
+}
+
+
+////// Exact fallback //////
+// Used only when a number has more than nineteen significant digits, and the digits after the nineteenth could matter.
+
+// significant digits kept: enough to decide rounding, as the exact halfway points have at most 767 of them
+#define MAXDIGITS 800
+// enough 32-bit limbs for 10^(MAXDIGITS + 343), shifted left by a few more bits
+#define BIGLIMBS 132
+
+typedef struct bignum {
+  uint32_t limb[BIGLIMBS];
+  size_t len;
+} bignum;
+
+static
+void bigSet(bignum* b, uint32_t x) {
+  b->limb[0] = x;
+  b->len = x != 0;
+}
+
+// b = b * m + a
+static
+void bigMulAdd(bignum* b, uint32_t m, uint32_t a) {
+  uint64_t carry = a;
+  for (size_t i = 0; i < b->len; ++i) {
+    carry += (uint64_t)b->limb[i] * m;
+    b->limb[i] = (uint32_t)carry;
+    carry >>= 32;
+  }
+  if (carry != 0) { b->limb[b->len++] = (uint32_t)carry; }
+}
+
+static
+void bigMulPow10(bignum* b, size_t n) {
+  static const uint32_t small[9] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+  for (; n >= 9; n -= 9) {
+    bigMulAdd(b, 1000000000, 0);
+  }
+  bigMulAdd(b, small[n], 0);
+}
+
+static
+size_t bigBits(const bignum* b) {
+  if (b->len == 0) { return 0; }
+  return 32 * b->len - __builtin_clz(b->limb[b->len - 1]);
+}
+
+static
+void bigShl(bignum* b, size_t n) {
+  if (b->len == 0) { return; }
+  size_t limbs = n / 32;
+  unsigned bits = n % 32;
+  b->limb[b->len] = 0;
+  for (size_t i = b->len + 1; i-- > 0; ) {
+    uint32_t hi = b->limb[i];
+    uint32_t lo = i > 0 ? b->limb[i - 1] : 0;
+    b->limb[i + limbs] = bits == 0 ? hi : (hi << bits) | (lo >> (32 - bits));
+  }
+  memset(b->limb, 0, limbs * sizeof(uint32_t));
+  b->len += limbs + 1;
+  while (b->len > 0 && b->limb[b->len - 1] == 0) { b->len -= 1; }
+}
+
+static
+void bigShr1(bignum* b) {
+  for (size_t i = 0; i < b->len; ++i) {
+    uint32_t next = i + 1 < b->len ? b->limb[i + 1] : 0;
+    b->limb[i] = (b->limb[i] >> 1) | (next << 31);
+  }
+  if (b->len > 0 && b->limb[b->len - 1] == 0) { b->len -= 1; }
+}
+
+static
+int bigCmp(const bignum* a, const bignum* b) {
+  if (a->len != b->len) { return a->len < b->len ? -1 : 1; }
+  for (size_t i = a->len; i-- > 0; ) {
+    if (a->limb[i] != b->limb[i]) { return a->limb[i] < b->limb[i] ? -1 : 1; }
+  }
+  return 0;
+}
+
+// a -= b, where a >= b
+static
+void bigSub(bignum* a, const bignum* b) {
+  int64_t borrow = 0;
+  for (size_t i = 0; i < a->len; ++i) {
+    int64_t d = (int64_t)a->limb[i] - (i < b->len ? b->limb[i] : 0) - borrow;
+    borrow = d < 0;
+    a->limb[i] = (uint32_t)d;
+  }
+  while (a->len > 0 && a->limb[a->len - 1] == 0) { a->len -= 1; }
+}
+
+// The 64 bits of `b` from bit `shift` up, and whether any bits below them are set.
+static
+uint64_t bigBitsAt(const bignum* b, size_t shift, bool* sticky) {
+  uint64_t out = 0;
+  for (size_t i = 0; i < 64; ++i) {
+    size_t bit = shift + i;
+    if (bit / 32 < b->len && (b->limb[bit / 32] >> (bit % 32)) & 1) { out |= (uint64_t)1 << i; }
+  }
+  *sticky = false;
+  for (size_t bit = 0; bit < shift && !*sticky; ++bit) {
+    *sticky = (b->limb[bit / 32] >> (bit % 32)) & 1;
+  }
+  return out;
+}
+
+// The bits (without sign) of the binary number nearest to q * 2^-s, plus a little more if `sticky`.
+static
+uint64_t roundBinary(uint64_t q, int s, bool sticky, const binfmt* f) {
+  int bq = 64 - __builtin_clzll(q);
+  // exponent of the lowest bit of a subnormal
+  int minLsb = 1 - f->bias - f->mantBits;
+  // index in `q` of the lowest bit kept
+  int lsb = bq - (f->mantBits + 1);
+  if (lsb - s < minLsb) { lsb = minLsb + s; }
+  uint64_t m;
+  if (lsb <= 0) {
+    m = q << -lsb;
+  }
+  else if (lsb > 64) {
+    m = 0;
+  }
+  else {
+    m = lsb == 64 ? 0 : q >> lsb;
+    uint64_t rem = lsb == 64 ? q : q & (((uint64_t)1 << lsb) - 1);
+    uint64_t half = (uint64_t)1 << (lsb - 1);
+    if (rem > half || (rem == half && (sticky || (m & 1)))) { m += 1; }
+  }
+  int e = lsb - s;
+  if (m >> (f->mantBits + 1)) {
+    m >>= 1;
+    e += 1;
+  }
+  // subnormal (including zero)
+  if (m >> f->mantBits == 0) { return m; }
+  int biased = e + f->mantBits + f->bias;
+  if (biased >= 2 * f->bias + 1) { return infBits(f); }
+  return (uint64_t)biased << f->mantBits | (m & (((uint64_t)1 << f->mantBits) - 1));
+}
+
+static
+uint64_t exactBinary(const decimal* d, const binfmt* f) {
+  size_t total = d->intLen + d->fracLen;
+  size_t first = 0;
+  while (first < total && digitAt(d, first) == '0') { first += 1; }
+  size_t last = total - first > MAXDIGITS ? first + MAXDIGITS : total;
+
+  // D: the significant digits kept, with a 1 appended if any nonzero digits were dropped
+  bignum num;
+  bigSet(&num, 0);
+  uint32_t chunk = 0;
+  size_t chunkLen = 0;
+  for (size_t i = first; i < last; ++i) {
+    chunk = chunk * 10 + (digitAt(d, i) - '0');
+    if (++chunkLen == 9) {
+      bigMulAdd(&num, 1000000000, chunk);
+      chunk = 0;
+      chunkLen = 0;
+    }
+  }
+  bigMulPow10(&num, chunkLen);
+  bigMulAdd(&num, 1, chunk);
+  int64_t e10 = d->exp - (int64_t)d->fracLen + (int64_t)(total - last);
+  for (size_t i = last; i < total; ++i) {
+    if (digitAt(d, i) != '0') {
+      bigMulAdd(&num, 10, 1);
+      e10 -= 1;
+      break;
+    }
+  }
+
+  bool sticky;
+  if (e10 >= 0) {
+    bigMulPow10(&num, e10);
+    size_t bits = bigBits(&num);
+    size_t shift = bits > 64 ? bits - 64 : 0;
+    uint64_t q = bigBitsAt(&num, shift, &sticky);
+    return roundBinary(q, -(int)shift, sticky, f);
+  }
+  // divide by 10^-e10, to 56 or 57 bits of quotient
+  bignum den;
+  bigSet(&den, 1);
+  bigMulPow10(&den, -e10);
+  int s = 56 + (int)bigBits(&den) - (int)bigBits(&num);
+  if (s >= 0) { bigShl(&num, s); }
+  else { bigShl(&den, -s); }
+  bigShl(&den, 57);
+  uint64_t q = 0;
+  for (int bit = 57; bit >= 0; --bit) {
+    if (bigCmp(&num, &den) >= 0) {
+      bigSub(&num, &den);
+      q |= (uint64_t)1 << bit;
+    }
+    bigShr1(&den);
+  }
+  return roundBinary(q, s, num.len != 0, f);
+}
+
+
+// Match a case-insensitive word (given in lowercase).
+static
+bool matchWord(const byte* p, const byte* end, const char* word) {
+  size_t n = strlen(word);
+  if ((size_t)(end - p) < n) { return false; }
+  for (size_t i = 0; i < n; ++i) {
+    if ((p[i] | 0x20) != (byte)word[i]) { return false; }
+  }
+  return true;
+}
+
+// Parse a number into the bits of a binary format (with the sign in bit `signBit`).
+static
+bool parseFloat(larr_byte* src, const binfmt* f, int signBit, uint64_t* out) {
+  const byte* p = src->arr;
+  const byte* end = p + src->len;
+  bool negative = false;
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p == '-';
+    p += 1;
+  }
+  uint64_t bits;
+  if (p < end && !isDigit(*p) && *p != '.') {
+    if (matchWord(p, end, "infinity")) {
+      bits = infBits(f);
+      p += 8;
+    }
+    else if (matchWord(p, end, "inf")) {
+      bits = infBits(f);
+      p += 3;
+    }
+    else if (matchWord(p, end, "nan")) {
+      bits = infBits(f) | (uint64_t)1 << (f->mantBits - 1);
+      p += 3;
+    }
+    else {
+      return false;
+    }
+  }
+  else {
+    decimal d;
+    if (!scanDecimal(&p, end, &d)) { return false; }
+    if (d.w == 0) {
+      bits = 0;
+    }
+    else {
+      bits = eiselLemire(d.q, d.w, f);
+      // the digits dropped lie between w and w + 1; when both round the same, so does the exact number
+      if (d.truncated && bits != eiselLemire(d.q, d.w + 1, f)) {
+        bits = exactBinary(&d, f);
+      }
+    }
+  }
+  *out = bits | (uint64_t)negative << signBit;
+  larr_advance_byte(src, p - src->arr);
+  return true;
+}
+
+bool parse_f64(larr_byte* src, double* out) {
+  uint64_t bits;
+  if (!parseFloat(src, &binary64, 63, &bits)) { return false; }
+  memcpy(out, &bits, sizeof(*out));
+  return true;
+}
+
+bool parse_f32(larr_byte* src, float* out) {
+  uint64_t bits;
+  if (!parseFloat(src, &binary32, 31, &bits)) { return false; }
+  uint32_t bits32 = bits;
+  memcpy(out, &bits32, sizeof(*out));
+  return true;
+}
@@ -0,0 +1,75 @@
+/// @file
+/// @brief Fast conversion of text to numbers, straight from byte slices.
+///
+/// The parsers read a number from the start of a slice and, on success, advance the slice past it,
+///   so a caller can check that a whole token was consumed (the slice is then empty), or continue with what follows.
+/// On failure, the slice and the output are unchanged.
+/// Nothing needs to be copied or terminated, and there is no locale: the decimal point is always `.`.
+///
+/// Integers are decimal digits, with an optional sign (`+` or `-`) for the signed parsers only.
+/// Runs of eight digits are converted at once with SIMD-within-a-register arithmetic;
+///   a number which does not fit the result type is an error (rather than being clamped).
+///
+/// Floating-point numbers are `[+-]digits[.digits][(e|E)[+-]digits]` (either run of digits, but not both, may be empty),
+///   or `inf`, `infinity`, or `nan` in any case, with an optional sign.
+/// They are always correctly rounded (to nearest, ties to even), as `strtod` does:
+///   nearly all inputs are decided by the Eisel-Lemire algorithm (a single 128-bit multiplication by a power of ten),
+///   and the rare ambiguous ones (with more than nineteen significant digits) by exact big-integer arithmetic.
+/// Numbers too large for the type become infinities, and numbers too small become zeros, as with `strtod`.
+
+#ifndef CHIM_TEXT_PARSE
+#define CHIM_TEXT_PARSE
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chimtypes.h"
+#include "slice/byte.h"
+
+
+/// @brief Parse an unsigned decimal integer.
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a digit, or the number does not fit
+bool parse_u64(larr_byte* src, uint64_t* out);
+
+/// @brief Parse a signed decimal integer.
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a number, or the number does not fit
+bool parse_i64(larr_byte* src, int64_t* out);
+
+/// @brief Parse an unsigned decimal integer.
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a digit, or the number does not fit
+bool parse_u32(larr_byte* src, uint32_t* out);
+
+/// @brief Parse a signed decimal integer.
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a number, or the number does not fit
+bool parse_i32(larr_byte* src, int32_t* out);
+
+/// @brief Parse a floating-point number, correctly rounded to a double.
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a number
+bool parse_f64(larr_byte* src, double* out);
+
+/// @brief Parse a floating-point number, correctly rounded to a float.
+///
+/// The text is rounded to a float directly, not through a double (which could round twice).
+///
+/// @param src: the text; on success, it is advanced past the number
+/// @param out: where to store the number
+/// @return false if `src` does not start with a number
+bool parse_f32(larr_byte* src, float* out);
+
+
+#endif
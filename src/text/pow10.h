@@ -0,0 +1,31 @@
+/// @file
+/// @brief 128-bit approximations of powers of ten, for converting between binary and decimal floating point.
+///
+/// Both formatting ({@link text/format.h}) and parsing ({@link text/parse.h}) of floating point
+///   scale a binary significand by a power of ten, which takes more precision than a double has.
+/// This table holds, for each power of ten in the range of doubles (and then some),
+///   its 128 most significant bits, normalized so that the top bit is set.
+/// The binary exponent is not stored: 10^e is approximately `pow10_128[e - CHIM_POW10_MIN] * 2^(floor(log2(10^e)) - 127)`,
+///   and `floor(log2(10^e))` is `(e * 217706) >> 16` for the exponents in the table.
+///
+/// Entries are truncated, so they are exact up to 10^55 (the last power of five to fit in 128 bits),
+///   and slightly too small otherwise.
+
+#ifndef CHIM_TEXT_POW10
+#define CHIM_TEXT_POW10
+
+#include <stdint.h>
+
+/// @brief Smallest decimal exponent in {@link pow10_128}.
+#define CHIM_POW10_MIN (-342)
+/// @brief Largest decimal exponent in {@link pow10_128}.
+#define CHIM_POW10_MAX 324
+/// @brief Largest decimal exponent for which {@link pow10_128} is exact.
+#define CHIM_POW10_MAXEXACT 55
+
+
+/// @brief Normalized significands of powers of ten: `{high 64 bits, low 64 bits}`, indexed by exponent minus {@link CHIM_POW10_MIN}.
+extern const uint64_t pow10_128[CHIM_POW10_MAX - CHIM_POW10_MIN + 1][2];
+
+
+#endif